@@ -55,10 +55,13 @@ ifneq ($(SUBPROJECT),)
 endif
 
 # We can assume a ChibiOS target When MCU_FAMILY is defined, since it's not used for LUFA
+# Host builds (the simulator) set PLATFORM = NATIVE in their rules.mk
 ifdef MCU_FAMILY
 	PLATFORM=CHIBIOS
-else
+else ifneq ($(strip $(PLATFORM)),NATIVE)
 	PLATFORM=AVR
+else
+	PLATFORM=NATIVE
 endif
 
 ifeq ($(PLATFORM),CHIBIOS)
@@ -127,10 +130,29 @@ ifneq ($(SUBPROJECT),)
 	SRC += $(SUBPROJECT_C)
 endif
 
-ifndef CUSTOM_MATRIX
+ifeq ($(strip $(SPLIT_KEYBOARD)), yes)
+	OPT_DEFS += -DSPLIT_KEYBOARD
+	SRC += $(QUANTUM_DIR)/split/split.c \
+		$(QUANTUM_DIR)/split/split_util.c \
+		$(QUANTUM_DIR)/split/transport.c \
+		$(QUANTUM_DIR)/split/serial.c \
+		$(QUANTUM_DIR)/split/serial_usart.c \
+		$(QUANTUM_DIR)/split/i2c.c
+	VPATH += $(QUANTUM_PATH)/split
+	ifndef CUSTOM_MATRIX
+		SRC += $(QUANTUM_DIR)/split/matrix.c
+	endif
+	# The i2c transport uses the TWI driver in tmk_core
+	TWI_ENABLE ?= yes
+else ifndef CUSTOM_MATRIX
 	SRC += $(QUANTUM_DIR)/matrix.c
 endif
 
+DEBOUNCE_TYPE ?= sym_g
+ifneq ($(strip $(DEBOUNCE_TYPE)), custom)
+	SRC += $(QUANTUM_DIR)/debounce/$(strip $(DEBOUNCE_TYPE)).c
+endif
+
 ifeq ($(strip $(MIDI_ENABLE)), yes)
     OPT_DEFS += -DMIDI_ENABLE
 	SRC += $(QUANTUM_DIR)/process_keycode/process_midi.c
@@ -210,6 +232,11 @@ ifeq ($(PLATFORM),AVR)
 	include $(TMK_PATH)/avr.mk
 endif
 
+ifeq ($(PLATFORM),NATIVE)
+	include $(TMK_PATH)/protocol/sim.mk
+	include $(TMK_PATH)/native.mk
+endif
+
 ifeq ($(strip $(VISUALIZER_ENABLE)), yes)
 	VISUALIZER_DIR = $(QUANTUM_DIR)/visualizer
 	VISUALIZER_PATH = $(QUANTUM_PATH)/visualizer
@@ -227,7 +254,12 @@ $(KEYBOARD_OUTPUT)_INC := $(PROJECT_INC)
 $(KEYBOARD_OUTPUT)_CONFIG  := $(PROJECT_CONFIG)
 
 # Default target.
+ifeq ($(PLATFORM),NATIVE)
+# A host executable has no hex image or flash size to report
+all: elf
+else
 all: build sizeafter
+endif
 
 # Change the build target to build a HEX file or a library.
 build: elf hex
@@ -43,6 +43,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 /* Set 0 if debouncing isn't needed */
 #define DEBOUNCE    5
 
+/* Teensy pin wired to INTA or INTB of the MCP23018, so an idle left half
+ * costs no i2c at all. The cable doesn't carry it, it takes a wire. */
+// #define MCP23018_INT_PIN E6
+
 /*
  * Feature disable options
  *  These options are also useful to firmware size reduction.
@@ -1,5 +1,5 @@
 #include "ez.h"
-#include "i2cmaster.h"
+#include "twi.h"
 
 bool i2c_initialized = 0;
 uint8_t mcp23018_status = 0x20;
@@ -52,33 +52,49 @@ uint8_t init_mcp23018(void) {
 
     // I2C subsystem
     if (i2c_initialized == 0) {
-        i2c_init();  // on pins D(1,0)
+        twi_init();  // on pins D(1,0)
         i2c_initialized++;
         _delay_ms(1000);
     }
 
+    // byte mode, one open-drain INT for both ports
+    static const uint8_t iocon[] = { IOCON, IOCON_MIRROR | IOCON_SEQOP | IOCON_ODR | IOCON_INTCC };
+    mcp23018_status = twi_write(I2C_ADDR, iocon, sizeof(iocon));
+    if (mcp23018_status) goto out;
+
     // set pin direction
     // - unused  : input  : 1
     // - input   : input  : 1
     // - driving : output : 0
-    mcp23018_status = i2c_start(I2C_ADDR_WRITE);    if (mcp23018_status) goto out;
-    mcp23018_status = i2c_write(IODIRA);            if (mcp23018_status) goto out;
-    mcp23018_status = i2c_write(0b00000000);        if (mcp23018_status) goto out;
-    mcp23018_status = i2c_write(0b00111111);        if (mcp23018_status) goto out;
-    i2c_stop();
+    static const uint8_t iodir[] = { IODIRA, 0b00000000, 0b00111111 };
+    mcp23018_status = twi_write(I2C_ADDR, iodir, sizeof(iodir));
+    if (mcp23018_status) goto out;
 
     // set pull-up
     // - unused  : on  : 1
     // - input   : on  : 1
     // - driving : off : 0
-    mcp23018_status = i2c_start(I2C_ADDR_WRITE);    if (mcp23018_status) goto out;
-    mcp23018_status = i2c_write(GPPUA);             if (mcp23018_status) goto out;
-    mcp23018_status = i2c_write(0b00000000);        if (mcp23018_status) goto out;
-    mcp23018_status = i2c_write(0b00111111);        if (mcp23018_status) goto out;
+    static const uint8_t gppu[] = { GPPUA, 0b00000000, 0b00111111 };
+    mcp23018_status = twi_write(I2C_ADDR, gppu, sizeof(gppu));
+    if (mcp23018_status) goto out;
 
-out:
-    i2c_stop();
+    // INT is low while any column is not high
+    // - compare to DEFVAL : 1
+    static const uint8_t intcon[] = { INTCONB, 0b00111111 };
+    mcp23018_status = twi_write(I2C_ADDR, intcon, sizeof(intcon));
+    if (mcp23018_status) goto out;
+    static const uint8_t defval[] = { DEFVALB, 0b00111111 };
+    mcp23018_status = twi_write(I2C_ADDR, defval, sizeof(defval));
+    if (mcp23018_status) goto out;
+    static const uint8_t gpinten[] = { GPINTENB, 0b00111111 };
+    mcp23018_status = twi_write(I2C_ADDR, gpinten, sizeof(gpinten));
+    if (mcp23018_status) goto out;
 
+    // set all rows low : 0, see matrix.c
+    static const uint8_t gpio[] = { GPIOA, MCP23018_ALL_ROWS };
+    mcp23018_status = twi_write(I2C_ADDR, gpio, sizeof(gpio));
+
+out:
     return mcp23018_status;
 }
 
@@ -4,7 +4,7 @@
 #include "quantum.h"
 #include <stdint.h>
 #include <stdbool.h>
-#include "i2cmaster.h"
+#include "twi.h"
 #include <util/delay.h>
 
 #define CPU_PRESCALE(n) (CLKPR = 0x80, CLKPR = (n))
@@ -12,10 +12,12 @@
 
 // I2C aliases and register addresses (see "mcp23018.md")
 #define I2C_ADDR        0b0100000
-#define I2C_ADDR_WRITE  ( (I2C_ADDR<<1) | I2C_WRITE )
-#define I2C_ADDR_READ   ( (I2C_ADDR<<1) | I2C_READ  )
 #define IODIRA          0x00            // i/o direction register
 #define IODIRB          0x01
+#define GPINTENB        0x05            // interrupt-on-change enable register
+#define DEFVALB         0x07            // default compare register for interrupt-on-change
+#define INTCONB         0x09            // interrupt control register
+#define IOCON           0x0A            // configuration register
 #define GPPUA           0x0C            // GPIO pull-up resistor register
 #define GPPUB           0x0D
 #define GPIOA           0x12            // general purpose i/o port register (write modifies OLAT)
@@ -23,6 +25,15 @@
 #define OLATA           0x14            // output latch register
 #define OLATB           0x15
 
+// IOCON bits
+#define IOCON_MIRROR    (1<<6)          // INTA and INTB are connected
+#define IOCON_SEQOP     (1<<5)          // byte mode, the address toggles between A and B
+#define IOCON_ODR       (1<<2)          // INT is open-drain
+#define IOCON_INTCC     (1<<0)          // reading INTCAP clears the interrupt
+
+// Rows 0-6 low, the state of the left half between scans
+#define MCP23018_ALL_ROWS (0xFF & ~0b01111111 & ~(0<<7))
+
 extern uint8_t mcp23018_status;
 
 void init_ergodox(void);
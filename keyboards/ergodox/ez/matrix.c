@@ -33,28 +33,20 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "debug.h"
 #include "util.h"
 #include "matrix.h"
+#include "debounce.h"
 #include "ez.h"
-#include "i2cmaster.h"
-#ifdef DEBUG_MATRIX_SCAN_RATE
-#include  "timer.h"
+#include "twi.h"
+#ifdef MCP23018_INT_PIN
+#include "config_common.h"
 #endif
+#include  "timer.h"
 
 /*
- * This constant define not debouncing time in msecs, but amount of matrix
- * scan loops which should be made to get stable debounced results.
- *
- * On Ergodox matrix scan rate is relatively low, because of slow I2C.
- * Now it's only 317 scans/second, or about 3.15 msec/scan.
- * According to Cherry specs, debouncing time is 5 msec.
- *
- * And so, there is no sense to have DEBOUNCE higher than 2.
+ * Debouncing is done by the shared quantum debounce module, see
+ * quantum/debounce.h. DEBOUNCE is the debounce time in msecs and
+ * DEBOUNCE_TYPE in rules.mk selects the algorithm.
  */
 
-#ifndef DEBOUNCE
-#   define DEBOUNCE	5
-#endif
-static uint8_t debouncing = DEBOUNCE;
-
 /* matrix state(1:on, 0:off) */
 static matrix_row_t matrix[MATRIX_ROWS];
 static matrix_row_t matrix_debouncing[MATRIX_ROWS];
@@ -63,8 +55,36 @@ static matrix_row_t read_cols(uint8_t row);
 static void init_cols(void);
 static void unselect_rows(void);
 static void select_row(uint8_t row);
+static void select_all_rows(void);
+static void mcp23018_start_poll(void);
+static bool mcp23018_poll_result(void);
+static void mcp23018_start_scan(void);
+static uint8_t mcp23018_finish_scan(void);
+
+static uint16_t mcp23018_reset_timer;
+
+/*
+ * Between scans all rows of both halves are selected, so a single read of
+ * the columns tells whether any key of a half is down. A half is only scanned
+ * row by row when one is, or when it still had keys down at the last scan.
+ *
+ * The left half is polled with one i2c read, or, when MCP23018_INT_PIN is
+ * defined in config.h, with no i2c at all: the INTA/INTB pin of the MCP23018,
+ * wired to that Teensy pin, goes low while any column is pulled low.
+ */
 
-static uint8_t mcp23018_reset_loop;
+/* The rows of the left half, read over i2c while the right half is scanned */
+#define MCP23018_ROWS 7
+
+static twi_transaction_t mcp23018_rows[MCP23018_ROWS];
+static twi_transaction_t mcp23018_idle;
+static uint8_t mcp23018_select_data[MCP23018_ROWS][2];
+/* GPIOB, GPIOA and GPIOB again, see mcp23018_start_scan */
+static uint8_t mcp23018_cols[MCP23018_ROWS][3];
+#ifndef MCP23018_INT_PIN
+static twi_transaction_t mcp23018_poll;
+static uint8_t mcp23018_poll_data;
+#endif
 
 #ifdef DEBUG_MATRIX_SCAN_RATE
 uint32_t matrix_timer;
@@ -115,6 +135,7 @@ void matrix_init(void)
         matrix[i] = 0;
         matrix_debouncing[i] = 0;
     }
+    debounce_init(MATRIX_ROWS);
 
 #ifdef DEBUG_MATRIX_SCAN_RATE
     matrix_timer = timer_read32();
@@ -136,6 +157,7 @@ void matrix_power_up(void) {
         matrix[i] = 0;
         matrix_debouncing[i] = 0;
     }
+    debounce_init(MATRIX_ROWS);
 
 #ifdef DEBUG_MATRIX_SCAN_RATE
     matrix_timer = timer_read32();
@@ -146,10 +168,12 @@ void matrix_power_up(void) {
 
 uint8_t matrix_scan(void)
 {
+    bool changed = false;
+
     if (mcp23018_status) { // if there was an error
-        if (++mcp23018_reset_loop == 0) {
-            // since mcp23018_reset_loop is 8 bit - we'll try to reset once in 255 matrix scans
-            // this will be approx bit more frequent than once per second
+        // scans are too fast now to count them, try to reset once per second
+        if (timer_elapsed(mcp23018_reset_timer) > 1000) {
+            mcp23018_reset_timer = timer_read();
             print("trying to reset mcp23018\n");
             mcp23018_status = init_mcp23018();
             if (mcp23018_status) {
@@ -175,31 +199,64 @@ uint8_t matrix_scan(void)
     }
 #endif
 
+    if (!mcp23018_status) {
+        mcp23018_start_poll();
+    }
+
+    // any key down on the right half
+    select_all_rows();
+    wait_us(30);  // without this wait read unstable value.
+    bool right_active = read_cols(MCP23018_ROWS) != 0;
+    unselect_rows();
+
+    bool left_active = false;
+    if (!mcp23018_status) {
+        left_active = mcp23018_poll_result();
+    }
+
     for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
-        select_row(i);
-        wait_us(30);  // without this wait read unstable value.
-        matrix_row_t cols = read_cols(i);
-        if (matrix_debouncing[i] != cols) {
-            matrix_debouncing[i] = cols;
-            if (debouncing) {
-                debug("bounce!: "); debug_hex(debouncing); debug("\n");
+        if (matrix_debouncing[i]) {
+            // scan once more to see the keys go up
+            if (i < MCP23018_ROWS) {
+                left_active = true;
+            } else {
+                right_active = true;
             }
-            debouncing = DEBOUNCE;
         }
-        unselect_rows();
     }
 
-    if (debouncing) {
-        if (--debouncing) {
-            wait_us(1);
-            // this should be wait_ms(1) but has been left as-is at EZ's request
-        } else {
-            for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
-                matrix[i] = matrix_debouncing[i];
+    if (left_active && !mcp23018_status) {
+        mcp23018_start_scan();
+    }
+
+    if (right_active) {
+        for (uint8_t i = MCP23018_ROWS; i < MATRIX_ROWS; i++) {
+            select_row(i);
+            wait_us(30);  // without this wait read unstable value.
+            matrix_row_t cols = read_cols(i);
+            if (matrix_debouncing[i] != cols) {
+                matrix_debouncing[i] = cols;
+                changed = true;
             }
+            unselect_rows();
         }
     }
 
+    if (left_active && !mcp23018_status) {
+        mcp23018_status = mcp23018_finish_scan();
+    }
+    if (left_active || mcp23018_status) {
+        for (uint8_t i = 0; i < MCP23018_ROWS; i++) {
+            matrix_row_t cols = read_cols(i);
+            if (matrix_debouncing[i] != cols) {
+                matrix_debouncing[i] = cols;
+                changed = true;
+            }
+        }
+    }
+
+    debounce(matrix_debouncing, matrix, MATRIX_ROWS, changed);
+
     matrix_scan_quantum();
 
     return 1;
@@ -207,7 +264,7 @@ uint8_t matrix_scan(void)
 
 bool matrix_is_modified(void)
 {
-    if (debouncing) return false;
+    if (debounce_active()) return false;
     return true;
 }
 
@@ -256,6 +313,11 @@ static void  init_cols(void)
 {
     // init on mcp23018
     // not needed, already done as part of init_mcp23018()
+#ifdef MCP23018_INT_PIN
+    // its INT, input with pull-up(DDR:0, PORT:1)
+    _SFR_IO8((MCP23018_INT_PIN >> 4) + 1) &= ~_BV(MCP23018_INT_PIN & 0xF);
+    _SFR_IO8((MCP23018_INT_PIN >> 4) + 2) |=  _BV(MCP23018_INT_PIN & 0xF);
+#endif
 
     // init on teensy
     // Input with pull-up(DDR:0, PORT:1)
@@ -265,19 +327,11 @@ static void  init_cols(void)
 
 static matrix_row_t read_cols(uint8_t row)
 {
-    if (row < 7) {
+    if (row < MCP23018_ROWS) {
         if (mcp23018_status) { // if there was an error
             return 0;
         } else {
-            uint8_t data = 0;
-            mcp23018_status = i2c_start(I2C_ADDR_WRITE);    if (mcp23018_status) goto out;
-            mcp23018_status = i2c_write(GPIOB);             if (mcp23018_status) goto out;
-            mcp23018_status = i2c_start(I2C_ADDR_READ);     if (mcp23018_status) goto out;
-            data = i2c_readNak();
-            data = ~data;
-        out:
-            i2c_stop();
-            return data;
+            return (uint8_t)~mcp23018_cols[row][2] & 0x3F;
         }
     } else {
         // read from teensy
@@ -291,6 +345,87 @@ static matrix_row_t read_cols(uint8_t row)
     }
 }
 
+#ifdef MCP23018_INT_PIN
+static void mcp23018_start_poll(void)
+{
+}
+
+static bool mcp23018_poll_result(void)
+{
+    // active low
+    return !(_SFR_IO8(MCP23018_INT_PIN >> 4) & _BV(MCP23018_INT_PIN & 0xF));
+}
+#else
+/* Reads the columns, with all rows selected */
+static void mcp23018_start_poll(void)
+{
+    static const uint8_t gpiob = GPIOB;
+    mcp23018_poll = (twi_transaction_t) {
+        .address = I2C_ADDR,
+        .write_data = &gpiob,
+        .write_size = 1,
+        .read_data = &mcp23018_poll_data,
+        .read_size = 1,
+    };
+    twi_submit(&mcp23018_poll);
+}
+
+static bool mcp23018_poll_result(void)
+{
+    mcp23018_status = twi_wait(&mcp23018_poll);
+    return !mcp23018_status && (mcp23018_poll_data & 0x3F) != 0x3F;
+}
+#endif
+
+/* Queues the whole scan of the left half, one transaction per row, and then
+ * selects all rows again. The i2c interrupt runs it while the right half is
+ * scanned.
+ *
+ * The MCP23018 is in byte mode (IOCON.SEQOP), where the register address
+ * toggles between GPIOA and GPIOB. So each transaction selects a row by
+ * writing GPIOA, and then reads GPIOB, GPIOA and GPIOB after a repeated
+ * start. The second read of GPIOB happens some 70us after the row was
+ * selected at 400kHz, which is more than the 30us it needs to settle.
+ */
+static void mcp23018_start_scan(void)
+{
+    static const uint8_t idle_data[] = { GPIOA, MCP23018_ALL_ROWS };
+
+    for (uint8_t row = 0; row < MCP23018_ROWS; row++) {
+        // set active row low  : 0
+        // set other rows hi-Z : 1
+        mcp23018_select_data[row][0] = GPIOA;
+        mcp23018_select_data[row][1] = 0xFF & ~(1<<row) & ~(0<<7);
+        mcp23018_rows[row] = (twi_transaction_t) {
+            .address = I2C_ADDR,
+            .write_data = mcp23018_select_data[row],
+            .write_size = 2,
+            .read_data = mcp23018_cols[row],
+            .read_size = sizeof(mcp23018_cols[row]),
+        };
+        twi_submit(&mcp23018_rows[row]);
+    }
+
+    mcp23018_idle = (twi_transaction_t) {
+        .address = I2C_ADDR,
+        .write_data = idle_data,
+        .write_size = sizeof(idle_data),
+    };
+    twi_submit(&mcp23018_idle);
+}
+
+/* Waits for the scan of the left half, returns 0 when all of it worked */
+static uint8_t mcp23018_finish_scan(void)
+{
+    uint8_t status = twi_wait(&mcp23018_idle);
+    for (uint8_t row = 0; row < MCP23018_ROWS; row++) {
+        if (mcp23018_rows[row].status) {
+            status = mcp23018_rows[row].status;
+        }
+    }
+    return status;
+}
+
 /* Row pin configuration
  *
  * Teensy
@@ -303,20 +438,6 @@ static matrix_row_t read_cols(uint8_t row)
  */
 static void unselect_rows(void)
 {
-    // unselect on mcp23018
-    if (mcp23018_status) { // if there was an error
-        // do nothing
-    } else {
-        // set all rows hi-Z : 1
-        mcp23018_status = i2c_start(I2C_ADDR_WRITE);    if (mcp23018_status) goto out;
-        mcp23018_status = i2c_write(GPIOA);             if (mcp23018_status) goto out;
-        mcp23018_status = i2c_write( 0xFF
-                              & ~(0<<7)
-                          );                            if (mcp23018_status) goto out;
-    out:
-        i2c_stop();
-    }
-
     // unselect on teensy
     // Hi-Z(DDR:0, PORT:0) to unselect
     DDRB  &= ~(1<<0 | 1<<1 | 1<<2 | 1<<3);
@@ -327,24 +448,21 @@ static void unselect_rows(void)
     PORTC &= ~(1<<6);
 }
 
+static void select_all_rows(void)
+{
+    // Output low(DDR:1, PORT:0) to select
+    DDRB  |=  (1<<0 | 1<<1 | 1<<2 | 1<<3);
+    PORTB &= ~(1<<0 | 1<<1 | 1<<2 | 1<<3);
+    DDRD  |=  (1<<2 | 1<<3);
+    PORTD &= ~(1<<2 | 1<<3);
+    DDRC  |=  (1<<6);
+    PORTC &= ~(1<<6);
+}
+
 static void select_row(uint8_t row)
 {
-    if (row < 7) {
-        // select on mcp23018
-        if (mcp23018_status) { // if there was an error
-            // do nothing
-        } else {
-            // set active row low  : 0
-            // set other rows hi-Z : 1
-            mcp23018_status = i2c_start(I2C_ADDR_WRITE);        if (mcp23018_status) goto out;
-            mcp23018_status = i2c_write(GPIOA);                 if (mcp23018_status) goto out;
-            mcp23018_status = i2c_write( 0xFF & ~(1<<row)
-                                  & ~(0<<7)
-                              );                                if (mcp23018_status) goto out;
-        out:
-            i2c_stop();
-        }
-    } else {
+    // the rows on the mcp23018 are selected by mcp23018_start_scan
+    if (row >= MCP23018_ROWS) {
         // select on teensy
         // Output low(DDR:1, PORT:0) to select
         switch (row) {
@@ -15,8 +15,10 @@
 #----------------------------------------------------------------------------
 
 # # project specific files
-SRC = twimaster.c \
-	  matrix.c
+SRC = matrix.c
+
+# The left half is scanned over i2c, with the shared TWI driver
+TWI_ENABLE = yes
 
 # MCU name
 MCU = atmega32u4
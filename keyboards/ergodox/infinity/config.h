@@ -50,7 +50,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define DEBOUNCE    5
 
 #define SERIAL_LINK_BAUD 562500
+// The links start at SERIAL_LINK_BAUD, and go faster when the cable allows it
+#define SERIAL_LINK_BAUD_RATES {SERIAL_LINK_BAUD, 1125000, 2250000}
 #define SERIAL_LINK_THREAD_PRIORITY (NORMALPRIO - 1)
+// The other half is the only slave, its buffers take about 300 bytes of the
+// SERIAL_LINK_POOL_SIZE pool
+#define NUM_SLAVES 1
 // The visualizer needs gfx thread priorities
 #define VISUALIZER_THREAD_PRIORITY (NORMAL_PRIORITY - 2)
 
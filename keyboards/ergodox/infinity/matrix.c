@@ -24,6 +24,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "print.h"
 #include "debug.h"
 #include "matrix.h"
+#include "debounce.h"
 
 
 /*
@@ -37,8 +38,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 /* matrix state(1:on, 0:off) */
 static matrix_row_t matrix[MATRIX_ROWS];
 static matrix_row_t matrix_debouncing[LOCAL_MATRIX_ROWS];
-static bool debouncing = false;
-static uint16_t debouncing_time = 0;
 
 
 void matrix_init(void)
@@ -63,12 +62,14 @@ void matrix_init(void)
 
     memset(matrix, 0, MATRIX_ROWS);
     memset(matrix_debouncing, 0, LOCAL_MATRIX_ROWS);
+    debounce_init(LOCAL_MATRIX_ROWS);
 
     matrix_init_quantum();
 }
 
 uint8_t matrix_scan(void)
 {
+    bool changed = false;
     for (int row = 0; row < LOCAL_MATRIX_ROWS; row++) {
         matrix_row_t data = 0;
 
@@ -111,8 +112,7 @@ uint8_t matrix_scan(void)
 
         if (matrix_debouncing[row] != data) {
             matrix_debouncing[row] = data;
-            debouncing = true;
-            debouncing_time = timer_read();
+            changed = true;
         }
     }
 
@@ -123,12 +123,7 @@ uint8_t matrix_scan(void)
     }
 #endif
 
-    if (debouncing && timer_elapsed(debouncing_time) > DEBOUNCE) {
-        for (int row = 0; row < LOCAL_MATRIX_ROWS; row++) {
-            matrix[offset + row] = matrix_debouncing[row];
-        }
-        debouncing = false;
-    }
+    debounce(matrix_debouncing, matrix + offset, LOCAL_MATRIX_ROWS, changed);
     matrix_scan_quantum();
     return 1;
 }
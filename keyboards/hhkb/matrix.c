@@ -26,6 +26,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "util.h"
 #include "timer.h"
 #include "matrix.h"
+#include "debounce.h"
 #include "hhkb_avr.h"
 #include <avr/wdt.h>
 #include "suspend.h"
@@ -41,6 +42,8 @@ static matrix_row_t *matrix;
 static matrix_row_t *matrix_prev;
 static matrix_row_t _matrix0[MATRIX_ROWS];
 static matrix_row_t _matrix1[MATRIX_ROWS];
+// debounced state reported to the keyboard
+static matrix_row_t matrix_debounced[MATRIX_ROWS];
 
 
 inline
@@ -67,8 +70,10 @@ void matrix_init(void)
     // initialize matrix state: all keys off
     for (uint8_t i=0; i < MATRIX_ROWS; i++) _matrix0[i] = 0x00;
     for (uint8_t i=0; i < MATRIX_ROWS; i++) _matrix1[i] = 0x00;
+    for (uint8_t i=0; i < MATRIX_ROWS; i++) matrix_debounced[i] = 0x00;
     matrix = _matrix0;
     matrix_prev = _matrix1;
+    debounce_init(MATRIX_ROWS);
 }
 
 __attribute__ ((weak))
@@ -82,6 +87,7 @@ void matrix_scan_kb(void) {
 uint8_t matrix_scan(void)
 {
     uint8_t *tmp;
+    bool changed = false;
 
     tmp = matrix_prev;
     matrix_prev = matrix;
@@ -148,7 +154,10 @@ uint8_t matrix_scan(void)
             _delay_us(75);
 #endif
         }
-        if (matrix[row] ^ matrix_prev[row]) matrix_last_modified = timer_read32();
+        if (matrix[row] ^ matrix_prev[row]) {
+            matrix_last_modified = timer_read32();
+            changed = true;
+        }
     }
     // power off
     if (KEY_POWER_STATE() &&
@@ -159,6 +168,8 @@ uint8_t matrix_scan(void)
         suspend_power_down();
     }
 
+    debounce(matrix, matrix_debounced, MATRIX_ROWS, changed);
+
     matrix_scan_quantum();
 
     return 1;
@@ -182,13 +193,13 @@ bool matrix_has_ghost(void)
 inline
 bool matrix_is_on(uint8_t row, uint8_t col)
 {
-    return (matrix[row] & (1<<col));
+    return (matrix_debounced[row] & (1<<col));
 }
 
 inline
 matrix_row_t matrix_get_row(uint8_t row)
 {
-    return matrix[row];
+    return matrix_debounced[row];
 }
 
 void matrix_print(void)
@@ -64,6 +64,7 @@ EXTRAKEY_ENABLE ?= yes  # Audio control and System control(+450)
 CONSOLE_ENABLE ?= yes   # Console for debug(+400)
 COMMAND_ENABLE ?= yes   # Commands for debug and configuration
 CUSTOM_MATRIX ?= yes    # Custom matrix file for the HHKB
+DEBOUNCE_TYPE ?= eager_pk # Topre doesn't chatter, so don't delay presses
 # Do not enable SLEEP_LED_ENABLE. it uses the same timer as BACKLIGHT_ENABLE
 # SLEEP_LED_ENABLE ?= yes  # Breathing sleep LED during USB suspend
 # NKRO_ENABLE ?= yes       # USB Nkey Rollover - if this doesn't work, see here: https://github.com/tmk/tmk_keyboard/wiki/FAQ#nkro-doesnt-work
@@ -6,6 +6,7 @@
 #include "wait.h"
 #include "print.h"
 #include "matrix.h"
+#include "debounce.h"
 
 
 /*
@@ -22,8 +23,6 @@
 /* matrix state(1:on, 0:off) */
 static matrix_row_t matrix[MATRIX_ROWS];
 static matrix_row_t matrix_debouncing[MATRIX_ROWS];
-static bool debouncing = false;
-static uint16_t debouncing_time = 0;
 
 
 void matrix_init(void)
@@ -62,10 +61,12 @@ void matrix_init(void)
 #endif
     memset(matrix, 0, MATRIX_ROWS);
     memset(matrix_debouncing, 0, MATRIX_ROWS);
+    debounce_init(MATRIX_ROWS);
 }
 
 uint8_t matrix_scan(void)
 {
+    bool changed = false;
     for (int row = 0; row < MATRIX_ROWS; row++) {
         matrix_row_t data = 0;
     #ifdef INFINITY_LED
@@ -130,17 +131,11 @@ uint8_t matrix_scan(void)
 
         if (matrix_debouncing[row] != data) {
             matrix_debouncing[row] = data;
-            debouncing = true;
-            debouncing_time = timer_read();
+            changed = true;
         }
     }
 
-    if (debouncing && timer_elapsed(debouncing_time) > DEBOUNCE) {
-        for (int row = 0; row < MATRIX_ROWS; row++) {
-            matrix[row] = matrix_debouncing[row];
-        }
-        debouncing = false;
-    }
+    debounce(matrix_debouncing, matrix, MATRIX_ROWS, changed);
     return 1;
 }
 
@@ -41,11 +41,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 // #define USE_I2C
 
+// i2c SCL clock frequency
+#define TWI_SCL_CLOCK 100000UL
+
 // Use serial if not using I2C
 #ifndef USE_I2C
 #  define USE_SERIAL
 #endif
 
+// Use the hardware USART instead of bit-banging the serial, this needs RXI
+// and TXO wired to the serial line, see the readme
+// #define USE_SERIAL_USART
+
 // #define EE_HANDS
 
 #define I2C_MASTER_LEFT
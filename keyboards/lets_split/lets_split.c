@@ -1,4 +1,6 @@
 #include "lets_split.h"
+#include "pro_micro.h"
+#include "split.h"
 
 #ifdef AUDIO_ENABLE
     float tone_startup[][2] = SONG(STARTUP_SOUND);
@@ -6,6 +8,7 @@
 #endif
 
 void matrix_init_kb(void) {
+    TX_RX_LED_INIT;
 
     #ifdef AUDIO_ENABLE
         _delay_ms(20); // gets rid of tick
@@ -30,3 +33,13 @@ void shutdown_user(void) {
 	stop_all_notes();
     #endif
 }
+
+// turn on the indicator led when the halves are disconnected
+void split_transfer_kb(bool ok) {
+    if (ok) {
+        TXLED0;
+    } else {
+        TXLED1;
+    }
+    split_transfer_user(ok);
+}
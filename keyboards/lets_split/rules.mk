@@ -1,8 +1,3 @@
-SRC += matrix.c \
-	   i2c.c \
-	   split_util.c \
-	   serial.c
-
 # MCU name
 #MCU = at90usb1287
 MCU = atmega32u4
@@ -71,4 +66,6 @@ RGBLIGHT_ENABLE ?= no        # Enable WS2812 RGB underlight.  Do not enable this
 # Do not enable SLEEP_LED_ENABLE. it uses the same timer as BACKLIGHT_ENABLE
 SLEEP_LED_ENABLE ?= no    # Breathing sleep LED during USB suspend
 
-CUSTOM_MATRIX = yes
+# The matrix and the link between the halves, see quantum/split/split.h.
+# The transport is selected in config.h
+SPLIT_KEYBOARD = yes
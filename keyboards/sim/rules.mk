@@ -0,0 +1,15 @@
+# Build a host executable instead of firmware, see readme.md
+PLATFORM = NATIVE
+
+# The simulator provides its own matrix fed from the key trace
+CUSTOM_MATRIX = yes
+
+# Build Options
+#   comment out to disable the options.
+#
+BOOTMAGIC_ENABLE ?= no		# Virtual DIP switch configuration
+MOUSEKEY_ENABLE ?= yes		# Mouse keys
+EXTRAKEY_ENABLE ?= yes		# Audio control and System control
+CONSOLE_ENABLE ?= no		# Console for debug
+COMMAND_ENABLE ?= no		# Commands for debug and configuration
+NKRO_ENABLE ?= no			# USB Nkey Rollover
@@ -0,0 +1,49 @@
+#ifndef DEBOUNCE_H
+#define DEBOUNCE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "matrix.h"
+
+/* Debounce time in milliseconds.
+ * DEBOUNCING_DELAY is the old name used by quantum/matrix.c.
+ */
+#ifndef DEBOUNCE
+#   ifdef DEBOUNCING_DELAY
+#       define DEBOUNCE DEBOUNCING_DELAY
+#   else
+#       define DEBOUNCE 5
+#   endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The algorithm is selected with DEBOUNCE_TYPE in rules.mk:
+ *   sym_g    - (default) deferred, global. Changes are reported once the
+ *              whole matrix has been stable for DEBOUNCE ms.
+ *   sym_pr   - deferred, per row. A bouncing row doesn't hold back others.
+ *   eager_pk - per key. Presses are reported on the first edge, releases
+ *              once the key has read released for DEBOUNCE ms.
+ *   custom   - no built-in algorithm, the keyboard provides its own.
+ *
+ * None of them block, debounce() should be called once per scan.
+ */
+
+void debounce_init(uint8_t num_rows);
+
+/* Fold the raw scan into the debounced matrix.
+ * changed tells whether raw differs from the previous scan.
+ * Returns true if the debounced matrix was modified.
+ */
+bool debounce(matrix_row_t raw[], matrix_row_t cooked[], uint8_t num_rows, bool changed);
+
+/* true while there are changes that haven't been reported yet */
+bool debounce_active(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
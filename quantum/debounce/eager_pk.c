@@ -0,0 +1,94 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Per-key debounce, eager on press and deferred on release.
+ * A press is reported on the first edge. A release is reported once the
+ * key has read released for DEBOUNCE ms, so bounces on either edge never
+ * leak through as extra key events.
+ */
+#include "debounce.h"
+#include "timer.h"
+
+#if DEBOUNCE > 255
+#   error "DEBOUNCE must fit in 8 bits for eager_pk"
+#endif
+
+/* ms left until a released key is reported, 0 when idle */
+static uint8_t release_timer[MATRIX_ROWS * MATRIX_COLS];
+static uint16_t releases_pending = 0;
+static uint16_t last_time;
+
+void debounce_init(uint8_t num_rows) {
+    for (uint16_t i = 0; i < (uint16_t)num_rows * MATRIX_COLS; i++) {
+        release_timer[i] = 0;
+    }
+    releases_pending = 0;
+}
+
+bool debounce(matrix_row_t raw[], matrix_row_t cooked[], uint8_t num_rows, bool changed) {
+    bool cooked_changed = false;
+
+    if (!changed && !releases_pending) {
+        return false;
+    }
+
+    uint16_t now = timer_read();
+    uint8_t elapsed = 0;
+    if (releases_pending) {
+        uint16_t diff = TIMER_DIFF_16(now, last_time);
+        elapsed = diff > UINT8_MAX ? UINT8_MAX : diff;
+    }
+    last_time = now;
+
+    uint8_t *timer = release_timer;
+    for (uint8_t row = 0; row < num_rows; row++) {
+        matrix_row_t delta = raw[row] ^ cooked[row];
+        for (uint8_t col = 0; col < MATRIX_COLS; col++, timer++) {
+            matrix_row_t mask = (matrix_row_t)1 << col;
+            if (!(delta & mask)) {
+                if (*timer) {
+                    // bounced back to pressed, start over on the next release
+                    *timer = 0;
+                    releases_pending--;
+                }
+            } else if (raw[row] & mask) {
+                cooked[row] |= mask;
+                cooked_changed = true;
+            } else if (*timer) {
+                if (*timer <= elapsed) {
+                    *timer = 0;
+                    releases_pending--;
+                    cooked[row] &= ~mask;
+                    cooked_changed = true;
+                } else {
+                    *timer -= elapsed;
+                }
+            } else if (DEBOUNCE == 0) {
+                cooked[row] &= ~mask;
+                cooked_changed = true;
+            } else {
+                *timer = DEBOUNCE;
+                releases_pending++;
+            }
+        }
+    }
+
+    return cooked_changed;
+}
+
+bool debounce_active(void) {
+    return releases_pending != 0;
+}
@@ -0,0 +1,52 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Symmetric, deferred, global debounce.
+ * Any change restarts a single timer, and the whole matrix is copied once
+ * nothing has changed for DEBOUNCE ms.
+ */
+#include "debounce.h"
+#include "timer.h"
+
+static bool debouncing = false;
+static uint16_t debouncing_time;
+
+void debounce_init(uint8_t num_rows) {
+    debouncing = false;
+}
+
+bool debounce(matrix_row_t raw[], matrix_row_t cooked[], uint8_t num_rows, bool changed) {
+    bool cooked_changed = false;
+
+    if (changed) {
+        debouncing = true;
+        debouncing_time = timer_read();
+    }
+
+    if (debouncing && timer_elapsed(debouncing_time) >= DEBOUNCE) {
+        for (uint8_t i = 0; i < num_rows; i++) {
+            cooked_changed |= cooked[i] != raw[i];
+            cooked[i] = raw[i];
+        }
+        debouncing = false;
+    }
+
+    return cooked_changed;
+}
+
+bool debounce_active(void) {
+    return debouncing;
+}
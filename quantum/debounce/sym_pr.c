@@ -0,0 +1,67 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Symmetric, deferred, per-row debounce.
+ * Each row keeps its own timer, so a row is copied once it alone has been
+ * stable for DEBOUNCE ms.
+ */
+#include "debounce.h"
+#include "timer.h"
+
+static matrix_row_t last_raw[MATRIX_ROWS];
+static uint16_t row_time[MATRIX_ROWS];
+static bool row_debouncing[MATRIX_ROWS];
+static uint8_t rows_debouncing = 0;
+
+void debounce_init(uint8_t num_rows) {
+    for (uint8_t i = 0; i < num_rows; i++) {
+        last_raw[i] = 0;
+        row_debouncing[i] = false;
+    }
+    rows_debouncing = 0;
+}
+
+bool debounce(matrix_row_t raw[], matrix_row_t cooked[], uint8_t num_rows, bool changed) {
+    bool cooked_changed = false;
+
+    if (!changed && !rows_debouncing) {
+        return false;
+    }
+
+    uint16_t now = timer_read();
+    for (uint8_t i = 0; i < num_rows; i++) {
+        if (raw[i] != last_raw[i]) {
+            last_raw[i] = raw[i];
+            row_time[i] = now;
+            if (!row_debouncing[i]) {
+                row_debouncing[i] = true;
+                rows_debouncing++;
+            }
+        }
+        if (row_debouncing[i] && TIMER_DIFF_16(now, row_time[i]) >= DEBOUNCE) {
+            cooked_changed |= cooked[i] != raw[i];
+            cooked[i] = raw[i];
+            row_debouncing[i] = false;
+            rows_debouncing--;
+        }
+    }
+
+    return cooked_changed;
+}
+
+bool debounce_active(void) {
+    return rows_debouncing != 0;
+}
@@ -0,0 +1,229 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+#include <vector>
+#include <iostream>
+
+extern "C" {
+#include "debounce.h"
+#include "timer.h"
+}
+
+#if defined(DEBOUNCE_SYM_G)
+static const char* algorithm = "sym_g";
+#elif defined(DEBOUNCE_SYM_PR)
+static const char* algorithm = "sym_pr";
+#elif defined(DEBOUNCE_EAGER_PK)
+static const char* algorithm = "eager_pk";
+#endif
+
+// Real matrices are scanned several times per timer tick
+static const int scans_per_ms = 4;
+
+struct raw_change {
+    uint16_t time;
+    uint8_t row;
+    uint8_t col;
+    bool pressed;
+};
+
+struct key_event {
+    uint16_t time;
+    bool pressed;
+};
+
+static bool operator==(const key_event& a, const key_event& b) {
+    return a.time == b.time && a.pressed == b.pressed;
+}
+
+static std::ostream& operator<<(std::ostream& os, const key_event& e) {
+    return os << (e.pressed ? "down" : "up") << "@" << e.time;
+}
+
+static uint16_t now;
+
+extern "C" {
+uint16_t timer_read(void) {
+    return now;
+}
+
+uint16_t timer_elapsed(uint16_t last) {
+    return TIMER_DIFF_16(now, last);
+}
+}
+
+class Debounce : public testing::Test {
+public:
+    Debounce() {
+        now = 0;
+        debounce_init(MATRIX_ROWS);
+    }
+
+    // Replay a bounce trace, scanning until the given time
+    void run(const std::vector<raw_change>& trace, uint16_t until) {
+        auto next = trace.begin();
+        for (; now <= until; now++) {
+            for (; next != trace.end() && next->time == now; ++next) {
+                matrix_row_t mask = (matrix_row_t)1 << next->col;
+                raw[next->row] = next->pressed ? raw[next->row] | mask : raw[next->row] & ~mask;
+            }
+            for (int i = 0; i < scans_per_ms; i++) {
+                scan();
+            }
+        }
+    }
+
+    void scan() {
+        bool changed = false;
+        for (int r = 0; r < MATRIX_ROWS; r++) {
+            changed |= raw[r] != last_raw[r];
+            last_raw[r] = raw[r];
+        }
+        matrix_row_t before[MATRIX_ROWS];
+        std::copy(cooked, cooked + MATRIX_ROWS, before);
+        bool reported = debounce(raw, cooked, MATRIX_ROWS, changed);
+        bool modified = false;
+        for (int r = 0; r < MATRIX_ROWS; r++) {
+            matrix_row_t delta = before[r] ^ cooked[r];
+            modified |= delta != 0;
+            for (int c = 0; c < MATRIX_COLS; c++) {
+                if (delta & ((matrix_row_t)1 << c)) {
+                    events[r][c].push_back({now, (cooked[r] & ((matrix_row_t)1 << c)) != 0});
+                }
+            }
+        }
+        EXPECT_EQ(reported, modified);
+    }
+
+    void report_latency(const char* trace, uint8_t row, uint8_t col, uint16_t pressed, uint16_t released) {
+        auto& e = events[row][col];
+        ASSERT_EQ(e.size(), 2);
+        std::cout << "[ LATENCY  ] " << algorithm << " " << trace
+                  << ": press " << e[0].time - pressed << " ms"
+                  << ", release " << e[1].time - released << " ms" << std::endl;
+    }
+
+    matrix_row_t raw[MATRIX_ROWS] = {};
+    matrix_row_t last_raw[MATRIX_ROWS] = {};
+    matrix_row_t cooked[MATRIX_ROWS] = {};
+    std::vector<key_event> events[MATRIX_ROWS][MATRIX_COLS];
+};
+
+TEST_F(Debounce, clean_press_and_release) {
+    run({
+        {10, 1, 3, true},
+        {100, 1, 3, false},
+    }, 200);
+#if defined(DEBOUNCE_EAGER_PK)
+    std::vector<key_event> expected = {{10, true}, {105, false}};
+#else
+    std::vector<key_event> expected = {{15, true}, {105, false}};
+#endif
+    EXPECT_EQ(events[1][3], expected);
+    report_latency("clean", 1, 3, 10, 100);
+    EXPECT_FALSE(debounce_active());
+}
+
+TEST_F(Debounce, chatter_on_both_edges_is_a_single_keystroke) {
+    run({
+        {10, 0, 0, true},
+        {11, 0, 0, false},
+        {12, 0, 0, true},
+        {13, 0, 0, false},
+        {14, 0, 0, true},
+        {100, 0, 0, false},
+        {101, 0, 0, true},
+        {102, 0, 0, false},
+    }, 200);
+#if defined(DEBOUNCE_EAGER_PK)
+    std::vector<key_event> expected = {{10, true}, {107, false}};
+#else
+    std::vector<key_event> expected = {{19, true}, {107, false}};
+#endif
+    EXPECT_EQ(events[0][0], expected);
+    report_latency("chatter", 0, 0, 10, 100);
+}
+
+TEST_F(Debounce, bounce_on_one_key_and_a_clean_key_on_another_row) {
+    run({
+        {10, 0, 2, true},
+        {11, 0, 2, false},
+        {12, 2, 5, true},
+        {13, 0, 2, true},
+        {14, 0, 2, false},
+        {50, 2, 5, false},
+    }, 100);
+    // the bouncing key never settled pressed
+#if defined(DEBOUNCE_EAGER_PK)
+    std::vector<key_event> bouncing = {{10, true}, {19, false}};
+    std::vector<key_event> clean = {{12, true}, {55, false}};
+#elif defined(DEBOUNCE_SYM_PR)
+    std::vector<key_event> bouncing = {};
+    std::vector<key_event> clean = {{17, true}, {55, false}};
+#else
+    std::vector<key_event> bouncing = {};
+    std::vector<key_event> clean = {{19, true}, {55, false}};
+#endif
+    EXPECT_EQ(events[0][2], bouncing);
+    EXPECT_EQ(events[2][5], clean);
+    report_latency("neighbour bounce", 2, 5, 12, 50);
+}
+
+TEST_F(Debounce, fast_roll_across_rows) {
+    run({
+        {10, 0, 1, true},
+        {11, 1, 1, true},
+        {12, 2, 1, true},
+        {13, 3, 1, true},
+        {40, 0, 1, false},
+        {41, 1, 1, false},
+        {42, 2, 1, false},
+        {43, 3, 1, false},
+    }, 100);
+    for (int r = 0; r < MATRIX_ROWS; r++) {
+        ASSERT_EQ(events[r][1].size(), 2);
+#if defined(DEBOUNCE_EAGER_PK)
+        EXPECT_EQ(events[r][1][0].time, 10 + r);
+#elif defined(DEBOUNCE_SYM_PR)
+        EXPECT_EQ(events[r][1][0].time, 15 + r);
+#else
+        // a global timer waits for the whole roll to settle
+        EXPECT_EQ(events[r][1][0].time, 18);
+#endif
+    }
+    report_latency("roll, last key", 3, 1, 13, 43);
+}
+
+TEST_F(Debounce, is_active_until_changes_are_reported) {
+    run({{10, 0, 0, true}}, 10);
+#if defined(DEBOUNCE_EAGER_PK)
+    EXPECT_FALSE(debounce_active());
+#else
+    EXPECT_TRUE(debounce_active());
+#endif
+    run({{11, 0, 0, false}}, 11);
+    EXPECT_TRUE(debounce_active());
+    run({}, 30);
+    EXPECT_FALSE(debounce_active());
+}
+
+TEST_F(Debounce, idle_scans_report_nothing) {
+    run({}, 1000);
+    for (int r = 0; r < MATRIX_ROWS; r++) {
+        EXPECT_EQ(cooked[r], 0);
+    }
+    EXPECT_FALSE(debounce_active());
+}
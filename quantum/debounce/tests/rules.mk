@@ -0,0 +1,19 @@
+DEBOUNCE_COMMON_DEFS := \
+	-DMATRIX_ROWS=4 \
+	-DMATRIX_COLS=8 \
+	-DDEBOUNCE=5
+
+debounce_sym_g_DEFS := $(DEBOUNCE_COMMON_DEFS) -DDEBOUNCE_SYM_G
+debounce_sym_g_SRC := \
+	$(QUANTUM_PATH)/debounce/tests/debounce_tests.cpp \
+	$(QUANTUM_PATH)/debounce/sym_g.c
+
+debounce_sym_pr_DEFS := $(DEBOUNCE_COMMON_DEFS) -DDEBOUNCE_SYM_PR
+debounce_sym_pr_SRC := \
+	$(QUANTUM_PATH)/debounce/tests/debounce_tests.cpp \
+	$(QUANTUM_PATH)/debounce/sym_pr.c
+
+debounce_eager_pk_DEFS := $(DEBOUNCE_COMMON_DEFS) -DDEBOUNCE_EAGER_PK
+debounce_eager_pk_SRC := \
+	$(QUANTUM_PATH)/debounce/tests/debounce_tests.cpp \
+	$(QUANTUM_PATH)/debounce/eager_pk.c
@@ -145,9 +145,11 @@ action_t action_for_key(uint8_t layer, keypos_t key)
     return action;
 }
 
+// One entry, so reading it isn't out of bounds for the compiler, like an
+// empty array would be
 __attribute__ ((weak))
 const uint16_t PROGMEM fn_actions[] = {
-
+    [0] = ACTION_NO
 };
 
 /* Macro */
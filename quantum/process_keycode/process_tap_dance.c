@@ -70,6 +70,9 @@ bool process_tap_dance(uint16_t keycode, keyrecord_t *record) {
       action->state.keycode = keycode;
       action->state.count++;
       action->state.timer = timer_read();
+#ifdef TAPPING_TERM_PER_KEY
+      action->state.tapping_term = get_tapping_term(record->event.key);
+#endif
       process_tap_dance_action_on_each_tap (action);
 
       if (last_td && last_td != keycode) {
@@ -112,7 +115,12 @@ void matrix_scan_tap_dance () {
   for (int i = 0; i <= highest_td; i++) {
     qk_tap_dance_action_t *action = &tap_dance_actions[i];
 
-    if (action->state.count && timer_elapsed (action->state.timer) > TAPPING_TERM) {
+#ifdef TAPPING_TERM_PER_KEY
+    uint16_t tapping_term = action->state.tapping_term;
+#else
+    uint16_t tapping_term = TAPPING_TERM;
+#endif
+    if (action->state.count && timer_elapsed (action->state.timer) > tapping_term) {
       process_tap_dance_action_on_dance_finished (action);
       reset_tap_dance (&action->state);
     }
@@ -11,6 +11,9 @@ typedef struct
   uint8_t count;
   uint16_t keycode;
   uint16_t timer;
+#ifdef TAPPING_TERM_PER_KEY
+  uint16_t tapping_term;
+#endif
   bool interrupted;
   bool pressed;
   bool finished;
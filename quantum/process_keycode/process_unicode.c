@@ -48,6 +48,7 @@ void unicode_input_start (void) {
     register_code(KC_U);
     unregister_code(KC_U);
   }
+  flush_keyboard_report();
   wait_ms(UNICODE_TYPE_DELAY);
 }
 
@@ -170,6 +171,7 @@ void qk_ucis_symbol_fallback (void) {
     uint8_t code = qk_ucis_state.codes[i];
     register_code(code);
     unregister_code(code);
+    flush_keyboard_report();
     wait_ms(UNICODE_TYPE_DELAY);
   }
 }
@@ -197,6 +199,7 @@ void register_ucis(const char *hex) {
     if (kc) {
       register_code (kc);
       unregister_code (kc);
+      flush_keyboard_report();
       wait_ms (UNICODE_TYPE_DELAY);
     }
   }
@@ -235,6 +238,7 @@ bool process_ucis (uint16_t keycode, keyrecord_t *record) {
     for (i = qk_ucis_state.count; i > 0; i--) {
       register_code (KC_BSPC);
       unregister_code (KC_BSPC);
+      flush_keyboard_report();
       wait_ms(UNICODE_TYPE_DELAY);
     }
 
@@ -54,6 +54,7 @@ bool process_record_user(uint16_t keycode, keyrecord_t *record) {
 
 void reset_keyboard(void) {
   clear_keyboard();
+  flush_keyboard_report();
 #ifdef AUDIO_ENABLE
   stop_all_notes();
   shutdown_user();
@@ -275,6 +276,7 @@ bool process_record_quantum(keyrecord_t *record) {
             break;
         }
         eeconfig_update_keymap(keymap_config.raw);
+        layer_cache_invalidate(); // cached actions depend on keymap_config
         clear_keyboard(); // clear to prevent stuck keys
 
         return false;
@@ -206,7 +206,9 @@ void rgblight_step(void) {
   rgblight_mode(mode);
 }
 
-void rgblight_mode(uint8_t mode) {
+static void rgblight_sethsv_eeprom_helper(uint16_t hue, uint8_t sat, uint8_t val, bool write_to_eeprom);
+
+static void rgblight_mode_eeprom_helper(uint8_t mode, bool write_to_eeprom) {
   if (!rgblight_config.enable) {
     return;
   }
@@ -217,7 +219,9 @@ void rgblight_mode(uint8_t mode) {
   } else {
     rgblight_config.mode = mode;
   }
-  eeconfig_update_rgblight(rgblight_config.raw);
+  if (write_to_eeprom) {
+    eeconfig_update_rgblight(rgblight_config.raw);
+  }
   xprintf("rgblight mode: %u\n", rgblight_config.mode);
   if (rgblight_config.mode == 1) {
     #if !defined(AUDIO_ENABLE) && defined(RGBLIGHT_TIMER)
@@ -234,7 +238,37 @@ void rgblight_mode(uint8_t mode) {
       rgblight_timer_enable();
     #endif
   }
-  rgblight_sethsv(rgblight_config.hue, rgblight_config.sat, rgblight_config.val);
+  rgblight_sethsv_eeprom_helper(rgblight_config.hue, rgblight_config.sat, rgblight_config.val, write_to_eeprom);
+}
+
+void rgblight_mode(uint8_t mode) {
+  rgblight_mode_eeprom_helper(mode, true);
+}
+
+static void rgblight_update_dword_eeprom_helper(uint32_t dword, bool write_to_eeprom) {
+  rgblight_config.raw = dword;
+  if (write_to_eeprom) {
+    eeconfig_update_rgblight(rgblight_config.raw);
+  }
+  if (rgblight_config.enable) {
+    rgblight_mode_eeprom_helper(rgblight_config.mode, write_to_eeprom);
+  } else {
+    #if !defined(AUDIO_ENABLE) && defined(RGBLIGHT_TIMER)
+      rgblight_timer_disable();
+    #endif
+    rgblight_set();
+  }
+}
+
+// Takes over a whole configuration, like the one of the master of a split
+// keyboard
+void rgblight_update_dword(uint32_t dword) {
+  rgblight_update_dword_eeprom_helper(dword, true);
+}
+
+// The same, but keeps the configuration saved in the EEPROM
+void rgblight_update_dword_noeeprom(uint32_t dword) {
+  rgblight_update_dword_eeprom_helper(dword, false);
 }
 
 void rgblight_toggle(void) {
@@ -316,7 +350,7 @@ void rgblight_sethsv_noeeprom(uint16_t hue, uint8_t sat, uint8_t val) {
     rgblight_setrgb(tmp_led.r, tmp_led.g, tmp_led.b);
   }
 }
-void rgblight_sethsv(uint16_t hue, uint8_t sat, uint8_t val) {
+static void rgblight_sethsv_eeprom_helper(uint16_t hue, uint8_t sat, uint8_t val, bool write_to_eeprom) {
   if (rgblight_config.enable) {
     if (rgblight_config.mode == 1) {
       // same static color
@@ -334,11 +368,17 @@ void rgblight_sethsv(uint16_t hue, uint8_t sat, uint8_t val) {
     rgblight_config.hue = hue;
     rgblight_config.sat = sat;
     rgblight_config.val = val;
-    eeconfig_update_rgblight(rgblight_config.raw);
-    xprintf("rgblight set hsv [EEPROM]: %u,%u,%u\n", rgblight_config.hue, rgblight_config.sat, rgblight_config.val);
+    if (write_to_eeprom) {
+      eeconfig_update_rgblight(rgblight_config.raw);
+      xprintf("rgblight set hsv [EEPROM]: %u,%u,%u\n", rgblight_config.hue, rgblight_config.sat, rgblight_config.val);
+    }
   }
 }
 
+void rgblight_sethsv(uint16_t hue, uint8_t sat, uint8_t val) {
+  rgblight_sethsv_eeprom_helper(hue, sat, val, true);
+}
+
 void rgblight_setrgb(uint8_t r, uint8_t g, uint8_t b) {
   // dprintf("rgblight set rgb: %u,%u,%u\n", r,g,b);
   for (uint8_t i = 0; i < RGBLED_NUM; i++) {
@@ -57,7 +57,11 @@ typedef union {
   };
 } rgblight_config_t;
 
+extern rgblight_config_t rgblight_config;
+
 void rgblight_init(void);
+void rgblight_update_dword(uint32_t dword);
+void rgblight_update_dword_noeeprom(uint32_t dword);
 void rgblight_increase(void);
 void rgblight_decrease(void);
 void rgblight_toggle(void);
@@ -0,0 +1,95 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SERIAL_LINK_ATOMIC_STATE_H
+#define SERIAL_LINK_ATOMIC_STATE_H
+
+// Compare and swap of the state byte of the buffered objects. It uses
+// LDREXB/STREXB on ARMv7-M, C11 atomics when SERIAL_LINK_STDATOMIC is defined,
+// and serial_link_lock anywhere else.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "serial_link/system/serial_link.h"
+#ifdef SERIAL_LINK_STDATOMIC
+#include <stdatomic.h>
+#endif
+
+#if defined(SERIAL_LINK_STDATOMIC)
+
+static inline uint8_t load_state(uint8_t* state) {
+    return atomic_load_explicit((_Atomic uint8_t*)state, memory_order_acquire);
+}
+
+static inline bool compare_and_swap_state(uint8_t* state, uint8_t expected, uint8_t desired) {
+    return atomic_compare_exchange_weak_explicit((_Atomic uint8_t*)state, &expected, desired,
+        memory_order_acq_rel, memory_order_acquire);
+}
+
+#elif defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+
+static inline uint8_t load_state(uint8_t* state) {
+    uint8_t value = *(volatile uint8_t*)state;
+    __asm__ volatile ("dmb" ::: "memory");
+    return value;
+}
+
+// The exclusive monitor is cleared by any exception, so the store fails when
+// an interrupt or a thread switch came in between
+static inline bool compare_and_swap_state(uint8_t* state, uint8_t expected, uint8_t desired) {
+    uint32_t current;
+    uint32_t failed;
+    // Make the buffer written by the writer visible before the state
+    __asm__ volatile ("dmb" ::: "memory");
+    __asm__ volatile ("ldrexb %0, [%1]" : "=r" (current) : "r" (state) : "memory");
+    if (current != expected) {
+        __asm__ volatile ("clrex" ::: "memory");
+        return false;
+    }
+    __asm__ volatile ("strexb %0, %2, [%1]" : "=&r" (failed) : "r" (state), "r" (desired) : "memory");
+    __asm__ volatile ("dmb" ::: "memory");
+    return failed == 0;
+}
+
+#else
+
+// No exclusive access instructions, so fall back to the lock
+static inline uint8_t load_state(uint8_t* state) {
+    return *(volatile uint8_t*)state;
+}
+
+static inline bool compare_and_swap_state(uint8_t* state, uint8_t expected, uint8_t desired) {
+    bool swapped = false;
+    serial_link_lock();
+    if (*state == expected) {
+        *state = desired;
+        swapped = true;
+    }
+    serial_link_unlock();
+    return swapped;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,270 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "serial_link/protocol/baud_negotiation.h"
+#include "serial_link/protocol/frame_router.h"
+#include "serial_link/protocol/frame_validator.h"
+#include "serial_link/protocol/link_stats.h"
+#include "serial_link/protocol/physical.h"
+#include "timer.h"
+#include <stdbool.h>
+
+// The messages are [type][rate index]
+enum {
+    BAUD_PROPOSE,
+    BAUD_ACCEPT,
+    BAUD_CONFIRM,
+    BAUD_CONFIRMED,
+    BAUD_FALLBACK,
+};
+
+// The end that proposes the steps
+#define LEADER_LINK DOWN_LINK
+
+static const uint32_t* rates;
+static uint8_t num_rates;
+static baud_link_t links[NUM_LINKS];
+// The number of frames last seen on each link, to notice when it goes silent
+static uint32_t frames_seen[NUM_LINKS];
+
+static uint32_t count_errors(uint8_t link) {
+    link_counters_t* c = &link_stats.links[link];
+    return c->crc_errors + c->cobs_resets + c->oversize_frames + c->overruns + c->line_errors;
+}
+
+static void send_message(uint8_t link, uint8_t type, uint8_t rate) {
+    uint8_t frame[2 + 1 + FRAME_CRC_SIZE];
+    frame[0] = type;
+    frame[1] = rate;
+    router_send_link_frame(link, frame, 2);
+}
+
+static void set_rate(uint8_t link, uint8_t rate) {
+    links[link].rate = rate;
+    physical_set_baud(link, rates[rate]);
+}
+
+static void start_window(uint8_t link, uint16_t now) {
+    baud_link_t* l = &links[link];
+    l->state = BAUD_STABLE;
+    l->window_time = now;
+    l->window_frames = link_stats.links[link].frames_received;
+    l->window_errors = count_errors(link);
+}
+
+static void enter_state(uint8_t link, uint8_t state, uint16_t now) {
+    links[link].state = state;
+    links[link].state_time = now;
+}
+
+static bool window_is_bad(uint8_t link) {
+    baud_link_t* l = &links[link];
+    uint32_t frames = link_stats.links[link].frames_received - l->window_frames;
+    uint32_t errors = count_errors(link) - l->window_errors;
+    return errors >= 2 && errors * BAUD_ERROR_RATIO > frames;
+}
+
+static bool window_is_clean(uint8_t link) {
+    baud_link_t* l = &links[link];
+    uint32_t frames = link_stats.links[link].frames_received - l->window_frames;
+    return count_errors(link) == l->window_errors && frames >= BAUD_MIN_FRAMES;
+}
+
+static void fall_back(uint8_t link, uint16_t now) {
+    baud_link_t* l = &links[link];
+    if (l->rate > 0) {
+        uint8_t rate = l->state == BAUD_PROBATION ? l->previous_rate : l->rate - 1;
+        // Sent at the old rate, the other end might still get it
+        send_message(link, BAUD_FALLBACK, rate);
+        set_rate(link, rate);
+        l->max_rate = rate;
+    }
+    start_window(link, now);
+}
+
+static uint16_t remaining(uint16_t start, uint16_t duration, uint16_t now) {
+    uint16_t elapsed = now - start;
+    return elapsed >= duration ? 0 : duration - elapsed;
+}
+
+void baud_negotiation_init(const uint32_t* rate_table, uint8_t num) {
+    rates = rate_table;
+    num_rates = num > BAUD_MAX_RATES ? BAUD_MAX_RATES : num;
+    uint16_t now = timer_read();
+    for (uint8_t i = 0; i < NUM_LINKS; i++) {
+        baud_link_t* l = &links[i];
+        l->previous_rate = 0;
+        l->max_rate = num_rates - 1;
+        l->last_frame_time = now;
+        frames_seen[i] = link_stats.links[i].frames_received;
+        set_rate(i, 0);
+        start_window(i, now);
+    }
+}
+
+static uint16_t update_link(uint8_t link, uint16_t now) {
+    baud_link_t* l = &links[link];
+    if (link_stats.links[link].frames_received != frames_seen[link]) {
+        frames_seen[link] = link_stats.links[link].frames_received;
+        l->last_frame_time = now;
+    }
+    if (l->rate != 0 && remaining(l->last_frame_time, BAUD_SILENCE_MS, now) == 0) {
+        // The other end is at another rate, or gone, meet it at the safe one
+        set_rate(link, 0);
+        start_window(link, now);
+    }
+
+    switch (l->state) {
+    case BAUD_WAIT_ACCEPT:
+        if (remaining(l->state_time, BAUD_RESPONSE_TIMEOUT_MS, now) == 0) {
+            start_window(link, now);
+        }
+        break;
+    case BAUD_WAIT_CONFIRM:
+        if (remaining(l->state_time, BAUD_RESPONSE_TIMEOUT_MS, now) == 0) {
+            set_rate(link, l->previous_rate);
+            start_window(link, now);
+        }
+        break;
+    case BAUD_WAIT_CONFIRMED:
+        if (remaining(l->state_time, BAUD_RESPONSE_TIMEOUT_MS, now) == 0) {
+            set_rate(link, l->previous_rate);
+            l->max_rate = l->previous_rate;
+            start_window(link, now);
+        }
+        break;
+    case BAUD_PROBATION:
+        if (remaining(l->window_time, BAUD_PROBATION_MS, now) == 0) {
+            if (window_is_bad(link)) {
+                fall_back(link, now);
+            }
+            else {
+                start_window(link, now);
+            }
+        }
+        break;
+    default:
+        if (remaining(l->window_time, BAUD_STEP_INTERVAL_MS, now) == 0) {
+            if (window_is_bad(link)) {
+                fall_back(link, now);
+            }
+            else if (link == LEADER_LINK && l->rate < l->max_rate && window_is_clean(link)) {
+                send_message(link, BAUD_PROPOSE, l->rate + 1);
+                enter_state(link, BAUD_WAIT_ACCEPT, now);
+            }
+            else {
+                start_window(link, now);
+            }
+        }
+        break;
+    }
+
+    uint16_t wait;
+    if (l->state == BAUD_STABLE) {
+        wait = remaining(l->window_time, BAUD_STEP_INTERVAL_MS, now);
+    }
+    else if (l->state == BAUD_PROBATION) {
+        wait = remaining(l->window_time, BAUD_PROBATION_MS, now);
+    }
+    else {
+        wait = remaining(l->state_time, BAUD_RESPONSE_TIMEOUT_MS, now);
+    }
+    if (l->rate != 0) {
+        uint16_t silence = remaining(l->last_frame_time, BAUD_SILENCE_MS, now);
+        if (silence < wait) {
+            wait = silence;
+        }
+    }
+    return wait;
+}
+
+uint16_t baud_negotiation_update(void) {
+    uint16_t now = timer_read();
+    uint16_t wait = 0xFFFF;
+    for (uint8_t i = 0; i < NUM_LINKS; i++) {
+        uint16_t w = update_link(i, now);
+        if (w < wait) {
+            wait = w;
+        }
+    }
+    return wait ? wait : 1;
+}
+
+void baud_negotiation_recv_frame(uint8_t link, uint8_t* data, uint16_t size) {
+    if (size < 2 || data[1] >= num_rates) {
+        return;
+    }
+    baud_link_t* l = &links[link];
+    uint8_t rate = data[1];
+    uint16_t now = timer_read();
+    switch (data[0]) {
+    case BAUD_PROPOSE:
+        if (link != LEADER_LINK && l->state == BAUD_STABLE &&
+                rate > l->rate && rate <= l->max_rate) {
+            // Answered at the old rate, then the proposing end follows
+            send_message(link, BAUD_ACCEPT, rate);
+            l->previous_rate = l->rate;
+            set_rate(link, rate);
+            enter_state(link, BAUD_WAIT_CONFIRM, now);
+        }
+        break;
+    case BAUD_ACCEPT:
+        if (l->state == BAUD_WAIT_ACCEPT && rate == l->rate + 1) {
+            l->previous_rate = l->rate;
+            set_rate(link, rate);
+            send_message(link, BAUD_CONFIRM, rate);
+            enter_state(link, BAUD_WAIT_CONFIRMED, now);
+        }
+        break;
+    case BAUD_CONFIRM:
+        if (l->state == BAUD_WAIT_CONFIRM && rate == l->rate) {
+            send_message(link, BAUD_CONFIRMED, rate);
+            start_window(link, now);
+        }
+        break;
+    case BAUD_CONFIRMED:
+        if (l->state == BAUD_WAIT_CONFIRMED && rate == l->rate) {
+            start_window(link, now);
+            l->state = BAUD_PROBATION;
+        }
+        break;
+    case BAUD_FALLBACK:
+        if (rate < l->rate) {
+            set_rate(link, rate);
+            if (rate < l->max_rate) {
+                l->max_rate = rate;
+            }
+            start_window(link, now);
+        }
+        break;
+    }
+}
+
+uint32_t baud_negotiation_get_baud(uint8_t link) {
+    return rates[links[link].rate];
+}
+
+const baud_link_t* baud_negotiation_get_link(uint8_t link) {
+    return &links[link];
+}
@@ -0,0 +1,111 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SERIAL_LINK_BAUD_NEGOTIATION_H
+#define SERIAL_LINK_BAUD_NEGOTIATION_H
+
+#include <stdint.h>
+#include "serial_link/protocol/byte_stuffer.h"
+
+// Each link starts at the first, safe, rate of a table, and then the two ends
+// of it agree to step up one rate at a time while the line stays clean. A
+// step that doesn't work, or a rate where the errors go up, is fallen back
+// from, and it becomes the highest rate tried on that link. The device above
+// a link, which uses it as its down link, proposes the steps, and either end
+// can fall back. When nothing has been received for a while, both ends return
+// to the safe rate on their own, so they always find each other again.
+//
+// The physical layer has to finish sending what it has before it changes
+// the rate.
+
+// How long a rate has to stay clean before trying the next one
+#ifndef BAUD_STEP_INTERVAL_MS
+#define BAUD_STEP_INTERVAL_MS 1000
+#endif
+
+// How long to wait for the other end to answer during a step
+#ifndef BAUD_RESPONSE_TIMEOUT_MS
+#define BAUD_RESPONSE_TIMEOUT_MS 50
+#endif
+
+// How long a new rate is watched before it's kept
+#ifndef BAUD_PROBATION_MS
+#define BAUD_PROBATION_MS 1000
+#endif
+
+// Return to the safe rate when nothing is received for this long
+#ifndef BAUD_SILENCE_MS
+#define BAUD_SILENCE_MS 500
+#endif
+
+// A rate is too fast when more than one out of this many frames has errors
+#ifndef BAUD_ERROR_RATIO
+#define BAUD_ERROR_RATIO 32
+#endif
+
+// Fewer frames than this in a step interval is too little to step up on
+#ifndef BAUD_MIN_FRAMES
+#define BAUD_MIN_FRAMES 4
+#endif
+
+#define BAUD_MAX_RATES 8
+
+typedef enum {
+    BAUD_STABLE,
+    // The proposing end has asked for the next rate
+    BAUD_WAIT_ACCEPT,
+    // The other end has switched, and waits for the first frame at the new rate
+    BAUD_WAIT_CONFIRM,
+    // The proposing end has switched too, and waits for the answer to it
+    BAUD_WAIT_CONFIRMED,
+    // Both ends are at the new rate, and the errors are watched
+    BAUD_PROBATION,
+} baud_state_t;
+
+typedef struct {
+    uint8_t state;
+    uint8_t rate;
+    // The rate to return to when a step fails
+    uint8_t previous_rate;
+    // The highest rate that hasn't failed
+    uint8_t max_rate;
+    uint16_t state_time;
+    uint16_t window_time;
+    uint16_t last_frame_time;
+    // The counters at the start of the window
+    uint32_t window_frames;
+    uint32_t window_errors;
+} baud_link_t;
+
+// Sets both links to the first rate, the table has to stay valid
+void baud_negotiation_init(const uint32_t* rates, uint8_t num_rates);
+// Call it regularly, returns the number of milliseconds until it needs to be
+// called again at the latest
+uint16_t baud_negotiation_update(void);
+// Called by the router with the frames from the other end of a link
+void baud_negotiation_recv_frame(uint8_t link, uint8_t* data, uint16_t size);
+uint32_t baud_negotiation_get_baud(uint8_t link);
+const baud_link_t* baud_negotiation_get_link(uint8_t link);
+
+#endif
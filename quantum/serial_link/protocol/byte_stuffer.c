@@ -25,7 +25,9 @@ SOFTWARE.
 #include "serial_link/protocol/byte_stuffer.h"
 #include "serial_link/protocol/frame_validator.h"
 #include "serial_link/protocol/physical.h"
+#include "serial_link/protocol/link_stats.h"
 #include <stdbool.h>
+#include <string.h>
 
 // This implements the "Consistent overhead byte stuffing protocol"
 // https://en.wikipedia.org/wiki/Consistent_Overhead_Byte_Stuffing
@@ -74,12 +76,14 @@ void byte_stuffer_recv_byte(uint8_t link, uint8_t data) {
         else {
             // The frame is invalid, so reset
             init_byte_stuffer_state(state);
+            link_stats.links[link].cobs_resets++;
         }
     }
     else {
         if (state->data_pos == MAX_FRAME_SIZE) {
             // We exceeded our maximum frame size
             // therefore there's nothing else to do than reset to a new frame
+            link_stats.links[link].oversize_frames++;
             state->next_zero = data;
             state->long_frame = data == 0xFF;
             state->data_pos = 0;
@@ -93,6 +97,7 @@ void byte_stuffer_recv_byte(uint8_t link, uint8_t data) {
             else {
                 // Special case for zeroes
                 state->next_zero = data;
+                state->long_frame = data == 0xFF;
                 state->data[state->data_pos++] = 0;
             }
         }
@@ -102,41 +107,75 @@ void byte_stuffer_recv_byte(uint8_t link, uint8_t data) {
     }
 }
 
-static void send_block(uint8_t link, uint8_t* start, uint8_t* end, uint8_t num_non_zero) {
-    send_data(link, &num_non_zero, 1);
-    if (end > start) {
-        send_data(link, start, end-start);
+void byte_stuffer_recv(uint8_t link, const uint8_t* data, uint16_t size) {
+    byte_stuffer_state_t* state = &states[link];
+    const uint8_t* end = data + size;
+    while (data < end) {
+        // Copy the rest of the current block in one go, as long as the bytes
+        // are plain data, the special cases are left to byte_stuffer_recv_byte
+        if (state->next_zero > 1 && state->data_pos < MAX_FRAME_SIZE) {
+            uint16_t count = state->next_zero - 1;
+            if (count > end - data) {
+                count = end - data;
+            }
+            if (count > MAX_FRAME_SIZE - state->data_pos) {
+                count = MAX_FRAME_SIZE - state->data_pos;
+            }
+            const uint8_t* zero = memchr(data, 0, count);
+            if (zero) {
+                count = zero - data;
+            }
+            memcpy(state->data + state->data_pos, data, count);
+            state->data_pos += count;
+            state->next_zero -= count;
+            data += count;
+            if (data == end) {
+                break;
+            }
+        }
+        byte_stuffer_recv_byte(link, *data++);
     }
 }
 
-void byte_stuffer_send_frame(uint8_t link, uint8_t* data, uint16_t size) {
-    const uint8_t zero = 0;
-    if (size > 0) {
-        uint16_t num_non_zero = 1;
-        uint8_t* end = data + size;
-        uint8_t* start = data;
-        while (data < end) {
-            if (num_non_zero == 0xFF) {
-                // There's more data after big non-zero block
-                // So send it, and start a new block
-                send_block(link, start, data, num_non_zero);
-                start = data;
+uint16_t byte_stuffer_encode(const uint8_t* data, uint16_t size, uint8_t* out) {
+    if (size == 0) {
+        return 0;
+    }
+    const uint8_t* end = data + size;
+    uint8_t* start = out;
+    uint8_t* header = out++;
+    uint8_t num_non_zero = 1;
+    while (data < end) {
+        if (num_non_zero == 0xFF) {
+            // There's more data after big non-zero block, so start a new block
+            *header = num_non_zero;
+            header = out++;
+            num_non_zero = 1;
+        }
+        else {
+            if (*data == 0) {
+                // A zero encountered, so the block ends here
+                *header = num_non_zero;
+                header = out++;
                 num_non_zero = 1;
             }
             else {
-                if (*data == 0) {
-                    // A zero encountered, so send the block
-                    send_block(link, start, data, num_non_zero);
-                    start = data + 1;
-                    num_non_zero = 1;
-                }
-                else {
-                    num_non_zero++;
-                }
-                ++data;
+                *out++ = *data;
+                num_non_zero++;
             }
+            ++data;
         }
-        send_block(link, start, data, num_non_zero);
-        send_data(link, &zero, 1);
+    }
+    *header = num_non_zero;
+    *out++ = 0;
+    return out - start;
+}
+
+void byte_stuffer_send_frame(uint8_t link, uint8_t* data, uint16_t size) {
+    // Only ever used from the serial link thread
+    static uint8_t buffer[BYTE_STUFFER_ENCODED_SIZE(MAX_FRAME_SIZE)];
+    uint16_t encoded_size = byte_stuffer_encode(data, size, buffer);
+    if (encoded_size > 0) {
+        send_data(link, buffer, encoded_size);
     }
 }
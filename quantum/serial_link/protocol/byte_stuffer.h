@@ -30,8 +30,18 @@ SOFTWARE.
 #define MAX_FRAME_SIZE 1024
 #define NUM_LINKS 2
 
+// One header byte for every 254 data bytes, plus the first header and the
+// terminating zero
+#define BYTE_STUFFER_ENCODED_SIZE(size) ((size) + (size) / 254 + 2)
+
 void init_byte_stuffer(void);
 void byte_stuffer_recv_byte(uint8_t link, uint8_t data);
+// Receives a whole chunk, which can contain any number of partial frames
+void byte_stuffer_recv(uint8_t link, const uint8_t* data, uint16_t size);
+// Stuffs the frame into out, which needs BYTE_STUFFER_ENCODED_SIZE(size) bytes,
+// and returns the size including the terminating zero
+uint16_t byte_stuffer_encode(const uint8_t* data, uint16_t size, uint8_t* out);
+// Sends the stuffed frame with a single send_data call
 void byte_stuffer_send_frame(uint8_t link, uint8_t* data, uint16_t size);
 
 #endif
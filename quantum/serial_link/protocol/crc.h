@@ -0,0 +1,40 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SERIAL_LINK_CRC_H
+#define SERIAL_LINK_CRC_H
+
+#include <stdint.h>
+
+// The standard CRC-32 (as used by zlib and ethernet), all of these give the
+// same result. Slicing by 4 or 8 handles that many bytes per step at the cost
+// of 3 or 7 more 1KB tables.
+uint32_t crc32_bytewise(const uint8_t* data, uint32_t size);
+uint32_t crc32_slice_by_4(const uint8_t* data, uint32_t size);
+uint32_t crc32_slice_by_8(const uint8_t* data, uint32_t size);
+
+// CRC-16/CCITT-FALSE, polynomial 0x1021 and 0xFFFF seed
+uint16_t crc16_ccitt(const uint8_t* data, uint32_t size);
+
+#endif
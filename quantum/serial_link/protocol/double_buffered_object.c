@@ -0,0 +1,71 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "serial_link/protocol/double_buffered_object.h"
+#include "serial_link/protocol/atomic_state.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// The state is the index the reader uses and the data available flag, the
+// writer always uses the other buffer
+
+#define GET_READ_INDEX(state) ((state) & 1)
+#define GET_DATA_AVAILABLE(state) (((state) >> 1) & 1)
+
+#define MAKE_STATE(read, available) ((read) | ((available) << 1))
+
+void double_buffer_init(double_buffer_object_t* object) {
+    object->state = MAKE_STATE(0, 0);
+}
+
+void* double_buffer_read_internal(uint16_t object_size, double_buffer_object_t* object) {
+    uint8_t state;
+    do {
+        state = load_state(&object->state);
+        if (!GET_DATA_AVAILABLE(state)) {
+            return NULL;
+        }
+    } while (!compare_and_swap_state(&object->state, state,
+        MAKE_STATE(GET_READ_INDEX(state) ^ 1, 0)));
+    return object->buffer + object_size * (GET_READ_INDEX(state) ^ 1);
+}
+
+void* double_buffer_begin_write_internal(uint16_t object_size, double_buffer_object_t* object) {
+    uint8_t state;
+    // Take back unread data, if the reader gets to it first the write goes to
+    // the buffer the reader just released instead
+    do {
+        state = load_state(&object->state);
+    } while (GET_DATA_AVAILABLE(state) && !compare_and_swap_state(&object->state, state,
+        MAKE_STATE(GET_READ_INDEX(state), 0)));
+    return object->buffer + object_size * (GET_READ_INDEX(state) ^ 1);
+}
+
+void double_buffer_end_write_internal(double_buffer_object_t* object) {
+    uint8_t state;
+    do {
+        state = load_state(&object->state);
+    } while (!compare_and_swap_state(&object->state, state,
+        MAKE_STATE(GET_READ_INDEX(state), 1)));
+}
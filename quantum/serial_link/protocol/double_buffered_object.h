@@ -0,0 +1,54 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SERIAL_LINK_DOUBLE_BUFFERED_OBJECT_H
+#define SERIAL_LINK_DOUBLE_BUFFERED_OBJECT_H
+
+#include <stdint.h>
+
+// Like the triple buffered object, but with one copy less, for objects that
+// change rarely. The price is that a write takes back the previous write if
+// it hasn't been read yet, so the reader doesn't see the object while it's
+// being written. The pointer returned by a read is valid until the next read.
+typedef struct {
+    uint8_t state;
+    uint8_t buffer[] __attribute__((aligned(4)));
+}double_buffer_object_t;
+
+void double_buffer_init(double_buffer_object_t* object);
+
+#define double_buffer_begin_write(object) \
+    (typeof(*object.buffer[0])*)double_buffer_begin_write_internal(sizeof(*object.buffer[0]), (double_buffer_object_t*)object)
+
+#define double_buffer_end_write(object) \
+    double_buffer_end_write_internal((double_buffer_object_t*)object)
+
+#define double_buffer_read(object) \
+    (typeof(*object.buffer[0])*)double_buffer_read_internal(sizeof(*object.buffer[0]), (double_buffer_object_t*)object)
+
+void* double_buffer_begin_write_internal(uint16_t object_size, double_buffer_object_t* object);
+void double_buffer_end_write_internal(double_buffer_object_t* object);
+void* double_buffer_read_internal(uint16_t object_size, double_buffer_object_t* object);
+
+#endif
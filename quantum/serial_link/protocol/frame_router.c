@@ -25,6 +25,16 @@ SOFTWARE.
 #include "serial_link/protocol/frame_router.h"
 #include "serial_link/protocol/transport.h"
 #include "serial_link/protocol/frame_validator.h"
+#include "serial_link/protocol/baud_negotiation.h"
+
+// The last byte of a frame is its address. Going up it's the number of hops,
+// which is never zero. Going down it's the number of hops to a single slave,
+// counted down on each hop until it reaches the slave, or the high bit plus
+// the number of slaves from the next one on that all receive the frame,
+// counted down until nobody is left. So a zero address is used for frames
+// that are only for the device on the other end of the link.
+#define LINK_LOCAL_ADDRESS 0
+#define SLAVE_RANGE_ADDRESS 0x80
 
 static bool is_master;
 
@@ -32,7 +42,15 @@ void router_set_master(bool master) {
    is_master = master;
 }
 
+bool router_is_master(void) {
+   return is_master;
+}
+
 void route_incoming_frame(uint8_t link, uint8_t* data, uint16_t size){
+    if (data[size-1] == LINK_LOCAL_ADDRESS) {
+        baud_negotiation_recv_frame(link, data, size - 1);
+        return;
+    }
     if (is_master) {
         if (link == DOWN_LINK) {
             transport_recv_frame(data[size-1], data, size - 1);
@@ -40,11 +58,18 @@ void route_incoming_frame(uint8_t link, uint8_t* data, uint16_t size){
     }
     else {
         if (link == UP_LINK) {
-            if (data[size-1] & 1) {
+            uint8_t address = data[size-1];
+            if (address & SLAVE_RANGE_ADDRESS) {
                 transport_recv_frame(0, data, size - 1);
             }
-            data[size-1] >>= 1;
-            validator_send_frame(DOWN_LINK, data, size);
+            else if (address == 1) {
+                transport_recv_frame(0, data, size - 1);
+                return;
+            }
+            data[size-1] = --address;
+            if (address != SLAVE_RANGE_ADDRESS) {
+                validator_send_frame(DOWN_LINK, data, size);
+            }
         }
         else {
             data[size-1]++;
@@ -67,3 +92,8 @@ void router_send_frame(uint8_t destination, uint8_t* data, uint16_t size) {
         }
     }
 }
+
+void router_send_link_frame(uint8_t link, uint8_t* data, uint16_t size) {
+    data[size] = LINK_LOCAL_ADDRESS;
+    validator_send_frame(link, data, size + 1);
+}
@@ -31,8 +31,20 @@ SOFTWARE.
 #define UP_LINK 0
 #define DOWN_LINK 1
 
+// Destinations for router_send_frame
+#define ROUTER_MASTER 0
+#define ROUTER_SLAVE(slave) ((slave) + 1)
+// Every slave down the chain, up to ROUTER_MAX_SLAVES of them
+#define ROUTER_ALL_SLAVES 0xFF
+// The hops to a slave fit in seven bits of the address
+#define ROUTER_MAX_SLAVES 127
+
 void router_set_master(bool master);
+bool router_is_master(void);
 void route_incoming_frame(uint8_t link, uint8_t* data, uint16_t size);
 void router_send_frame(uint8_t destination, uint8_t* data, uint16_t size);
+// Sends a frame to the device at the other end of the link, it's not routed
+// any further. Like router_send_frame, data needs room for one more byte.
+void router_send_link_frame(uint8_t link, uint8_t* data, uint16_t size);
 
 #endif
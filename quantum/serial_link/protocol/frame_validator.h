@@ -27,8 +27,22 @@ SOFTWARE.
 
 #include <stdint.h>
 
+// The frames are checked with CRC-32 by default, computed one byte at a time.
+// Setting SERIAL_LINK_CRC32_SLICE to 4 or 8 is faster, but takes 3 or 7KB more
+// flash for the tables. SERIAL_LINK_CRC16 uses a CRC-16 instead, which saves
+// two bytes per frame and is enough for short frames.
+#ifndef SERIAL_LINK_CRC32_SLICE
+#define SERIAL_LINK_CRC32_SLICE 1
+#endif
+
+#ifdef SERIAL_LINK_CRC16
+#define FRAME_CRC_SIZE 2
+#else
+#define FRAME_CRC_SIZE 4
+#endif
+
 void validator_recv_frame(uint8_t link, uint8_t* data, uint16_t size);
-// The buffer pointed to by the data needs 4 additional bytes
+// The buffer pointed to by the data needs FRAME_CRC_SIZE additional bytes
 void validator_send_frame(uint8_t link, uint8_t* data, uint16_t size);
 
 #endif
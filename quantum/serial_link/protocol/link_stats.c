@@ -0,0 +1,54 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "serial_link/protocol/link_stats.h"
+#include <string.h>
+
+link_stats_t link_stats;
+
+void link_stats_reset(void) {
+    memset(&link_stats, 0, sizeof(link_stats));
+}
+
+void link_stats_add_latency(uint16_t latency) {
+    link_stats.latency_last = latency;
+    if (link_stats.latency_samples == 0) {
+        link_stats.latency_min = latency;
+        link_stats.latency_max = latency;
+        link_stats.latency_average = latency;
+    }
+    else {
+        if (latency < link_stats.latency_min) {
+            link_stats.latency_min = latency;
+        }
+        if (latency > link_stats.latency_max) {
+            link_stats.latency_max = latency;
+        }
+        // Moves an eighth of the way towards the new sample
+        int32_t average = link_stats.latency_average;
+        average += ((int32_t)latency - average) / 8;
+        link_stats.latency_average = average;
+    }
+    link_stats.latency_samples++;
+}
@@ -0,0 +1,70 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SERIAL_LINK_LINK_STATS_H
+#define SERIAL_LINK_LINK_STATS_H
+
+#include <stdint.h>
+#include "serial_link/protocol/byte_stuffer.h"
+
+// Counters for each link, updated by the protocol layers as the frames go
+// through them, and by the physical layer for the errors it sees
+typedef struct {
+    uint32_t frames_sent;
+    uint32_t frames_received;
+    // Frames that were decoded, but failed the frame check
+    uint32_t crc_errors;
+    // Frames the byte stuffer threw away because of a zero in the wrong place
+    uint32_t cobs_resets;
+    // Frames longer than MAX_FRAME_SIZE
+    uint32_t oversize_frames;
+    // Received data lost because it wasn't read in time
+    uint32_t overruns;
+    // Parity, framing and noise errors reported by the hardware
+    uint32_t line_errors;
+    uint32_t retransmits;
+    // Reliable frames given up on after SERIAL_LINK_MAX_RETRIES
+    uint32_t lost_frames;
+} link_counters_t;
+
+typedef struct {
+    link_counters_t links[NUM_LINKS];
+    // Slave blocks that didn't fit the transport pool, the frames of that
+    // slave are dropped and the writes to it fail
+    uint32_t pool_exhausted;
+    // The time from a slave writing a changed matrix until it sees the master
+    // acknowledge it, in milliseconds. The average is a running one.
+    uint32_t latency_samples;
+    uint16_t latency_last;
+    uint16_t latency_min;
+    uint16_t latency_max;
+    uint16_t latency_average;
+} link_stats_t;
+
+extern link_stats_t link_stats;
+
+void link_stats_reset(void);
+void link_stats_add_latency(uint16_t latency);
+
+#endif
@@ -25,6 +25,26 @@ SOFTWARE.
 #ifndef SERIAL_LINK_PHYSICAL_H
 #define SERIAL_LINK_PHYSICAL_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
+// The physical layer is implemented by one of the backends in
+// serial_link/system:
+//   physical_serial.c   - ChibiOS serial driver, the default
+//   physical_uart.c     - ChibiOS UART driver with DMA, SERIAL_LINK_UART_DMA,
+//                         experimental and not yet built for any keyboard
+//   physical_loopback.c - in memory, for the tests, SERIAL_LINK_LOOPBACK
+
+// Starts the drivers
+void physical_init(void);
+// Called from the thread that calls physical_receive, before the first call
+void physical_start(void);
+// Passes everything received since the last call to byte_stuffer_recv, and
+// returns false when there was nothing
+bool physical_receive(void);
+// Called with a whole stuffed frame
 void send_data(uint8_t link, const uint8_t* data, uint16_t size);
+// Changes the rate of a link, after what was sent before has left
+void physical_set_baud(uint8_t link, uint32_t baud);
 
 #endif
@@ -25,104 +25,639 @@ SOFTWARE.
 #include "serial_link/protocol/transport.h"
 #include "serial_link/protocol/frame_router.h"
 #include "serial_link/protocol/triple_buffered_object.h"
+#include "serial_link/protocol/double_buffered_object.h"
+#include "serial_link/protocol/atomic_state.h"
+#include "serial_link/protocol/link_stats.h"
+#include "timer.h"
 #include <string.h>
 
-#define MAX_REMOTE_OBJECTS 16
 static remote_object_t* remote_objects[MAX_REMOTE_OBJECTS];
 static uint32_t num_remote_objects = 0;
 
+// A bit for each object that has been written to, but not sent yet. The
+// writers set the bits from other threads, so they are changed with the same
+// compare and swap as the buffered objects.
+static uint8_t dirty_objects[(MAX_REMOTE_OBJECTS + 7) / 8];
+
+static void set_dirty(uint8_t id) {
+    uint8_t* byte = &dirty_objects[id / 8];
+    uint8_t state;
+    do {
+        state = load_state(byte);
+    } while (!compare_and_swap_state(byte, state, state | (1 << (id % 8))));
+}
+
+static void clear_dirty(uint8_t id) {
+    uint8_t* byte = &dirty_objects[id / 8];
+    uint8_t state;
+    do {
+        state = load_state(byte);
+    } while (!compare_and_swap_state(byte, state, state & ~(1 << (id % 8))));
+}
+
+// The buffers that every slave needs its own copy of, the remote objects from
+// each slave and the local objects to each, are kept in one block per slave.
+// The blocks are taken from the pool the first time a slave sends a frame, or
+// a single slave object is written to it, so the pool only needs room for the
+// slaves that are actually there rather than for NUM_SLAVES.
+static uint8_t pool[SERIAL_LINK_POOL_SIZE] __attribute__((aligned(4)));
+static uint16_t pool_used = 0;
+static uint16_t slave_block_size = 0;
+static uint8_t* slave_blocks[NUM_SLAVES];
+
+// Frames are the object followed by the object id. Delta objects also send a
+// sequence number before the id, and set DELTA_FRAME in the id when the frame
+// holds [offset][length][bytes...] runs of changed bytes instead of the object.
+#define DELTA_FRAME 0x80
+
+// Reliable objects without deltas send a sequence number before the id too.
+// The receiver answers each of their frames with a control frame, which is
+// [object id][sequence][CONTROL_ACK or CONTROL_NACK] with CONTROL_ID as the id.
+#define CONTROL_ID 0x7F
+#define CONTROL_ACK 0
+#define CONTROL_NACK 1
+
+#if MAX_REMOTE_OBJECTS > CONTROL_ID
+#error "MAX_REMOTE_OBJECTS can be at most 127"
+#endif
+
+static uint16_t local_object_size(remote_object_t* obj) {
+    return LOCAL_OBJECT_SIZE(obj->object_size, obj->flags);
+}
+
+static uint16_t remote_object_size(remote_object_t* obj) {
+    return REMOTE_OBJECT_SIZE(obj->object_size, obj->flags);
+}
+
+static uint16_t delta_state_size(remote_object_t* obj) {
+    return obj->flags & REMOTE_OBJECT_DELTA ? DELTA_STATE_SIZE(obj->object_size) : 0;
+}
+
+static uint16_t reliable_state_size(remote_object_t* obj) {
+    return obj->flags & REMOTE_OBJECT_RELIABLE ? RELIABLE_STATE_SIZE : 0;
+}
+
+// The size of the buffers of the object in each slave block
+static uint16_t slave_buffers_size(remote_object_t* obj) {
+    if (obj->object_type == MASTER_TO_SINGLE_SLAVE) {
+        return local_object_size(obj) + reliable_state_size(obj);
+    }
+    else if (obj->object_type == SLAVE_TO_MASTER) {
+        return remote_object_size(obj) + delta_state_size(obj);
+    }
+    return 0;
+}
+
+static void init_buffer(remote_object_t* obj, uint8_t* buffer) {
+    if (obj->flags & REMOTE_OBJECT_DOUBLE_BUFFERED) {
+        double_buffer_init((double_buffer_object_t*)buffer);
+    }
+    else {
+        triple_buffer_init((triple_buffer_object_t*)buffer);
+    }
+}
+
+static void* begin_write_buffer(remote_object_t* obj, uint16_t size, uint8_t* buffer) {
+    if (obj->flags & REMOTE_OBJECT_DOUBLE_BUFFERED) {
+        return double_buffer_begin_write_internal(size, (double_buffer_object_t*)buffer);
+    }
+    return triple_buffer_begin_write_internal(size, (triple_buffer_object_t*)buffer);
+}
+
+static void end_write_buffer(remote_object_t* obj, uint8_t* buffer) {
+    if (obj->flags & REMOTE_OBJECT_DOUBLE_BUFFERED) {
+        double_buffer_end_write_internal((double_buffer_object_t*)buffer);
+    }
+    else {
+        triple_buffer_end_write_internal((triple_buffer_object_t*)buffer);
+    }
+}
+
+static void* read_buffer(remote_object_t* obj, uint16_t size, uint8_t* buffer) {
+    if (obj->flags & REMOTE_OBJECT_DOUBLE_BUFFERED) {
+        return double_buffer_read_internal(size, (double_buffer_object_t*)buffer);
+    }
+    return triple_buffer_read_internal(size, (triple_buffer_object_t*)buffer);
+}
+
+// Returns the block of the slave, allocating it when asked to, or NULL if the
+// slave doesn't exist or there's no room left
+static uint8_t* get_slave_block(uint8_t slave, bool allocate) {
+    if (slave >= NUM_SLAVES) {
+        return NULL;
+    }
+    // A block is only stored here once it's initialized, so it can be looked
+    // up without the lock
+    uint8_t* block = slave_blocks[slave];
+    if (block || !allocate || slave_block_size == 0) {
+        return block;
+    }
+    // Both the writers of the single slave objects and the serial link thread
+    // receiving frames allocate
+    serial_link_lock();
+    block = slave_blocks[slave];
+    if (!block && pool_used + slave_block_size > SERIAL_LINK_POOL_SIZE) {
+        link_stats.pool_exhausted++;
+    }
+    else if (!block) {
+        block = pool + pool_used;
+        pool_used += slave_block_size;
+        memset(block, 0, slave_block_size);
+        unsigned int i;
+        for (i=0;i<num_remote_objects;i++) {
+            remote_object_t* obj = remote_objects[i];
+            if (slave_buffers_size(obj)) {
+                init_buffer(obj, block + obj->slave_offset);
+            }
+        }
+        slave_blocks[slave] = block;
+    }
+    serial_link_unlock();
+    return block;
+}
+
+// The local object, that is written to on this device
+static uint8_t* get_local_buffer(remote_object_t* obj, uint8_t slave, bool allocate) {
+    if (obj->object_type == MASTER_TO_SINGLE_SLAVE) {
+        uint8_t* block = get_slave_block(slave, allocate);
+        return block ? block + obj->slave_offset : NULL;
+    }
+    return obj->buffer;
+}
+
+// The remote object, that the frames received are written to
+static uint8_t* get_remote_buffer(remote_object_t* obj, uint8_t slave, bool allocate) {
+    if (obj->object_type == MASTER_TO_ALL_SLAVES) {
+        return obj->buffer + local_object_size(obj);
+    }
+    else if (obj->object_type == SLAVE_TO_MASTER) {
+        uint8_t* block = get_slave_block(slave, allocate);
+        return block ? block + obj->slave_offset : NULL;
+    }
+    return obj->buffer;
+}
+
+static delta_state_t* get_sender_delta_state(remote_object_t* obj) {
+    return (delta_state_t*)(obj->buffer + local_object_size(obj));
+}
+
+static delta_state_t* get_receiver_delta_state(remote_object_t* obj, uint8_t slave) {
+    if (obj->object_type == SLAVE_TO_MASTER) {
+        uint8_t* remote = get_remote_buffer(obj, slave, true);
+        return remote ? (delta_state_t*)(remote + remote_object_size(obj)) : NULL;
+    }
+    uint8_t* start = obj->buffer + local_object_size(obj) + remote_object_size(obj);
+    return (delta_state_t*)(start + delta_state_size(obj));
+}
+
+// Returns NULL when the object isn't reliable, or this device doesn't send it
+static reliable_state_t* get_sender_reliable_state(remote_object_t* obj, uint8_t slave) {
+    if (!(obj->flags & REMOTE_OBJECT_RELIABLE)) {
+        return NULL;
+    }
+    if (obj->object_type == SLAVE_TO_MASTER) {
+        if (router_is_master()) {
+            return NULL;
+        }
+        return (reliable_state_t*)(obj->buffer + local_object_size(obj) + delta_state_size(obj));
+    }
+    uint8_t* local = get_local_buffer(obj, slave, false);
+    return local ? (reliable_state_t*)(local + local_object_size(obj)) : NULL;
+}
+
 void reinitialize_serial_link_transport(void) {
     num_remote_objects = 0;
+    memset(dirty_objects, 0, sizeof(dirty_objects));
+    slave_block_size = 0;
+    pool_used = 0;
+    memset(slave_blocks, 0, sizeof(slave_blocks));
 }
 
 void add_remote_objects(remote_object_t** _remote_objects, uint32_t _num_remote_objects) {
+    // The layout of the slave blocks changes, so start over with them
+    pool_used = 0;
+    memset(slave_blocks, 0, sizeof(slave_blocks));
     unsigned int i;
-    for(i=0;i<_num_remote_objects;i++) {
+    for(i=0;i<_num_remote_objects && num_remote_objects < MAX_REMOTE_OBJECTS;i++) {
         remote_object_t* obj = _remote_objects[i];
+        obj->id = num_remote_objects;
+        obj->last_sent = timer_read() - obj->min_interval;
         remote_objects[num_remote_objects++] = obj;
+        obj->slave_offset = slave_block_size;
+        slave_block_size += slave_buffers_size(obj);
         if (obj->object_type == MASTER_TO_ALL_SLAVES) {
-            triple_buffer_object_t* tb = (triple_buffer_object_t*)obj->buffer;
-            triple_buffer_init(tb);
-            uint8_t* start = obj->buffer + LOCAL_OBJECT_SIZE(obj->object_size);
-            tb = (triple_buffer_object_t*)start;
-            triple_buffer_init(tb);
+            init_buffer(obj, obj->buffer);
+            init_buffer(obj, obj->buffer + local_object_size(obj));
+            memset(obj->buffer + local_object_size(obj) + remote_object_size(obj), 0,
+                2 * delta_state_size(obj));
         }
         else if(obj->object_type == MASTER_TO_SINGLE_SLAVE) {
-            uint8_t* start = obj->buffer;
-            unsigned int j;
-            for (j=0;j<NUM_SLAVES;j++) {
-                triple_buffer_object_t* tb = (triple_buffer_object_t*)start;
-                triple_buffer_init(tb);
-                start += LOCAL_OBJECT_SIZE(obj->object_size);
-            }
-            triple_buffer_object_t* tb = (triple_buffer_object_t*)start;
-            triple_buffer_init(tb);
+            init_buffer(obj, obj->buffer);
         }
         else {
-            uint8_t* start = obj->buffer;
-            triple_buffer_object_t* tb = (triple_buffer_object_t*)start;
-            triple_buffer_init(tb);
-            start += LOCAL_OBJECT_SIZE(obj->object_size);
-            unsigned int j;
-            for (j=0;j<NUM_SLAVES;j++) {
-                tb = (triple_buffer_object_t*)start;
-                triple_buffer_init(tb);
-                start += REMOTE_OBJECT_SIZE(obj->object_size);
+            init_buffer(obj, obj->buffer);
+            memset(obj->buffer + local_object_size(obj), 0,
+                delta_state_size(obj) + reliable_state_size(obj));
+        }
+    }
+}
+
+uint16_t transport_get_pool_used(void) {
+    return pool_used;
+}
+
+void* transport_begin_write(remote_object_t* obj, uint8_t slave) {
+    uint8_t* buffer = get_local_buffer(obj, slave, true);
+    if (!buffer) {
+        return NULL;
+    }
+    return begin_write_buffer(obj, obj->object_size + LOCAL_OBJECT_EXTRA, buffer);
+}
+
+void transport_end_write(remote_object_t* obj, uint8_t slave) {
+    uint8_t* buffer = get_local_buffer(obj, slave, false);
+    if (buffer) {
+        end_write_buffer(obj, buffer);
+        set_dirty(obj->id);
+    }
+}
+
+void transport_set_schedule(remote_object_t* obj, uint8_t priority, uint16_t min_interval) {
+    obj->priority = priority;
+    obj->min_interval = min_interval;
+    obj->last_sent = timer_read() - min_interval;
+}
+
+void* transport_read(remote_object_t* obj, uint8_t slave) {
+    uint8_t* buffer = get_remote_buffer(obj, slave, false);
+    if (!buffer) {
+        return NULL;
+    }
+    return read_buffer(obj, obj->object_size, buffer);
+}
+
+// Returns the size of the runs, or size when they would not be any smaller
+static uint16_t encode_delta(const uint8_t* last, const uint8_t* current, uint16_t size, uint8_t* runs) {
+    if (size > 255) {
+        return size;
+    }
+    uint16_t runs_size = 0;
+    uint16_t i = 0;
+    while (i < size) {
+        if (last[i] == current[i]) {
+            i++;
+            continue;
+        }
+        // a gap of one unchanged byte is cheaper than a new run header
+        uint16_t end = i + 1;
+        uint16_t j;
+        for (j = end; j < size && j - end < 2; j++) {
+            if (last[j] != current[j]) {
+                end = j + 1;
             }
         }
+        uint16_t length = end - i;
+        if (runs_size + 2 + length >= size) {
+            return size;
+        }
+        runs[runs_size++] = i;
+        runs[runs_size++] = length;
+        memcpy(runs + runs_size, current + i, length);
+        runs_size += length;
+        i = end;
+    }
+    return runs_size;
+}
+
+static bool apply_delta(uint8_t* object, uint16_t object_size, const uint8_t* runs, uint16_t size) {
+    uint16_t i = 0;
+    while (i < size) {
+        if (size - i < 2) {
+            return false;
+        }
+        uint8_t offset = runs[i++];
+        uint8_t length = runs[i++];
+        if (length == 0 || offset + length > object_size || i + length > size) {
+            return false;
+        }
+        memcpy(object + offset, runs + i, length);
+        i += length;
+    }
+    return true;
+}
+
+// Returns true if the frame was a keyframe
+static bool send_delta_frame(remote_object_t* obj, uint8_t id, uint8_t dest, const uint8_t* current) {
+    uint16_t size = obj->object_size;
+    delta_state_t* state = get_sender_delta_state(obj);
+    uint8_t* last = (uint8_t*)(state + 1);
+    // the router and validator append to the frame like to the local objects
+    uint8_t frame[size + LOCAL_OBJECT_EXTRA];
+    uint16_t frame_size = size;
+    if (state->state > 0) {
+        frame_size = encode_delta(last, current, size, frame);
+    }
+    if (frame_size < size) {
+        state->state--;
+        id |= DELTA_FRAME;
+    }
+    else {
+        memcpy(frame, current, size);
+        state->state = DELTA_KEYFRAME_INTERVAL - 1;
+    }
+    memcpy(last, current, size);
+    state->sequence++;
+    frame[frame_size] = state->sequence;
+    frame[frame_size + 1] = id;
+    router_send_frame(dest, frame, frame_size + 2);
+    return !(id & DELTA_FRAME);
+}
+
+// Returns the updated object, or NULL when the frame can't be used
+static uint8_t* recv_delta_frame(remote_object_t* obj, uint8_t from, uint8_t* data, uint16_t size) {
+    delta_state_t* state = get_receiver_delta_state(obj, from - 1);
+    if (!state) {
+        return NULL;
+    }
+    uint8_t* object = (uint8_t*)(state + 1);
+    uint8_t sequence = data[size - 2];
+    uint16_t payload_size = size - 2;
+    if (data[size - 1] & DELTA_FRAME) {
+        // a delta only applies on top of the frame sent right before it,
+        // after a lost frame wait for the next keyframe
+        if (!state->state || sequence != (uint8_t)(state->sequence + 1) ||
+                !apply_delta(object, obj->object_size, data, payload_size)) {
+            state->state = false;
+            return NULL;
+        }
+    }
+    else {
+        if (payload_size != obj->object_size) {
+            return NULL;
+        }
+        memcpy(object, data, payload_size);
+    }
+    state->sequence = sequence;
+    state->state = true;
+    return object;
+}
+
+static void send_control(uint8_t dest, uint8_t id, uint8_t sequence, uint8_t type) {
+    uint8_t frame[4 + LOCAL_OBJECT_EXTRA];
+    frame[0] = id;
+    frame[1] = sequence;
+    frame[2] = type;
+    frame[3] = CONTROL_ID;
+    router_send_frame(dest, frame, 4);
+}
+
+// Sends the frame of an object without deltas, the buffer needs room for the
+// sequence and the id after the object
+static void send_full_frame(remote_object_t* obj, uint8_t dest, uint8_t* frame, reliable_state_t* reliable) {
+    uint16_t size = obj->object_size;
+    if (reliable) {
+        frame[size++] = reliable->sequence;
+    }
+    frame[size++] = obj->id;
+    router_send_frame(dest, frame, size);
+}
+
+static uint8_t get_sender_dest(remote_object_t* obj, uint8_t slave) {
+    return obj->object_type == SLAVE_TO_MASTER ? ROUTER_MASTER : ROUTER_SLAVE(slave);
+}
+
+// Sends the last object again, as a keyframe for the delta objects
+static void retransmit(remote_object_t* obj, uint8_t slave, reliable_state_t* reliable) {
+    uint8_t dest = get_sender_dest(obj, slave);
+    if (obj->flags & REMOTE_OBJECT_DELTA) {
+        uint16_t size = obj->object_size;
+        uint8_t frame[size + LOCAL_OBJECT_EXTRA];
+        memcpy(frame, get_sender_delta_state(obj) + 1, size);
+        reliable->keyframe_sequence = reliable->sequence;
+        send_full_frame(obj, dest, frame, reliable);
+    }
+    else {
+        send_full_frame(obj, dest, reliable->frame, reliable);
+    }
+    reliable->retries++;
+    reliable->sent_time = timer_read();
+    link_stats.links[dest == 0 ? UP_LINK : DOWN_LINK].retransmits++;
+}
+
+static void recv_control(uint8_t from, uint8_t* data, uint16_t size) {
+    if (size != 4 || data[0] >= num_remote_objects) {
+        return;
+    }
+    remote_object_t* obj = remote_objects[data[0]];
+    uint8_t slave = from - 1;
+    reliable_state_t* reliable = get_sender_reliable_state(obj, slave);
+    if (!reliable || !reliable->frame) {
+        return;
+    }
+    uint8_t sequence = data[1];
+    if (data[2] == CONTROL_ACK) {
+        if (sequence == reliable->sequence) {
+            reliable->pending = false;
+        }
+    }
+    else if ((int8_t)(sequence - reliable->keyframe_sequence) > 0) {
+        // Fast retransmit, but only once for all the deltas the receiver
+        // couldn't apply before it gets the keyframe, keyframes always apply
+        retransmit(obj, slave, reliable);
+        reliable->pending = true;
     }
 }
 
 void transport_recv_frame(uint8_t from, uint8_t* data, uint16_t size) {
-    uint8_t id = data[size-1];
+    // A slave further away than NUM_SLAVES can't be answered
+    if (size < 1 || from > NUM_SLAVES) {
+        return;
+    }
+    if (data[size-1] == CONTROL_ID) {
+        recv_control(from, data, size);
+        return;
+    }
+    uint8_t id = data[size-1] & ~DELTA_FRAME;
     if (id < num_remote_objects) {
         remote_object_t* obj = remote_objects[id];
-        if (obj->object_size == size - 1) {
-            uint8_t* start;
-            if (obj->object_type == MASTER_TO_ALL_SLAVES) {
-                start = obj->buffer + LOCAL_OBJECT_SIZE(obj->object_size);
+        bool reliable = obj->flags & REMOTE_OBJECT_RELIABLE;
+        uint16_t header_size = reliable ? 2 : 1;
+        uint8_t* object = NULL;
+        if (obj->flags & REMOTE_OBJECT_DELTA) {
+            if (size >= 2) {
+                object = recv_delta_frame(obj, from, data, size);
             }
-            else if(obj->object_type == SLAVE_TO_MASTER) {
-                start = obj->buffer + LOCAL_OBJECT_SIZE(obj->object_size);
-                start += (from - 1) * REMOTE_OBJECT_SIZE(obj->object_size);
+        }
+        else if (obj->object_size == size - header_size && !(data[size-1] & DELTA_FRAME)) {
+            object = data;
+        }
+        else {
+            // Not even a frame of this object, so nothing to answer
+            reliable = false;
+        }
+        uint8_t* remote = NULL;
+        if (object) {
+            remote = get_remote_buffer(obj, from - 1, true);
+        }
+        if (remote) {
+            void* ptr = begin_write_buffer(obj, obj->object_size, remote);
+            memcpy(ptr, object, obj->object_size);
+            end_write_buffer(obj, remote);
+        }
+        if (reliable && size >= 2 && (remote || !object)) {
+            uint8_t dest = from == 0 ? ROUTER_MASTER : ROUTER_SLAVE(from - 1);
+            send_control(dest, id, data[size - 2], remote ? CONTROL_ACK : CONTROL_NACK);
+        }
+    }
+}
+
+static void start_reliable(reliable_state_t* reliable, uint8_t* frame) {
+    reliable->frame = frame;
+    reliable->pending = true;
+    reliable->retries = 0;
+    reliable->sent_time = timer_read();
+}
+
+// Returns true if something was sent
+static bool send_object(remote_object_t* obj) {
+    uint8_t id = obj->id;
+    if (obj->object_type == MASTER_TO_ALL_SLAVES || obj->object_type == SLAVE_TO_MASTER) {
+        uint8_t* ptr = read_buffer(obj, obj->object_size + LOCAL_OBJECT_EXTRA, obj->buffer);
+        if (!ptr) {
+            return false;
+        }
+        uint8_t dest = obj->object_type == MASTER_TO_ALL_SLAVES ? ROUTER_ALL_SLAVES : ROUTER_MASTER;
+        reliable_state_t* reliable = get_sender_reliable_state(obj, 0);
+        if (obj->flags & REMOTE_OBJECT_DELTA) {
+            bool keyframe = send_delta_frame(obj, id, dest, ptr);
+            if (reliable) {
+                reliable->sequence = get_sender_delta_state(obj)->sequence;
+                if (keyframe) {
+                    reliable->keyframe_sequence = reliable->sequence;
+                }
+                start_reliable(reliable, ptr);
             }
-            else {
-                start = obj->buffer + NUM_SLAVES * LOCAL_OBJECT_SIZE(obj->object_size);
+        }
+        else {
+            if (reliable) {
+                reliable->sequence++;
+                start_reliable(reliable, ptr);
+            }
+            send_full_frame(obj, dest, ptr, reliable);
+        }
+        return true;
+    }
+    // Only the slaves that have been written to have a block
+    bool sent = false;
+    unsigned int j;
+    for (j=0;j<NUM_SLAVES;j++) {
+        uint8_t* buffer = get_local_buffer(obj, j, false);
+        if (!buffer) {
+            continue;
+        }
+        uint8_t* ptr = read_buffer(obj, obj->object_size + LOCAL_OBJECT_EXTRA, buffer);
+        if (ptr) {
+            reliable_state_t* reliable = get_sender_reliable_state(obj, j);
+            if (reliable) {
+                reliable->sequence++;
+                start_reliable(reliable, ptr);
             }
-            triple_buffer_object_t* tb = (triple_buffer_object_t*)start;
-            void* ptr = triple_buffer_begin_write_internal(obj->object_size, tb);
-            memcpy(ptr, data, size - 1);
-            triple_buffer_end_write_internal(tb);
+            send_full_frame(obj, ROUTER_SLAVE(j), ptr, reliable);
+            sent = true;
+        }
+    }
+    return sent;
+}
+
+static uint16_t retransmit_timeout(reliable_state_t* reliable) {
+    return SERIAL_LINK_RETRANSMIT_MS << (reliable->retries < 4 ? reliable->retries : 4);
+}
+
+// Returns the time until the reliable object needs to be sent again, or 0 if
+// it doesn't
+static uint16_t check_retransmit(remote_object_t* obj, uint8_t slave, uint16_t now) {
+    reliable_state_t* reliable = get_sender_reliable_state(obj, slave);
+    if (!reliable || !reliable->pending) {
+        return 0;
+    }
+    uint16_t elapsed = now - reliable->sent_time;
+    if (elapsed >= retransmit_timeout(reliable)) {
+        if (reliable->retries >= SERIAL_LINK_MAX_RETRIES) {
+            // Nobody is answering, the next write starts over
+            reliable->pending = false;
+            link_stats.links[get_sender_dest(obj, slave) == 0 ? UP_LINK : DOWN_LINK].lost_frames++;
+            return 0;
         }
+        retransmit(obj, slave, reliable);
+        elapsed = 0;
     }
+    return retransmit_timeout(reliable) - elapsed;
 }
 
-void update_transport(void) {
+static uint16_t update_retransmits(void) {
+    uint16_t wait = 0;
+    uint16_t now = timer_read();
     unsigned int i;
-    for(i=0;i<num_remote_objects;i++) {
+    for (i=0;i<num_remote_objects;i++) {
         remote_object_t* obj = remote_objects[i];
-        if (obj->object_type == MASTER_TO_ALL_SLAVES || obj->object_type == SLAVE_TO_MASTER) {
-            triple_buffer_object_t* tb = (triple_buffer_object_t*)obj->buffer;
-            uint8_t* ptr = (uint8_t*)triple_buffer_read_internal(obj->object_size + LOCAL_OBJECT_EXTRA, tb);
-            if (ptr) {
-                ptr[obj->object_size] = i;
-                uint8_t dest = obj->object_type == MASTER_TO_ALL_SLAVES ? 0xFF : 0;
-                router_send_frame(dest, ptr, obj->object_size + 1);
+        if (!(obj->flags & REMOTE_OBJECT_RELIABLE)) {
+            continue;
+        }
+        uint8_t slaves = obj->object_type == MASTER_TO_SINGLE_SLAVE ? NUM_SLAVES : 1;
+        uint8_t j;
+        for (j=0;j<slaves;j++) {
+            uint16_t remaining = check_retransmit(obj, j, now);
+            if (remaining && (wait == 0 || remaining < wait)) {
+                wait = remaining;
             }
         }
-        else {
-            uint8_t* start = obj->buffer;
-            unsigned int j;
-            for (j=0;j<NUM_SLAVES;j++) {
-                triple_buffer_object_t* tb = (triple_buffer_object_t*)start;
-                uint8_t* ptr = (uint8_t*)triple_buffer_read_internal(obj->object_size + LOCAL_OBJECT_EXTRA, tb);
-                if (ptr) {
-                    ptr[obj->object_size] = i;
-                    uint8_t dest = j + 1;
-                    router_send_frame(dest, ptr, obj->object_size + 1);
+    }
+    return wait;
+}
+
+uint16_t update_transport(void) {
+    uint16_t wait;
+    // Send one object at a time, and look for the highest priority again after
+    // each, so that the objects written while a frame was being sent don't
+    // have to wait behind the lower priority ones
+    for (;;) {
+        remote_object_t* next = NULL;
+        uint16_t now = timer_read();
+        wait = 0;
+        unsigned int i;
+        for (i=0;i<sizeof(dirty_objects);i++) {
+            uint8_t dirty = load_state(&dirty_objects[i]);
+            uint8_t bit;
+            for (bit=0;dirty;bit++, dirty >>= 1) {
+                if (!(dirty & 1)) {
+                    continue;
+                }
+                remote_object_t* obj = remote_objects[i * 8 + bit];
+                uint16_t elapsed = now - obj->last_sent;
+                if (elapsed < obj->min_interval) {
+                    uint16_t remaining = obj->min_interval - elapsed;
+                    if (wait == 0 || remaining < wait) {
+                        wait = remaining;
+                    }
+                    continue;
+                }
+                if (!next || obj->priority > next->priority) {
+                    next = obj;
                 }
-                start += LOCAL_OBJECT_SIZE(obj->object_size);
             }
         }
+        if (!next) {
+            break;
+        }
+        // Clear first, so that a write while sending is sent the next time
+        clear_dirty(next->id);
+        if (send_object(next)) {
+            next->last_sent = now;
+        }
+    }
+    uint16_t retransmit_wait = update_retransmits();
+    if (retransmit_wait && (wait == 0 || retransmit_wait < wait)) {
+        wait = retransmit_wait;
     }
+    return wait;
 }
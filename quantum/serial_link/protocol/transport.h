@@ -26,127 +26,246 @@ SOFTWARE.
 #define SERIAL_LINK_TRANSPORT_H
 
 #include "serial_link/protocol/triple_buffered_object.h"
+#include "serial_link/protocol/double_buffered_object.h"
 #include "serial_link/system/serial_link.h"
 
+// The most slaves and objects that can be addressed. The buffers for each
+// slave take a block of the static SERIAL_LINK_POOL_SIZE bytes pool once the
+// slave is used, so the pool only has to fit the slaves that are actually
+// present, not NUM_SLAVES of them. A board sizes the pool for the slaves it
+// has, with the *_BLOCK_SIZE macros below. A slave that finds the pool full
+// gets no block: its frames are dropped and writes to it return NULL, and
+// each time is counted in link_stats.pool_exhausted.
+#ifndef NUM_SLAVES
 #define NUM_SLAVES 8
+#endif
+
+// The router counts the hops to a slave in seven bits, see frame_router.h
+#if NUM_SLAVES > 127
+#error "NUM_SLAVES can be at most 127"
+#endif
+
+#ifndef MAX_REMOTE_OBJECTS
+#define MAX_REMOTE_OBJECTS 16
+#endif
+
+#ifndef SERIAL_LINK_POOL_SIZE
+#define SERIAL_LINK_POOL_SIZE 512
+#endif
+
 #define LOCAL_OBJECT_EXTRA 16
 
+// A delta object sends only the bytes that changed since the last frame, and
+// the full object every DELTA_KEYFRAME_INTERVAL frames so that a receiver that
+// lost a delta gets back in sync
+#ifndef DELTA_KEYFRAME_INTERVAL
+#define DELTA_KEYFRAME_INTERVAL 16
+#endif
+
+// A reliable object is sent again when it hasn't been acknowledged in
+// SERIAL_LINK_RETRANSMIT_MS, doubling the time after each try up to 16 times
+// that, until it is. After SERIAL_LINK_MAX_RETRIES tries, about a second,
+// the receiver is taken to be gone and the frame is dropped.
+#ifndef SERIAL_LINK_RETRANSMIT_MS
+#define SERIAL_LINK_RETRANSMIT_MS 4
+#endif
+
+#ifndef SERIAL_LINK_MAX_RETRIES
+#define SERIAL_LINK_MAX_RETRIES 16
+#endif
+
 // master -> slave = 1 local(target all), 1 remote object
-// slave -> master = 1 local(target 0), multiple remote objects
-// master -> single slave (multiple local, target id), 1 remote object
+// slave -> master = 1 local(target 0), a remote object per slave
+// master -> single slave (a local per slave, target id), 1 remote object
 typedef enum {
     MASTER_TO_ALL_SLAVES,
     MASTER_TO_SINGLE_SLAVE,
     SLAVE_TO_MASTER,
 } remote_object_type;
 
+// Objects with a higher priority are sent first, the rest default to the
+// lowest priority, and are sent in the order they were added
+#define REMOTE_OBJECT_PRIORITY_LOW 0
+#define REMOTE_OBJECT_PRIORITY_HIGH 255
+
+// Flags for the _WITH_FLAGS object macros
+#define REMOTE_OBJECT_DELTA 1
+// Use double instead of triple buffers, for objects that change rarely
+#define REMOTE_OBJECT_DOUBLE_BUFFERED 2
+// The receiver acknowledges every frame, and asks for a keyframe when it can't
+// apply a delta. Only for the objects that have a single receiver, so not for
+// the MASTER_TO_ALL_SLAVES ones.
+#define REMOTE_OBJECT_RELIABLE 4
+
 typedef struct {
     remote_object_type object_type;
     uint16_t object_size;
-    uint8_t buffer[] __attribute__((aligned(4)));
+    uint8_t flags;
+    // Where the buffers of the object are in the block of each slave
+    uint16_t slave_offset;
+    // The index in the object list, which is also the id sent in the frames
+    uint8_t id;
+    // See transport_set_schedule
+    uint8_t priority;
+    uint16_t min_interval;
+    uint16_t last_sent;
+    // zero length rather than flexible, the object macros embed this struct
+    uint8_t buffer[0] __attribute__((aligned(4)));
 } remote_object_t;
 
-#define REMOTE_OBJECT_SIZE(objectsize) \
-    (sizeof(triple_buffer_object_t) + objectsize * 3)
-#define LOCAL_OBJECT_SIZE(objectsize) \
-    (sizeof(triple_buffer_object_t) + (objectsize + LOCAL_OBJECT_EXTRA) * 3)
+// Last object sent or received, followed by the object itself
+typedef struct {
+    uint8_t sequence;
+    // sender: frames until the next keyframe, receiver: in sync
+    uint8_t state;
+} delta_state_t;
+
+// Sender side of a reliable object
+typedef struct {
+    // The last frame sent, for the objects without deltas
+    uint8_t* frame;
+    uint16_t sent_time;
+    uint8_t sequence;
+    // The last keyframe sent, a request for one sent before is already handled
+    uint8_t keyframe_sequence;
+    uint8_t pending;
+    uint8_t retries;
+} reliable_state_t;
 
-#define REMOTE_OBJECT_HELPER(name, type, num_local, num_remote) \
+// All the buffers start word aligned
+#define OBJECT_ALIGN(size) (((size) + 3) & ~3)
+#define OBJECT_COPIES(flags) ((flags) & REMOTE_OBJECT_DOUBLE_BUFFERED ? 2 : 3)
+#define REMOTE_OBJECT_SIZE(objectsize, flags) \
+    OBJECT_ALIGN(sizeof(triple_buffer_object_t) + (objectsize) * OBJECT_COPIES(flags))
+#define LOCAL_OBJECT_SIZE(objectsize, flags) \
+    OBJECT_ALIGN(sizeof(triple_buffer_object_t) + ((objectsize) + LOCAL_OBJECT_EXTRA) * OBJECT_COPIES(flags))
+#define DELTA_STATE_SIZE(objectsize) \
+    OBJECT_ALIGN(sizeof(delta_state_t) + (objectsize))
+#define NUM_DELTA_STATES(flags) ((flags) & REMOTE_OBJECT_DELTA ? 1 : 0)
+#define RELIABLE_STATE_SIZE OBJECT_ALIGN(sizeof(reliable_state_t))
+#define NUM_RELIABLE_STATES(flags) ((flags) & REMOTE_OBJECT_RELIABLE ? 1 : 0)
+
+// The bytes an object takes in the pool block of every slave, the sum of these
+// for all the objects times the slaves present has to fit SERIAL_LINK_POOL_SIZE
+#define MASTER_TO_SINGLE_SLAVE_BLOCK_SIZE(type, flags) \
+    (LOCAL_OBJECT_SIZE(sizeof(type), (flags) & ~REMOTE_OBJECT_DELTA) + \
+    NUM_RELIABLE_STATES(flags) * RELIABLE_STATE_SIZE)
+#define SLAVE_TO_MASTER_BLOCK_SIZE(type, flags) \
+    (REMOTE_OBJECT_SIZE(sizeof(type), flags) + \
+    NUM_DELTA_STATES(flags) * DELTA_STATE_SIZE(sizeof(type)))
+
+// Only the buffers used by every device are part of the object, the ones for
+// each slave come from the pool
+#define REMOTE_OBJECT_HELPER(name, type, type_flags, num_local, num_remote) \
 typedef struct { \
     remote_object_t object; \
     uint8_t buffer[ \
-        num_remote * REMOTE_OBJECT_SIZE(sizeof(type)) + \
-        num_local * LOCAL_OBJECT_SIZE(sizeof(type))]; \
+        (num_remote) * REMOTE_OBJECT_SIZE(sizeof(type), type_flags) + \
+        (num_local) * LOCAL_OBJECT_SIZE(sizeof(type), type_flags) + \
+        (num_local + num_remote) * NUM_DELTA_STATES(type_flags) * DELTA_STATE_SIZE(sizeof(type)) + \
+        (num_local) * NUM_RELIABLE_STATES(type_flags) * RELIABLE_STATE_SIZE]; \
 } remote_object_##name##_t;
 
 #define MASTER_TO_ALL_SLAVES_OBJECT(name, type) \
-    REMOTE_OBJECT_HELPER(name, type, 1, 1) \
+    MASTER_TO_ALL_SLAVES_OBJECT_WITH_FLAGS(name, type, 0)
+
+#define MASTER_TO_ALL_SLAVES_DELTA_OBJECT(name, type) \
+    MASTER_TO_ALL_SLAVES_OBJECT_WITH_FLAGS(name, type, REMOTE_OBJECT_DELTA)
+
+#define MASTER_TO_ALL_SLAVES_OBJECT_WITH_FLAGS(name, type, object_flags) \
+    REMOTE_OBJECT_HELPER(name, type, object_flags & ~REMOTE_OBJECT_RELIABLE, 1, 1) \
     remote_object_##name##_t remote_object_##name = { \
         .object = { \
             .object_type = MASTER_TO_ALL_SLAVES, \
             .object_size = sizeof(type), \
+            .flags = object_flags & ~REMOTE_OBJECT_RELIABLE, \
         } \
     }; \
     type* begin_write_##name(void) { \
-        remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
-        triple_buffer_object_t* tb = (triple_buffer_object_t*)obj->buffer; \
-        return (type*)triple_buffer_begin_write_internal(sizeof(type) + LOCAL_OBJECT_EXTRA, tb); \
+        return (type*)transport_begin_write(&remote_object_##name.object, 0); \
     }\
     void end_write_##name(void) { \
-        remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
-        triple_buffer_object_t* tb = (triple_buffer_object_t*)obj->buffer; \
-        triple_buffer_end_write_internal(tb); \
+        transport_end_write(&remote_object_##name.object, 0); \
         signal_data_written(); \
     }\
     type* read_##name(void) { \
-        remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
-        uint8_t* start = obj->buffer + LOCAL_OBJECT_SIZE(obj->object_size);\
-        triple_buffer_object_t* tb = (triple_buffer_object_t*)start; \
-        return (type*)triple_buffer_read_internal(obj->object_size, tb); \
+        return (type*)transport_read(&remote_object_##name.object, 0); \
     }
 
+// begin_write returns NULL when the slave is out of range, or the pool is full
 #define MASTER_TO_SINGLE_SLAVE_OBJECT(name, type) \
-    REMOTE_OBJECT_HELPER(name, type, NUM_SLAVES, 1) \
+    MASTER_TO_SINGLE_SLAVE_OBJECT_WITH_FLAGS(name, type, 0)
+
+#define MASTER_TO_SINGLE_SLAVE_OBJECT_WITH_FLAGS(name, type, object_flags) \
+    REMOTE_OBJECT_HELPER(name, type, object_flags & ~REMOTE_OBJECT_DELTA, 0, 1) \
     remote_object_##name##_t remote_object_##name = { \
         .object = { \
             .object_type = MASTER_TO_SINGLE_SLAVE, \
             .object_size = sizeof(type), \
+            .flags = object_flags & ~REMOTE_OBJECT_DELTA, \
         } \
     }; \
     type* begin_write_##name(uint8_t slave) { \
-        remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
-        uint8_t* start = obj->buffer;\
-        start += slave * LOCAL_OBJECT_SIZE(obj->object_size); \
-        triple_buffer_object_t* tb = (triple_buffer_object_t*)start; \
-        return (type*)triple_buffer_begin_write_internal(sizeof(type) + LOCAL_OBJECT_EXTRA, tb); \
+        return (type*)transport_begin_write(&remote_object_##name.object, slave); \
     }\
     void end_write_##name(uint8_t slave) { \
-        remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
-        uint8_t* start = obj->buffer;\
-        start += slave * LOCAL_OBJECT_SIZE(obj->object_size); \
-        triple_buffer_object_t* tb = (triple_buffer_object_t*)start; \
-        triple_buffer_end_write_internal(tb); \
+        transport_end_write(&remote_object_##name.object, slave); \
         signal_data_written(); \
     }\
     type* read_##name() { \
-        remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
-        uint8_t* start = obj->buffer + NUM_SLAVES * LOCAL_OBJECT_SIZE(obj->object_size);\
-        triple_buffer_object_t* tb = (triple_buffer_object_t*)start; \
-        return (type*)triple_buffer_read_internal(obj->object_size, tb); \
+        return (type*)transport_read(&remote_object_##name.object, 0); \
     }
 
 #define SLAVE_TO_MASTER_OBJECT(name, type) \
-    REMOTE_OBJECT_HELPER(name, type, 1, NUM_SLAVES) \
+    SLAVE_TO_MASTER_OBJECT_WITH_FLAGS(name, type, 0)
+
+#define SLAVE_TO_MASTER_DELTA_OBJECT(name, type) \
+    SLAVE_TO_MASTER_OBJECT_WITH_FLAGS(name, type, REMOTE_OBJECT_DELTA)
+
+// read returns NULL for slaves that haven't sent anything yet
+#define SLAVE_TO_MASTER_OBJECT_WITH_FLAGS(name, type, object_flags) \
+    REMOTE_OBJECT_HELPER(name, type, object_flags, 1, 0) \
     remote_object_##name##_t remote_object_##name = { \
         .object = { \
             .object_type = SLAVE_TO_MASTER, \
             .object_size = sizeof(type), \
+            .flags = object_flags, \
         } \
     }; \
     type* begin_write_##name(void) { \
-        remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
-        triple_buffer_object_t* tb = (triple_buffer_object_t*)obj->buffer; \
-        return (type*)triple_buffer_begin_write_internal(sizeof(type) + LOCAL_OBJECT_EXTRA, tb); \
+        return (type*)transport_begin_write(&remote_object_##name.object, 0); \
     }\
     void end_write_##name(void) { \
-        remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
-        triple_buffer_object_t* tb = (triple_buffer_object_t*)obj->buffer; \
-        triple_buffer_end_write_internal(tb); \
+        transport_end_write(&remote_object_##name.object, 0); \
         signal_data_written(); \
     }\
     type* read_##name(uint8_t slave) { \
-        remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
-        uint8_t* start = obj->buffer + LOCAL_OBJECT_SIZE(obj->object_size);\
-        start+=slave * REMOTE_OBJECT_SIZE(obj->object_size); \
-        triple_buffer_object_t* tb = (triple_buffer_object_t*)start; \
-        return (type*)triple_buffer_read_internal(obj->object_size, tb); \
+        return (type*)transport_read(&remote_object_##name.object, slave); \
     }
 
 #define REMOTE_OBJECT(name) (remote_object_t*)&remote_object_##name
 
+// Objects have to be added before the link is used
 void add_remote_objects(remote_object_t** remote_objects, uint32_t num_remote_objects);
 void reinitialize_serial_link_transport(void);
 void transport_recv_frame(uint8_t from, uint8_t* data, uint16_t size);
-void update_transport(void);
+// Sends the objects that have been written since the last update, highest
+// priority first. Returns the number of milliseconds until a rate limited
+// object that is still waiting can be sent, or 0 if none is waiting.
+uint16_t update_transport(void);
+
+// Sets the priority of the object, and the minimum number of milliseconds
+// between two frames of it, 0 for no limit. A write during the interval is
+// sent when it ends, only the latest one.
+void transport_set_schedule(remote_object_t* obj, uint8_t priority, uint16_t min_interval);
+
+// Used by the object macros, slave is only used for the objects that have one
+// per slave
+void* transport_begin_write(remote_object_t* obj, uint8_t slave);
+void transport_end_write(remote_object_t* obj, uint8_t slave);
+void* transport_read(remote_object_t* obj, uint8_t slave);
+
+// The bytes of the pool given to the slaves so far
+uint16_t transport_get_pool_used(void);
 
 #endif
@@ -23,56 +23,51 @@ SOFTWARE.
 */
 
 #include "serial_link/protocol/triple_buffered_object.h"
-#include "serial_link/system/serial_link.h"
+#include "serial_link/protocol/atomic_state.h"
 #include <stdbool.h>
 #include <stddef.h>
 
-#define GET_READ_INDEX() object->state & 3
-#define GET_WRITE_INDEX() (object->state >> 2) & 3
-#define GET_SHARED_INDEX() (object->state >> 4) & 3
-#define GET_DATA_AVAILABLE() (object->state >> 6) & 1
+// The state packs the read, write and shared indices and the data available
+// flag. The reader only changes the read index, and the writer only the write
+// index, but both swap theirs with the shared one, so the whole byte is
+// updated with a compare and swap, which fails when the other side changed it
+// in between.
 
-#define SET_READ_INDEX(i) object->state = ((object->state & ~3) | i)
-#define SET_WRITE_INDEX(i) object->state = ((object->state & ~(3 << 2)) | (i << 2))
-#define SET_SHARED_INDEX(i) object->state = ((object->state & ~(3 << 4)) | (i << 4))
-#define SET_DATA_AVAILABLE(i) object->state = ((object->state & ~(1 << 6)) | (i << 6))
+#define GET_READ_INDEX(state) ((state) & 3)
+#define GET_WRITE_INDEX(state) (((state) >> 2) & 3)
+#define GET_SHARED_INDEX(state) (((state) >> 4) & 3)
+#define GET_DATA_AVAILABLE(state) (((state) >> 6) & 1)
+
+#define MAKE_STATE(read, write, shared, available) \
+    ((read) | ((write) << 2) | ((shared) << 4) | ((available) << 6))
 
 void triple_buffer_init(triple_buffer_object_t* object) {
-    object->state = 0;
-    SET_WRITE_INDEX(0);
-    SET_READ_INDEX(1);
-    SET_SHARED_INDEX(2);
-    SET_DATA_AVAILABLE(0);
+    object->state = MAKE_STATE(1, 0, 2, 0);
 }
 
 void* triple_buffer_read_internal(uint16_t object_size, triple_buffer_object_t* object) {
-    serial_link_lock();
-    if (GET_DATA_AVAILABLE()) {
-        uint8_t shared_index = GET_SHARED_INDEX();
-        uint8_t read_index = GET_READ_INDEX();
-        SET_READ_INDEX(shared_index);
-        SET_SHARED_INDEX(read_index);
-        SET_DATA_AVAILABLE(false);
-        serial_link_unlock();
-        return object->buffer + object_size * shared_index;
-    }
-    else {
-        serial_link_unlock();
-        return NULL;
-    }
+    uint8_t state;
+    uint8_t shared_index;
+    do {
+        state = load_state(&object->state);
+        if (!GET_DATA_AVAILABLE(state)) {
+            return NULL;
+        }
+        shared_index = GET_SHARED_INDEX(state);
+    } while (!compare_and_swap_state(&object->state, state,
+        MAKE_STATE(shared_index, GET_WRITE_INDEX(state), GET_READ_INDEX(state), 0)));
+    return object->buffer + object_size * shared_index;
 }
 
 void* triple_buffer_begin_write_internal(uint16_t object_size, triple_buffer_object_t* object) {
-    uint8_t write_index = GET_WRITE_INDEX();
+    uint8_t write_index = GET_WRITE_INDEX(load_state(&object->state));
     return object->buffer + object_size * write_index;
 }
 
 void triple_buffer_end_write_internal(triple_buffer_object_t* object) {
-    serial_link_lock();
-    uint8_t shared_index = GET_SHARED_INDEX();
-    uint8_t write_index = GET_WRITE_INDEX();
-    SET_SHARED_INDEX(write_index);
-    SET_WRITE_INDEX(shared_index);
-    SET_DATA_AVAILABLE(true);
-    serial_link_unlock();
+    uint8_t state;
+    do {
+        state = load_state(&object->state);
+    } while (!compare_and_swap_state(&object->state, state,
+        MAKE_STATE(GET_READ_INDEX(state), GET_SHARED_INDEX(state), GET_WRITE_INDEX(state), 1)));
 }
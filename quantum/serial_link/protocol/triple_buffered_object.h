@@ -27,6 +27,8 @@ SOFTWARE.
 
 #include <stdint.h>
 
+// One writer and one reader can use the object at the same time without
+// locking, see atomic_state.h
 typedef struct {
     uint8_t state;
     uint8_t buffer[] __attribute__((aligned(4)));
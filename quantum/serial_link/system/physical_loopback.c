@@ -0,0 +1,140 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "serial_link/protocol/physical.h"
+
+#if defined(SERIAL_LINK_LOOPBACK)
+
+#include "serial_link/system/physical_loopback.h"
+#include "serial_link/protocol/byte_stuffer.h"
+#include "serial_link/protocol/frame_router.h"
+#include "serial_link/protocol/link_stats.h"
+#include <string.h>
+
+typedef struct {
+    uint8_t data[LOOPBACK_BUFFER_SIZE];
+    uint16_t size;
+} wire_t;
+
+// Indexed by the sending link
+static wire_t wires[NUM_LINKS];
+
+uint16_t loopback_chunk_size = 0;
+uint32_t loopback_dropped = 0;
+uint16_t loopback_error_rate = 0;
+uint32_t loopback_baud[NUM_LINKS];
+uint32_t loopback_max_baud = 0;
+uint16_t loopback_overspeed_error_rate = 65536 / 16;
+static uint32_t random_state = 1;
+
+void loopback_seed(uint32_t seed) {
+    random_state = seed ? seed : 1;
+}
+
+// xorshift32
+static uint32_t next_random(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+void loopback_clear(void) {
+    for (uint8_t i = 0; i < NUM_LINKS; i++) {
+        wires[i].size = 0;
+    }
+    loopback_dropped = 0;
+}
+
+void physical_init(void) {
+    loopback_clear();
+    for (uint8_t i = 0; i < NUM_LINKS; i++) {
+        loopback_baud[i] = 0;
+    }
+}
+
+void physical_set_baud(uint8_t link, uint32_t baud) {
+    loopback_baud[link] = baud;
+}
+
+void physical_start(void) {
+}
+
+bool physical_receive(void) {
+    bool received = false;
+    // Only what was on the wires already, what is sent while receiving is
+    // for the next call. A slave forwarding a frame puts it back on the same
+    // wire, so each call is the next hop of a chain.
+    uint16_t ends[NUM_LINKS];
+    for (uint8_t i = 0; i < NUM_LINKS; i++) {
+        ends[i] = wires[i].size;
+    }
+    for (uint8_t i = 0; i < NUM_LINKS; i++) {
+        wire_t* wire = &wires[i];
+        uint8_t link = i == UP_LINK ? DOWN_LINK : UP_LINK;
+        uint16_t end = ends[i];
+        uint16_t pos = 0;
+        while (pos < end) {
+            uint16_t size = end - pos;
+            if (loopback_chunk_size && size > loopback_chunk_size) {
+                size = loopback_chunk_size;
+            }
+            byte_stuffer_recv(link, wire->data + pos, size);
+            pos += size;
+            received = true;
+        }
+        wire->size -= end;
+        memmove(wire->data, wire->data + end, wire->size);
+    }
+    return received;
+}
+
+void send_data(uint8_t link, const uint8_t* data, uint16_t size) {
+    wire_t* wire = &wires[link];
+    if (size > LOOPBACK_BUFFER_SIZE - wire->size) {
+        loopback_dropped += size - (LOOPBACK_BUFFER_SIZE - wire->size);
+        link_stats.links[link == UP_LINK ? DOWN_LINK : UP_LINK].overruns++;
+        size = LOOPBACK_BUFFER_SIZE - wire->size;
+    }
+    memcpy(wire->data + wire->size, data, size);
+    uint32_t baud = loopback_baud[link];
+    if (baud != loopback_baud[link == UP_LINK ? DOWN_LINK : UP_LINK]) {
+        for (uint16_t i = 0; i < size; i++) {
+            wire->data[wire->size + i] = next_random();
+        }
+    }
+    uint16_t error_rate = loopback_max_baud && baud > loopback_max_baud ?
+        loopback_overspeed_error_rate : loopback_error_rate;
+    if (error_rate) {
+        for (uint16_t i = 0; i < size; i++) {
+            uint32_t r = next_random();
+            if ((r & 0xFFFF) < error_rate) {
+                wire->data[wire->size + i] ^= 1 << ((r >> 16) & 7);
+            }
+        }
+    }
+    wire->size += size;
+}
+
+#endif
@@ -0,0 +1,61 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SERIAL_LINK_PHYSICAL_LOOPBACK_H
+#define SERIAL_LINK_PHYSICAL_LOOPBACK_H
+
+#include <stdint.h>
+#include "serial_link/protocol/byte_stuffer.h"
+
+// The loopback crosses the links, what is sent up is received from down and
+// the other way around. So a single process can play the master and a slave,
+// by switching router_set_master between sending and receiving. What a slave
+// forwards comes back to it on the next physical_receive, so receiving again
+// as a slave plays the next slave of a chain.
+
+#ifndef LOOPBACK_BUFFER_SIZE
+#define LOOPBACK_BUFFER_SIZE 4096
+#endif
+
+// Received data is handed to the byte stuffer in chunks of this size, like a
+// DMA would, 0 delivers everything at once
+extern uint16_t loopback_chunk_size;
+// Bytes that didn't fit in the buffers
+extern uint32_t loopback_dropped;
+// The chance, out of 65536, that a bit of a sent byte is flipped, like noise
+// on the line would
+extern uint16_t loopback_error_rate;
+// The rates the links are set to. When the two ends of a wire disagree, what
+// is received is garbage.
+extern uint32_t loopback_baud[NUM_LINKS];
+// Above this rate the line is bad, and loopback_overspeed_error_rate is used
+// instead of loopback_error_rate, 0 for no limit
+extern uint32_t loopback_max_baud;
+extern uint16_t loopback_overspeed_error_rate;
+
+void loopback_clear(void);
+// Makes the noise repeatable
+void loopback_seed(uint32_t seed);
+
+#endif
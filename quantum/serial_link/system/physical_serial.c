@@ -0,0 +1,158 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// The physical layer on top of the ChibiOS serial driver, SD1 is the down
+// link and SD2 the up link
+
+#include "serial_link/protocol/physical.h"
+
+#if !defined(SERIAL_LINK_UART_DMA) && !defined(SERIAL_LINK_LOOPBACK)
+
+#include "hal.h"
+#include "serial_link/protocol/byte_stuffer.h"
+#include "serial_link/protocol/frame_router.h"
+#include "serial_link/protocol/link_stats.h"
+#include "print.h"
+#include "config.h"
+
+// Define these in your Config.h file
+#ifndef SERIAL_LINK_BAUD
+#error "Serial link baud is not set"
+#endif
+
+static SerialConfig configs[NUM_LINKS] = {
+    {.sc_speed = SERIAL_LINK_BAUD},
+    {.sc_speed = SERIAL_LINK_BAUD},
+};
+
+static event_listener_t sd1_listener;
+static event_listener_t sd2_listener;
+
+//#define DEBUG_LINK_ERRORS
+
+static void count_errors(uint8_t link, eventflags_t flags) {
+    link_counters_t* counters = &link_stats.links[link];
+    if (flags & (SD_PARITY_ERROR | SD_FRAMING_ERROR | SD_NOISE_ERROR)) {
+        counters->line_errors++;
+    }
+    if (flags & SD_OVERRUN_ERROR) {
+        counters->overruns++;
+    }
+}
+
+static void print_error(char* str, eventflags_t flags, SerialDriver* driver) {
+#ifdef DEBUG_LINK_ERRORS
+    if (flags & SD_PARITY_ERROR) {
+        print(str);
+        print(" Parity error\n");
+    }
+    if (flags & SD_FRAMING_ERROR) {
+        print(str);
+        print(" Framing error\n");
+    }
+    if (flags & SD_OVERRUN_ERROR) {
+        print(str);
+        uint32_t size = qSpaceI(&(driver->iqueue));
+        xprintf(" Overrun error, queue size %d\n", size);
+
+    }
+    if (flags & SD_NOISE_ERROR) {
+        print(str);
+        print(" Noise error\n");
+    }
+    if (flags & SD_BREAK_DETECTED) {
+        print(str);
+        print(" Break detected\n");
+    }
+#else
+    (void)str;
+    (void)flags;
+    (void)driver;
+#endif
+}
+
+static uint32_t read_from_serial(SerialDriver* driver, uint8_t link) {
+    const uint32_t buffer_size = 64;
+    uint8_t buffer[buffer_size];
+    uint32_t bytes_read = sdAsynchronousRead(driver, buffer, buffer_size);
+    byte_stuffer_recv(link, buffer, bytes_read);
+    return bytes_read;
+}
+
+static SerialDriver* get_driver(uint8_t link) {
+    return link == DOWN_LINK ? &SD1 : &SD2;
+}
+
+void physical_init(void) {
+    sdStart(&SD1, &configs[DOWN_LINK]);
+    sdStart(&SD2, &configs[UP_LINK]);
+}
+
+void physical_set_baud(uint8_t link, uint32_t baud) {
+    SerialDriver* driver = get_driver(link);
+    if (configs[link].sc_speed == baud) {
+        return;
+    }
+    while (!oqIsEmptyI(&driver->oqueue)) {
+        chThdSleepMilliseconds(1);
+    }
+    // The last byte is still in the shift register, one byte takes about a
+    // millisecond at 9600 baud
+    chThdSleepMilliseconds(2);
+    configs[link].sc_speed = baud;
+    sdStop(driver);
+    sdStart(driver, &configs[link]);
+}
+
+void physical_start(void) {
+    eventflags_t events = CHN_INPUT_AVAILABLE
+            | SD_PARITY_ERROR | SD_FRAMING_ERROR | SD_OVERRUN_ERROR | SD_NOISE_ERROR | SD_BREAK_DETECTED;
+    chEvtRegisterMaskWithFlags(chnGetEventSource(&SD1),
+        &sd1_listener,
+        EVENT_MASK(1),
+        events);
+    chEvtRegisterMaskWithFlags(chnGetEventSource(&SD2),
+        &sd2_listener,
+        EVENT_MASK(2),
+        events);
+}
+
+bool physical_receive(void) {
+    eventflags_t down_flags = chEvtGetAndClearFlags(&sd1_listener);
+    eventflags_t up_flags = chEvtGetAndClearFlags(&sd2_listener);
+    count_errors(DOWN_LINK, down_flags);
+    count_errors(UP_LINK, up_flags);
+    print_error("DOWNLINK", down_flags, &SD1);
+    print_error("UPLINK", up_flags, &SD2);
+    bool received = false;
+    received |= read_from_serial(&SD2, UP_LINK) != 0;
+    received |= read_from_serial(&SD1, DOWN_LINK) != 0;
+    return received;
+}
+
+void send_data(uint8_t link, const uint8_t* data, uint16_t size) {
+    sdWrite(get_driver(link), data, size);
+}
+
+#endif
@@ -0,0 +1,203 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// The physical layer on top of the ChibiOS UART driver. The receiver DMA
+// fills one half of a double buffer while the serial link thread decodes the
+// other one. A half is handed over when it's full, or when the line goes idle,
+// which normally happens at the end of every frame. So the thread wakes up
+// once per frame or chunk, instead of for every few bytes like with the
+// serial driver queues. A half only goes back to the DMA once the thread has
+// decoded it and cleared its ready count. Frames are sent with a single DMA
+// transfer.
+//
+// Enable it with SERIAL_LINK_UART_DMA and HAL_USE_UART. The idle line
+// detection needs a UART driver with UART_USE_TIMEOUT, without it a half is
+// only handed over when it's full. SERIAL_LINK_UART_DOWN and
+// SERIAL_LINK_UART_UP select the drivers, UARTD1 and UARTD2 by default.
+//
+// Experimental: no keyboard in the tree enables SERIAL_LINK_UART_DMA yet, and
+// this file has not been compiled against a ChibiOS HAL or run on hardware.
+// The uartSendFullTimeout() and timeout_cb calls follow the ChibiOS 16 UART
+// driver API and need checking against the HAL a board actually uses.
+
+#include "serial_link/protocol/physical.h"
+
+#if defined(SERIAL_LINK_UART_DMA)
+
+#include "hal.h"
+#include "serial_link/protocol/byte_stuffer.h"
+#include "serial_link/protocol/frame_router.h"
+#include "serial_link/protocol/link_stats.h"
+#include "config.h"
+
+#if !HAL_USE_UART
+#error "SERIAL_LINK_UART_DMA needs HAL_USE_UART"
+#endif
+
+#ifndef SERIAL_LINK_BAUD
+#error "Serial link baud is not set"
+#endif
+
+#ifndef SERIAL_LINK_UART_DOWN
+#define SERIAL_LINK_UART_DOWN UARTD1
+#endif
+
+#ifndef SERIAL_LINK_UART_UP
+#define SERIAL_LINK_UART_UP UARTD2
+#endif
+
+// Should take less time to receive than the thread needs to decode the
+// other half, 64 bytes is more than a millisecond at 562500 baud
+#ifndef PHYSICAL_UART_CHUNK_SIZE
+#define PHYSICAL_UART_CHUNK_SIZE 64
+#endif
+
+typedef struct {
+    UARTDriver* driver;
+    uint8_t buffers[2][PHYSICAL_UART_CHUNK_SIZE];
+    // The half the DMA is filling
+    uint8_t active;
+    // Bytes waiting to be decoded in each half, the thread owns a half
+    // while this is not zero
+    uint16_t ready[2];
+} physical_link_t;
+
+static physical_link_t links[NUM_LINKS];
+static UARTConfig configs[NUM_LINKS];
+static event_source_t rx_event;
+static event_listener_t rx_listener;
+
+static physical_link_t* get_link(UARTDriver* uartp) {
+    return uartp == links[UP_LINK].driver ? &links[UP_LINK] : &links[DOWN_LINK];
+}
+
+// Called from the ISRs with the number of bytes the DMA wrote to the active half
+static void hand_over_i(UARTDriver* uartp, uint16_t size) {
+    physical_link_t* link = get_link(uartp);
+    if (size > 0) {
+        uint8_t next = link->active ^ 1;
+        if (link->ready[next]) {
+            // The thread fell behind and still owns the other half, it may be
+            // decoding it right now. Drop the new data and receive into the
+            // same half again, the byte stuffer resynchronizes on the next frame
+            link_stats.links[link - links].overruns++;
+        } else {
+            link->ready[link->active] = size;
+            link->active = next;
+            chEvtBroadcastI(&rx_event);
+        }
+    }
+    uartStartReceiveI(uartp, PHYSICAL_UART_CHUNK_SIZE, link->buffers[link->active]);
+}
+
+static void rx_end(UARTDriver* uartp) {
+    chSysLockFromISR();
+    hand_over_i(uartp, PHYSICAL_UART_CHUNK_SIZE);
+    chSysUnlockFromISR();
+}
+
+#if UART_USE_TIMEOUT
+static void rx_idle(UARTDriver* uartp) {
+    chSysLockFromISR();
+    uint16_t remaining = uartStopReceiveI(uartp);
+    hand_over_i(uartp, PHYSICAL_UART_CHUNK_SIZE - remaining);
+    chSysUnlockFromISR();
+}
+#endif
+
+static const UARTConfig default_config = {
+    .rxend_cb = rx_end,
+#if UART_USE_TIMEOUT
+    .timeout_cb = rx_idle,
+#endif
+    .speed = SERIAL_LINK_BAUD,
+};
+
+void physical_init(void) {
+    chEvtObjectInit(&rx_event);
+    links[UP_LINK].driver = &SERIAL_LINK_UART_UP;
+    links[DOWN_LINK].driver = &SERIAL_LINK_UART_DOWN;
+    for (uint8_t i = 0; i < NUM_LINKS; i++) {
+        physical_link_t* link = &links[i];
+        link->active = 0;
+        link->ready[0] = 0;
+        link->ready[1] = 0;
+        configs[i] = default_config;
+        uartStart(link->driver, &configs[i]);
+        uartStartReceive(link->driver, PHYSICAL_UART_CHUNK_SIZE, link->buffers[0]);
+    }
+}
+
+void physical_set_baud(uint8_t link, uint32_t baud) {
+    physical_link_t* l = &links[link];
+    if (configs[link].speed == baud) {
+        return;
+    }
+    // send_data has waited for the DMA, give the last byte time to leave
+    chThdSleepMilliseconds(2);
+    uartStop(l->driver);
+    // What was received but not decoded yet is lost, like on any rate change
+    osalSysLock();
+    l->active = 0;
+    l->ready[0] = 0;
+    l->ready[1] = 0;
+    osalSysUnlock();
+    configs[link].speed = baud;
+    uartStart(l->driver, &configs[link]);
+    uartStartReceive(l->driver, PHYSICAL_UART_CHUNK_SIZE, l->buffers[0]);
+}
+
+void physical_start(void) {
+    chEvtRegister(&rx_event, &rx_listener, 1);
+}
+
+bool physical_receive(void) {
+    bool received = false;
+    for (uint8_t i = 0; i < NUM_LINKS; i++) {
+        physical_link_t* link = &links[i];
+        // The half after the active one was handed over first
+        for (uint8_t j = 1; j <= 2; j++) {
+            uint8_t half = (link->active + j) & 1;
+            osalSysLock();
+            uint16_t size = link->ready[half];
+            osalSysUnlock();
+            if (size) {
+                byte_stuffer_recv(i, link->buffers[half], size);
+                osalSysLock();
+                link->ready[half] = 0;
+                osalSysUnlock();
+                received = true;
+            }
+        }
+    }
+    return received;
+}
+
+void send_data(uint8_t link, const uint8_t* data, uint16_t size) {
+    size_t n = size;
+    // Sleeps until the DMA is done, the data is only valid until we return
+    uartSendFullTimeout(links[link].driver, &n, data, TIME_INFINITE);
+}
+
+#endif
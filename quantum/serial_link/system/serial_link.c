@@ -28,8 +28,12 @@ SOFTWARE.
 #include "serial_link/protocol/byte_stuffer.h"
 #include "serial_link/protocol/transport.h"
 #include "serial_link/protocol/frame_router.h"
+#include "serial_link/protocol/physical.h"
+#include "serial_link/protocol/link_stats.h"
+#include "serial_link/protocol/baud_negotiation.h"
 #include "matrix.h"
 #include <stdbool.h>
+#include <string.h>
 #include "print.h"
 #include "config.h"
 
@@ -52,64 +56,10 @@ host_driver_t serial_driver = {
 };
 
 // Define these in your Config.h file
-#ifndef SERIAL_LINK_BAUD
-#error "Serial link baud is not set"
-#endif
-
 #ifndef SERIAL_LINK_THREAD_PRIORITY
 #error "Serial link thread priority not set"
 #endif
 
-static SerialConfig config = {
-    .sc_speed = SERIAL_LINK_BAUD
-};
-
-//#define DEBUG_LINK_ERRORS
-
-static uint32_t read_from_serial(SerialDriver* driver, uint8_t link) {
-    const uint32_t buffer_size = 16;
-    uint8_t buffer[buffer_size];
-    uint32_t bytes_read = sdAsynchronousRead(driver, buffer, buffer_size);
-    uint8_t* current = buffer;
-    uint8_t* end = current + bytes_read;
-    while(current < end) {
-        byte_stuffer_recv_byte(link, *current);
-        current++;
-    }
-    return bytes_read;
-}
-
-static void print_error(char* str, eventflags_t flags, SerialDriver* driver) {
-#ifdef DEBUG_LINK_ERRORS
-    if (flags & SD_PARITY_ERROR) {
-        print(str);
-        print(" Parity error\n");
-    }
-    if (flags & SD_FRAMING_ERROR) {
-        print(str);
-        print(" Framing error\n");
-    }
-    if (flags & SD_OVERRUN_ERROR) {
-        print(str);
-        uint32_t size = qSpaceI(&(driver->iqueue));
-        xprintf(" Overrun error, queue size %d\n", size);
-
-    }
-    if (flags & SD_NOISE_ERROR) {
-        print(str);
-        print(" Noise error\n");
-    }
-    if (flags & SD_BREAK_DETECTED) {
-        print(str);
-        print(" Break detected\n");
-    }
-#else
-    (void)str;
-    (void)flags;
-    (void)driver;
-#endif
-}
-
 bool is_serial_link_master(void) {
     return is_master;
 }
@@ -119,78 +69,93 @@ static THD_WORKING_AREA(serialThreadStack, 1024);
 static THD_FUNCTION(serialThread, arg) {
     (void)arg;
     event_listener_t new_data_listener;
-    event_listener_t sd1_listener;
-    event_listener_t sd2_listener;
     chEvtRegister(&new_data_event, &new_data_listener, 0);
-    eventflags_t events = CHN_INPUT_AVAILABLE
-            | SD_PARITY_ERROR | SD_FRAMING_ERROR | SD_OVERRUN_ERROR | SD_NOISE_ERROR | SD_BREAK_DETECTED;
-    chEvtRegisterMaskWithFlags(chnGetEventSource(&SD1),
-        &sd1_listener,
-        EVENT_MASK(1),
-        events);
-    chEvtRegisterMaskWithFlags(chnGetEventSource(&SD2),
-        &sd2_listener,
-        EVENT_MASK(2),
-        events);
+    // The physical layer registers its own events, which wake up the wait below
+    physical_start();
     bool need_wait = false;
+    uint16_t wait_ms = 1000;
     while(true) {
-        eventflags_t flags1 = 0;
-        eventflags_t flags2 = 0;
         if (need_wait) {
-            eventmask_t mask = chEvtWaitAnyTimeout(ALL_EVENTS, MS2ST(1000));
-            if (mask & EVENT_MASK(1)) {
-                flags1 = chEvtGetAndClearFlags(&sd1_listener);
-                print_error("DOWNLINK", flags1, &SD1);
-            }
-            if (mask & EVENT_MASK(2)) {
-                flags2 = chEvtGetAndClearFlags(&sd2_listener);
-                print_error("UPLINK", flags2, &SD2);
-            }
+            chEvtWaitAnyTimeout(ALL_EVENTS, MS2ST(wait_ms));
         }
 
         // Always stay as master, even if the USB goes into sleep mode
         is_master |= usbGetDriverStateI(&USBD1) == USB_ACTIVE;
         router_set_master(is_master);
 
-        need_wait = true;
-        need_wait &= read_from_serial(&SD2, UP_LINK) == 0;
-        need_wait &= read_from_serial(&SD1, DOWN_LINK) == 0;
-        update_transport();
-    }
-}
-
-void send_data(uint8_t link, const uint8_t* data, uint16_t size) {
-    if (link == DOWN_LINK) {
-        sdWrite(&SD1, data, size);
-    }
-    else {
-        sdWrite(&SD2, data, size);
+        need_wait = !physical_receive();
+        // Wake up in time for the rate limited objects that are waiting
+        wait_ms = update_transport();
+        if (wait_ms == 0) {
+            wait_ms = 1000;
+        }
+        uint16_t baud_wait_ms = baud_negotiation_update();
+        if (baud_wait_ms < wait_ms) {
+            wait_ms = baud_wait_ms;
+        }
     }
 }
 
 static systime_t last_update = 0;
 
+// The matrix is acknowledged and sent again when it's lost, so it only needs
+// to be refreshed once in a while, for a master that starts after the slave
+#ifndef SERIAL_LINK_REFRESH_MS
+#define SERIAL_LINK_REFRESH_MS 100
+#endif
+
 typedef struct {
     matrix_row_t rows[MATRIX_ROWS];
 } matrix_object_t;
 
 static matrix_object_t last_matrix = {};
 
-SLAVE_TO_MASTER_OBJECT(keyboard_matrix, matrix_object_t);
+#define KEYBOARD_MATRIX_FLAGS (REMOTE_OBJECT_DELTA | REMOTE_OBJECT_RELIABLE)
+SLAVE_TO_MASTER_OBJECT_WITH_FLAGS(keyboard_matrix, matrix_object_t, KEYBOARD_MATRIX_FLAGS);
 MASTER_TO_ALL_SLAVES_OBJECT(serial_link_connected, bool);
+// The master acknowledges each changed matrix, for the latency statistics
+MASTER_TO_SINGLE_SLAVE_OBJECT(matrix_ack, uint8_t);
+// Sent once a second, so one copy less is enough
+SLAVE_TO_MASTER_OBJECT_WITH_FLAGS(slave_link_stats, link_stats_t, REMOTE_OBJECT_DOUBLE_BUFFERED);
 
 static remote_object_t* remote_objects[] = {
     REMOTE_OBJECT(serial_link_connected),
     REMOTE_OBJECT(keyboard_matrix),
+    REMOTE_OBJECT(matrix_ack),
+    REMOTE_OBJECT(slave_link_stats),
 };
 
+#define LINK_STATS_INTERVAL_MS 1000
+
+// The rates each link can be negotiated up to, the first one is where they
+// start, and return to when something goes wrong. With only one rate, the
+// links stay at it.
+#ifndef SERIAL_LINK_BAUD_RATES
+#define SERIAL_LINK_BAUD_RATES {SERIAL_LINK_BAUD}
+#endif
+
+static const uint32_t baud_rates[] = SERIAL_LINK_BAUD_RATES;
+
+static systime_t last_stats_update = 0;
+static bool latency_pending = false;
+static systime_t latency_start;
+static matrix_object_t last_remote_matrix = {};
+static uint8_t matrix_ack_count = 0;
+// The last statistics received from each slave, the buffer stays valid until
+// the next read
+static link_stats_t* remote_link_stats[NUM_SLAVES];
+
 void init_serial_link(void) {
     serial_link_connected = false;
     init_serial_link_hal();
+    link_stats_reset();
+    // The key presses go out before anything else that is waiting
+    transport_set_schedule(REMOTE_OBJECT(keyboard_matrix), REMOTE_OBJECT_PRIORITY_HIGH, 0);
+    transport_set_schedule(REMOTE_OBJECT(matrix_ack), REMOTE_OBJECT_PRIORITY_HIGH, 0);
     add_remote_objects(remote_objects, sizeof(remote_objects)/sizeof(remote_object_t*));
     init_byte_stuffer();
-    sdStart(&SD1, &config);
-    sdStart(&SD2, &config);
+    physical_init();
+    baud_negotiation_init(baud_rates, sizeof(baud_rates) / sizeof(baud_rates[0]));
     chEvtObjectInit(&new_data_event);
     (void)chThdCreateStatic(serialThreadStack, sizeof(serialThreadStack),
                               SERIAL_LINK_THREAD_PRIORITY, serialThread, NULL);
@@ -212,9 +177,13 @@ void serial_link_update(void) {
 
     systime_t current_time = chVTGetSystemTimeX();
     systime_t delta = current_time - last_update;
-    if (changed || delta > US2ST(1000)) {
+    if (changed || delta > MS2ST(SERIAL_LINK_REFRESH_MS)) {
         last_update = current_time;
         last_matrix = matrix;
+        if (changed && !latency_pending) {
+            latency_pending = true;
+            latency_start = current_time;
+        }
         matrix_object_t* m = begin_write_keyboard_matrix();
         for(uint8_t i=0;i<MATRIX_ROWS;i++) {
             m->rows[i] = matrix.rows[i];
@@ -227,6 +196,61 @@ void serial_link_update(void) {
     matrix_object_t* m = read_keyboard_matrix(0);
     if (m) {
         matrix_set_remote(m->rows, 0);
+        if (memcmp(m, &last_remote_matrix, sizeof(matrix_object_t)) != 0) {
+            last_remote_matrix = *m;
+            uint8_t* ack = begin_write_matrix_ack(0);
+            if (ack) {
+                *ack = ++matrix_ack_count;
+                end_write_matrix_ack(0);
+            }
+        }
+    }
+
+    if (read_matrix_ack() && latency_pending) {
+        latency_pending = false;
+        link_stats_add_latency(ST2MS(chVTGetSystemTimeX() - latency_start));
+    }
+
+    if (current_time - last_stats_update > MS2ST(LINK_STATS_INTERVAL_MS)) {
+        last_stats_update = current_time;
+        *begin_write_slave_link_stats() = link_stats;
+        end_write_slave_link_stats();
+    }
+    for (uint8_t i = 0; i < NUM_SLAVES; i++) {
+        link_stats_t* stats = read_slave_link_stats(i);
+        if (stats) {
+            remote_link_stats[i] = stats;
+        }
+    }
+}
+
+static void print_link_stats(link_stats_t* stats) {
+    static const char* link_names[NUM_LINKS] = {"up", "down"};
+    for (uint8_t i = 0; i < NUM_LINKS; i++) {
+        link_counters_t* c = &stats->links[i];
+        xprintf(" %s: sent %lu received %lu crc %lu cobs %lu oversize %lu overrun %lu line %lu retransmit %lu lost %lu\n",
+            link_names[i], c->frames_sent, c->frames_received, c->crc_errors, c->cobs_resets,
+            c->oversize_frames, c->overruns, c->line_errors, c->retransmits, c->lost_frames);
+    }
+    xprintf(" matrix latency ms: last %u min %u max %u avg %u (%lu samples)\n",
+        stats->latency_last, stats->latency_min, stats->latency_max, stats->latency_average,
+        stats->latency_samples);
+    if (stats->pool_exhausted) {
+        xprintf(" pool exhausted %lu\n", stats->pool_exhausted);
+    }
+}
+
+void serial_link_print_stats(void) {
+    print("\n\t- Serial link -\n");
+    print("this device\n");
+    xprintf(" baud: up %lu down %lu\n", baud_negotiation_get_baud(UP_LINK),
+        baud_negotiation_get_baud(DOWN_LINK));
+    print_link_stats(&link_stats);
+    for (uint8_t i = 0; i < NUM_SLAVES; i++) {
+        if (remote_link_stats[i]) {
+            xprintf("slave %u\n", i + 1);
+            print_link_stats(remote_link_stats[i]);
+        }
     }
 }
 
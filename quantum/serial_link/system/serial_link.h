@@ -34,6 +34,9 @@ bool is_serial_link_connected(void);
 bool is_serial_link_master(void);
 host_driver_t* get_serial_link_driver(void);
 void serial_link_update(void);
+// Prints the link statistics of this device, and on the master the ones the
+// slaves have sent
+void serial_link_print_stats(void);
 
 #if defined(PROTOCOL_CHIBIOS)
 #include "ch.h"
@@ -50,10 +53,10 @@ void signal_data_written(void);
 
 #else
 
-inline void serial_link_lock(void) {
+static inline void serial_link_lock(void) {
 }
 
-inline void serial_link_unlock(void) {
+static inline void serial_link_unlock(void) {
 }
 
 void signal_data_written(void);
@@ -0,0 +1,168 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "gtest/gtest.h"
+extern "C" {
+#include "serial_link/protocol/transport.h"
+#include "serial_link/protocol/byte_stuffer.h"
+#include "serial_link/protocol/frame_router.h"
+#include "serial_link/protocol/physical.h"
+#include "serial_link/protocol/link_stats.h"
+#include "serial_link/protocol/baud_negotiation.h"
+#include "serial_link/system/physical_loopback.h"
+}
+
+// The negotiation between the master's down link and the slave's up link,
+// over the loopback, which is noisy above loopback_max_baud
+
+MASTER_TO_ALL_SLAVES_OBJECT(connected, uint8_t);
+SLAVE_TO_MASTER_OBJECT(matrix, uint32_t);
+
+static remote_object_t* test_remote_objects[] = {
+    REMOTE_OBJECT(connected),
+    REMOTE_OBJECT(matrix),
+};
+
+static const uint32_t rates[] = {9600, 115200, 460800, 921600};
+
+static uint16_t now = 0;
+
+extern "C" {
+void signal_data_written(void) {
+}
+
+uint16_t timer_read(void) {
+    return now;
+}
+}
+
+class BaudNegotiation : public testing::Test {
+public:
+    BaudNegotiation() {
+        add_remote_objects(test_remote_objects, sizeof(test_remote_objects) / sizeof(remote_object_t*));
+        init_byte_stuffer();
+        physical_init();
+        physical_start();
+        loopback_chunk_size = 0;
+        loopback_error_rate = 0;
+        loopback_max_baud = 0;
+        loopback_seed(1);
+        link_stats_reset();
+        baud_negotiation_init(rates, sizeof(rates) / sizeof(rates[0]));
+    }
+
+    ~BaudNegotiation() {
+        reinitialize_serial_link_transport();
+        loopback_clear();
+    }
+
+    // Both ends send something every 10 milliseconds, when there's traffic
+    void run(uint32_t ms, bool traffic = true) {
+        for (uint32_t i = 0; i < ms; i++) {
+            if (traffic && now % 10 == 0) {
+                router_set_master(false);
+                *begin_write_matrix() = now;
+                end_write_matrix();
+                update_transport();
+                router_set_master(true);
+                *begin_write_connected() = 1;
+                end_write_connected();
+                update_transport();
+            }
+            baud_negotiation_update();
+            physical_receive();
+            now++;
+        }
+    }
+
+    void expect_baud(uint32_t baud) {
+        EXPECT_EQ(baud_negotiation_get_baud(DOWN_LINK), baud);
+        EXPECT_EQ(baud_negotiation_get_baud(UP_LINK), baud);
+        EXPECT_EQ(loopback_baud[DOWN_LINK], baud);
+        EXPECT_EQ(loopback_baud[UP_LINK], baud);
+    }
+};
+
+TEST_F(BaudNegotiation, starts_at_the_first_rate) {
+    expect_baud(9600);
+}
+
+TEST_F(BaudNegotiation, waits_for_a_clean_interval_before_stepping_up) {
+    run(BAUD_STEP_INTERVAL_MS - 10);
+    expect_baud(9600);
+    run(20);
+    expect_baud(115200);
+}
+
+TEST_F(BaudNegotiation, does_not_step_up_without_traffic) {
+    run(5 * BAUD_STEP_INTERVAL_MS, false);
+    expect_baud(9600);
+}
+
+TEST_F(BaudNegotiation, clean_line_steps_up_to_the_fastest_rate) {
+    run(10000);
+    expect_baud(921600);
+    EXPECT_EQ(baud_negotiation_get_link(DOWN_LINK)->state, BAUD_STABLE);
+}
+
+TEST_F(BaudNegotiation, stops_at_the_fastest_rate_the_line_allows) {
+    loopback_max_baud = 460800;
+    run(15000);
+    expect_baud(460800);
+    EXPECT_EQ(baud_negotiation_get_link(DOWN_LINK)->max_rate, 2);
+    // And doesn't try again
+    uint32_t errors = link_stats.links[DOWN_LINK].crc_errors;
+    run(10000);
+    expect_baud(460800);
+    EXPECT_EQ(link_stats.links[DOWN_LINK].crc_errors, errors);
+}
+
+TEST_F(BaudNegotiation, falls_back_when_the_errors_rise) {
+    run(10000);
+    expect_baud(921600);
+    loopback_max_baud = 115200;
+    run(20000);
+    EXPECT_GT(link_stats.links[DOWN_LINK].crc_errors + link_stats.links[DOWN_LINK].cobs_resets, 0);
+    expect_baud(115200);
+    EXPECT_LE(baud_negotiation_get_link(DOWN_LINK)->max_rate, 1);
+}
+
+TEST_F(BaudNegotiation, some_noise_at_a_good_rate_is_tolerated) {
+    run(10000);
+    expect_baud(921600);
+    // About one frame out of several hundred is corrupted
+    loopback_error_rate = 65536 / 5000;
+    run(10000);
+    expect_baud(921600);
+}
+
+TEST_F(BaudNegotiation, returns_to_the_first_rate_when_the_line_goes_silent) {
+    run(10000);
+    expect_baud(921600);
+    run(BAUD_SILENCE_MS + 10, false);
+    expect_baud(9600);
+    // And steps up again when the traffic comes back
+    run(10000);
+    expect_baud(921600);
+}
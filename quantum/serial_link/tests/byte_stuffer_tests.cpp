@@ -26,13 +26,18 @@ SOFTWARE.
 #include "gmock/gmock.h"
 #include <vector>
 #include <algorithm>
+#include <chrono>
+#include <iostream>
 extern "C" {
 #include "serial_link/protocol/byte_stuffer.h"
 #include "serial_link/protocol/frame_validator.h"
 #include "serial_link/protocol/physical.h"
+#include "serial_link/protocol/link_stats.h"
 }
 
 using testing::_;
+using testing::AnyNumber;
+using testing::Invoke;
 using testing::ElementsAreArray;
 using testing::Args;
 
@@ -41,6 +46,7 @@ public:
     ByteStuffer() {
         Instance = this;
         init_byte_stuffer();
+        link_stats_reset();
     }
 
     ~ByteStuffer() {
@@ -51,8 +57,21 @@ public:
 
     void send_data(uint8_t link, const uint8_t* data, uint16_t size) {
         std::copy(data, data + size, std::back_inserter(sent_data));
+        num_sends++;
     }
     std::vector<uint8_t> sent_data;
+    int num_sends = 0;
+
+    // Collects the received frames instead of checking them one by one
+    std::vector<std::vector<uint8_t>>& collect_frames() {
+        EXPECT_CALL(*this, validator_recv_frame(_, _, _))
+            .Times(AnyNumber())
+            .WillRepeatedly(Invoke([this](uint8_t link, uint8_t* data, uint16_t size) {
+                received_frames.emplace_back(data, data + size);
+            }));
+        return received_frames;
+    }
+    std::vector<std::vector<uint8_t>> received_frames;
 
     static ByteStuffer* Instance;
 };
@@ -301,6 +320,32 @@ TEST_F(ByteStuffer, received_frame_is_aborted_when_its_too_long) {
     byte_stuffer_recv_byte(0, 0);
 }
 
+TEST_F(ByteStuffer, counts_invalid_frames_as_resets) {
+    EXPECT_CALL(*this, validator_recv_frame(_, _, _));
+    byte_stuffer_recv_byte(1, 3);
+    byte_stuffer_recv_byte(1, 1);
+    byte_stuffer_recv_byte(1, 0);
+    byte_stuffer_recv_byte(1, 2);
+    byte_stuffer_recv_byte(1, 5);
+    byte_stuffer_recv_byte(1, 0);
+    EXPECT_EQ(link_stats.links[1].cobs_resets, 1);
+    EXPECT_EQ(link_stats.links[0].cobs_resets, 0);
+}
+
+TEST_F(ByteStuffer, counts_frames_that_are_too_long) {
+    EXPECT_CALL(*this, validator_recv_frame(_, _, _));
+    int i;
+    byte_stuffer_recv_byte(0, 1);
+    for(i=0;i<MAX_FRAME_SIZE;i++) {
+       byte_stuffer_recv_byte(0, 1);
+    }
+    byte_stuffer_recv_byte(0, 2);
+    byte_stuffer_recv_byte(0, 1);
+    byte_stuffer_recv_byte(0, 0);
+    EXPECT_EQ(link_stats.links[0].oversize_frames, 1);
+    EXPECT_EQ(link_stats.links[0].cobs_resets, 0);
+}
+
 TEST_F(ByteStuffer, does_nothing_when_sending_zero_size_frame) {
     EXPECT_EQ(sent_data.size(), 0);
     byte_stuffer_send_frame(0, NULL, 0);
@@ -481,3 +526,150 @@ TEST_F(ByteStuffer, sends_and_receives_full_roundtrip_254_bytes_and_then_zero) {
        byte_stuffer_recv_byte(1, d);
     }
 }
+
+TEST_F(ByteStuffer, sends_and_receives_full_roundtrip_zero_and_then_255_bytes) {
+    uint8_t original_data[256];
+    int i;
+    original_data[0] = 0;
+    for(i=1;i<256;i++) {
+        original_data[i] = i;
+    }
+    byte_stuffer_send_frame(0, original_data, sizeof(original_data));
+    EXPECT_CALL(*this, validator_recv_frame(_, _, _))
+        .With(Args<1, 2>(ElementsAreArray(original_data)));
+    for(auto& d : sent_data) {
+       byte_stuffer_recv_byte(1, d);
+    }
+}
+
+// Frames with long runs and scattered zeros, so that all block types are used
+static std::vector<std::vector<uint8_t>> make_frames(int count) {
+    std::vector<std::vector<uint8_t>> frames;
+    uint32_t seed = 1;
+    for (int i = 0; i < count; i++) {
+        seed = seed * 1103515245 + 12345;
+        std::vector<uint8_t> frame(1 + (seed >> 16) % 600);
+        for (auto& byte : frame) {
+            seed = seed * 1103515245 + 12345;
+            byte = (seed >> 16) % 64 == 0 ? 0 : (seed >> 24) | 1;
+        }
+        frames.push_back(frame);
+    }
+    return frames;
+}
+
+TEST_F(ByteStuffer, sends_a_frame_with_a_single_send) {
+    uint8_t data[] = {0, 1, 0, 0, 2, 3, 0};
+    byte_stuffer_send_frame(0, data, sizeof(data));
+    EXPECT_EQ(num_sends, 1);
+}
+
+TEST_F(ByteStuffer, encodes_into_the_given_buffer) {
+    uint8_t data[] = {1, 0, 2, 3};
+    uint8_t expected[] = {2, 1, 3, 2, 3, 0};
+    uint8_t out[BYTE_STUFFER_ENCODED_SIZE(sizeof(data))];
+    uint16_t size = byte_stuffer_encode(data, sizeof(data), out);
+    EXPECT_THAT(std::vector<uint8_t>(out, out + size), ElementsAreArray(expected));
+}
+
+TEST_F(ByteStuffer, encoded_size_fits_the_worst_case) {
+    std::vector<uint8_t> data(MAX_FRAME_SIZE, 0x55);
+    std::vector<uint8_t> out(BYTE_STUFFER_ENCODED_SIZE(MAX_FRAME_SIZE));
+    for (uint16_t size = 1; size <= MAX_FRAME_SIZE; size++) {
+        EXPECT_LE(byte_stuffer_encode(data.data(), size, out.data()), BYTE_STUFFER_ENCODED_SIZE(size));
+    }
+}
+
+TEST_F(ByteStuffer, receives_chunks_of_any_size) {
+    auto frames = make_frames(20);
+    for (auto& frame : frames) {
+        byte_stuffer_send_frame(0, frame.data(), frame.size());
+    }
+    auto& received = collect_frames();
+    for (uint16_t chunk = 1; chunk < 70; chunk++) {
+        received.clear();
+        for (size_t i = 0; i < sent_data.size(); i += chunk) {
+            uint16_t size = std::min<size_t>(chunk, sent_data.size() - i);
+            byte_stuffer_recv(1, sent_data.data() + i, size);
+        }
+        EXPECT_EQ(received, frames) << "chunk size " << chunk;
+    }
+}
+
+TEST_F(ByteStuffer, receives_the_same_frames_from_chunks_and_bytes_of_noise) {
+    auto frames = make_frames(20);
+    for (auto& frame : frames) {
+        byte_stuffer_send_frame(0, frame.data(), frame.size());
+    }
+    // Corrupt the stream here and there, including frames that are too long
+    uint32_t seed = 7;
+    for (auto& byte : sent_data) {
+        seed = seed * 1103515245 + 12345;
+        if ((seed >> 16) % 300 == 0) {
+            byte = seed >> 24;
+        }
+    }
+    std::vector<uint8_t> long_frame(MAX_FRAME_SIZE + 300, 0xFF);
+    sent_data.insert(sent_data.begin() + sent_data.size() / 2, long_frame.begin(), long_frame.end());
+
+    auto& received = collect_frames();
+    for (auto& byte : sent_data) {
+        byte_stuffer_recv_byte(0, byte);
+    }
+    auto expected = received;
+    EXPECT_FALSE(expected.empty());
+    for (uint16_t chunk : {1, 7, 64, 1000}) {
+        received.clear();
+        init_byte_stuffer();
+        for (size_t i = 0; i < sent_data.size(); i += chunk) {
+            uint16_t size = std::min<size_t>(chunk, sent_data.size() - i);
+            byte_stuffer_recv(0, sent_data.data() + i, size);
+        }
+        EXPECT_EQ(received, expected) << "chunk size " << chunk;
+    }
+}
+
+// Reports MB/s for sending, and for receiving a byte or a 64 byte chunk at a time
+TEST_F(ByteStuffer, throughput) {
+    auto frames = make_frames(200);
+    size_t bytes = 0;
+    for (auto& frame : frames) {
+        bytes += frame.size();
+    }
+    const int repeats = 20;
+    typedef std::chrono::steady_clock clock;
+
+    auto start = clock::now();
+    for (int i = 0; i < repeats; i++) {
+        sent_data.clear();
+        for (auto& frame : frames) {
+            byte_stuffer_send_frame(0, frame.data(), frame.size());
+        }
+    }
+    std::chrono::duration<double> send_time = clock::now() - start;
+
+    auto& received = collect_frames();
+    start = clock::now();
+    for (int i = 0; i < repeats; i++) {
+        for (auto& byte : sent_data) {
+            byte_stuffer_recv_byte(0, byte);
+        }
+    }
+    std::chrono::duration<double> byte_time = clock::now() - start;
+
+    start = clock::now();
+    for (int i = 0; i < repeats; i++) {
+        for (size_t j = 0; j < sent_data.size(); j += 64) {
+            uint16_t size = std::min<size_t>(64, sent_data.size() - j);
+            byte_stuffer_recv(0, sent_data.data() + j, size);
+        }
+    }
+    std::chrono::duration<double> chunk_time = clock::now() - start;
+
+    EXPECT_EQ(received.size(), frames.size() * repeats * 2);
+    double megabytes = bytes * repeats / 1e6;
+    std::cout << "[ THROUGHPUT ] send " << megabytes / send_time.count() << " MB/s"
+              << ", receive by byte " << megabytes / byte_time.count() << " MB/s"
+              << ", receive by chunk " << megabytes / chunk_time.count() << " MB/s"
+              << std::endl;
+}
@@ -0,0 +1,124 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "gtest/gtest.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+extern "C" {
+#include "serial_link/protocol/crc.h"
+}
+
+typedef uint32_t (*crc32_function)(const uint8_t* data, uint32_t size);
+
+struct crc32_implementation {
+    const char* name;
+    crc32_function function;
+};
+
+static const crc32_implementation crc32_implementations[] = {
+    {"bytewise", crc32_bytewise},
+    {"slice-by-4", crc32_slice_by_4},
+    {"slice-by-8", crc32_slice_by_8},
+};
+
+static std::vector<uint8_t> random_data(size_t size) {
+    std::vector<uint8_t> data(size);
+    uint32_t seed = 12345;
+    for (auto& byte : data) {
+        seed = seed * 1103515245 + 12345;
+        byte = seed >> 16;
+    }
+    return data;
+}
+
+static uint64_t read_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+TEST(Crc, crc32_gives_the_check_value) {
+    const uint8_t data[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    for (auto& crc : crc32_implementations) {
+        EXPECT_EQ(crc.function(data, sizeof(data)), 0xCBF43926) << crc.name;
+        EXPECT_EQ(crc.function(data, 0), 0) << crc.name;
+    }
+}
+
+TEST(Crc, crc16_gives_the_check_value) {
+    const uint8_t data[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    EXPECT_EQ(crc16_ccitt(data, sizeof(data)), 0x29B1);
+    EXPECT_EQ(crc16_ccitt(data, 0), 0xFFFF);
+}
+
+TEST(Crc, crc32_implementations_are_identical_for_all_sizes_and_alignments) {
+    std::vector<uint8_t> data = random_data(300);
+    for (uint32_t offset = 0; offset < 8; offset++) {
+        for (uint32_t size = 0; size + offset <= data.size(); size++) {
+            uint32_t expected = crc32_bytewise(data.data() + offset, size);
+            EXPECT_EQ(crc32_slice_by_4(data.data() + offset, size), expected);
+            EXPECT_EQ(crc32_slice_by_8(data.data() + offset, size), expected);
+        }
+    }
+}
+
+// Reports the cycles per byte for long buffers, and for frames of the size
+// serial_link sends
+TEST(Crc, benchmark) {
+    const unsigned repeats = 2000;
+    const uint32_t sizes[] = {4096, 16};
+    std::vector<uint8_t> data = random_data(4096);
+    volatile uint32_t sink = 0;
+    for (uint32_t size : sizes) {
+        for (auto& crc : crc32_implementations) {
+            uint64_t best = UINT64_MAX;
+            for (unsigned i = 0; i < repeats; i++) {
+                uint64_t start = read_cycles();
+                sink = sink + crc.function(data.data(), size);
+                best = std::min(best, read_cycles() - start);
+            }
+            std::cout << "[ CRC      ] " << std::setw(10) << crc.name << ", "
+                      << std::setw(4) << size << " bytes: "
+                      << std::setprecision(3) << (double)best / size << " cycles/byte" << std::endl;
+        }
+        uint64_t best = UINT64_MAX;
+        for (unsigned i = 0; i < repeats; i++) {
+            uint64_t start = read_cycles();
+            sink = sink + crc16_ccitt(data.data(), size);
+            best = std::min(best, read_cycles() - start);
+        }
+        std::cout << "[ CRC      ] " << std::setw(10) << "crc16" << ", "
+                  << std::setw(4) << size << " bytes: "
+                  << std::setprecision(3) << (double)best / size << " cycles/byte" << std::endl;
+    }
+}
@@ -80,6 +80,7 @@ public:
     }
 
     MOCK_METHOD3(transport_recv_frame, void (uint8_t from, uint8_t* data, uint16_t size));
+    MOCK_METHOD3(baud_negotiation_recv_frame, void (uint8_t link, uint8_t* data, uint16_t size));
 
     std::vector<uint8_t> received_data;
 
@@ -87,7 +88,7 @@ public:
         std::vector<uint8_t> send_buffers[2];
     };
 
-    router_buffer router_buffers[8];
+    router_buffer router_buffers[ROUTER_MAX_SLAVES + 1];
     router_buffer* current_router_buffer;
 
     static FrameRouter* Instance;
@@ -111,6 +112,10 @@ extern "C" {
     void transport_recv_frame(uint8_t from, uint8_t* data, uint16_t size) {
         FrameRouter::Instance->transport_recv_frame(from, data, size);
     }
+
+    void baud_negotiation_recv_frame(uint8_t link, uint8_t* data, uint16_t size) {
+        FrameRouter::Instance->baud_negotiation_recv_frame(link, data, size);
+    }
 }
 
 TEST_F(FrameRouter, master_broadcast_is_received_by_everyone) {
@@ -133,29 +138,73 @@ TEST_F(FrameRouter, master_broadcast_is_received_by_everyone) {
     EXPECT_EQ(router_buffers[2].send_buffers[UP_LINK].size(), 0);
 }
 
-TEST_F(FrameRouter, master_send_is_received_by_targets) {
+TEST_F(FrameRouter, master_send_is_received_by_target_only) {
     frame_buffer_t data;
     data.data = {0xAB, 0x70, 0x55, 0xBB};
     activate_router(0);
-    router_send_frame((1 << 1) | (1 << 2), (uint8_t*)&data, 4);
+    router_send_frame(ROUTER_SLAVE(1), (uint8_t*)&data, 4);
     EXPECT_GT(router_buffers[0].send_buffers[DOWN_LINK].size(), 0);
     EXPECT_EQ(router_buffers[0].send_buffers[UP_LINK].size(), 0);
 
+    EXPECT_CALL(*this, transport_recv_frame(_, _, _))
+        .Times(0);
     simulate_transport(0, 1);
     EXPECT_GT(router_buffers[1].send_buffers[DOWN_LINK].size(), 0);
     EXPECT_EQ(router_buffers[1].send_buffers[UP_LINK].size(), 0);
+    testing::Mock::VerifyAndClearExpectations(this);
 
     EXPECT_CALL(*this, transport_recv_frame(0, _, _))
         .With(Args<1, 2>(ElementsAreArray(data.data)));
     simulate_transport(1, 2);
-    EXPECT_GT(router_buffers[2].send_buffers[DOWN_LINK].size(), 0);
+    // Nobody further down is a target
+    EXPECT_EQ(router_buffers[2].send_buffers[DOWN_LINK].size(), 0);
     EXPECT_EQ(router_buffers[2].send_buffers[UP_LINK].size(), 0);
+}
+
+TEST_F(FrameRouter, master_send_reaches_a_slave_beyond_eight_hops) {
+    frame_buffer_t data;
+    data.data = {0xAB, 0x70, 0x55, 0xBB};
+    activate_router(0);
+    router_send_frame(ROUTER_SLAVE(11), (uint8_t*)&data, 4);
+
+    EXPECT_CALL(*this, transport_recv_frame(_, _, _))
+        .Times(0);
+    for (uint8_t i = 1; i < 12; i++) {
+        simulate_transport(i - 1, i);
+        EXPECT_GT(router_buffers[i].send_buffers[DOWN_LINK].size(), 0);
+    }
+    testing::Mock::VerifyAndClearExpectations(this);
 
     EXPECT_CALL(*this, transport_recv_frame(0, _, _))
         .With(Args<1, 2>(ElementsAreArray(data.data)));
-    simulate_transport(2, 3);
-    EXPECT_GT(router_buffers[3].send_buffers[DOWN_LINK].size(), 0);
-    EXPECT_EQ(router_buffers[3].send_buffers[UP_LINK].size(), 0);
+    simulate_transport(11, 12);
+    EXPECT_EQ(router_buffers[12].send_buffers[DOWN_LINK].size(), 0);
+}
+
+TEST_F(FrameRouter, slave_beyond_eight_hops_sends_to_master) {
+    frame_buffer_t data;
+    data.data = {0xAB, 0x70, 0x55, 0xBB};
+    activate_router(12);
+    router_send_frame(ROUTER_MASTER, (uint8_t*)&data, 4);
+    for (uint8_t i = 12; i > 1; i--) {
+        simulate_transport(i, i - 1);
+    }
+    EXPECT_CALL(*this, transport_recv_frame(12, _, _))
+        .With(Args<1, 2>(ElementsAreArray(data.data)));
+    simulate_transport(1, 0);
+}
+
+TEST_F(FrameRouter, master_broadcast_stops_after_the_most_slaves_there_can_be) {
+    frame_buffer_t data;
+    data.data = {0xAB, 0x70, 0x55, 0xBB};
+    activate_router(0);
+    router_send_frame(ROUTER_ALL_SLAVES, (uint8_t*)&data, 4);
+    EXPECT_CALL(*this, transport_recv_frame(0, _, _))
+        .Times(ROUTER_MAX_SLAVES);
+    for (uint8_t i = 1; i <= ROUTER_MAX_SLAVES; i++) {
+        simulate_transport(i - 1, i);
+    }
+    EXPECT_EQ(router_buffers[ROUTER_MAX_SLAVES].send_buffers[DOWN_LINK].size(), 0);
 }
 
 TEST_F(FrameRouter, first_link_sends_to_master) {
@@ -227,3 +276,49 @@ TEST_F(FrameRouter, master_receives_on_uplink_does_nothing) {
     EXPECT_EQ(router_buffers[0].send_buffers[UP_LINK].size(), 0);
     EXPECT_EQ(router_buffers[0].send_buffers[DOWN_LINK].size(), 0);
 }
+
+TEST_F(FrameRouter, link_frame_down_is_received_by_the_next_slave_only) {
+    frame_buffer_t data;
+    data.data = {0xAB, 0x70, 0x55, 0xBB};
+    activate_router(1);
+    router_send_link_frame(DOWN_LINK, (uint8_t*)&data, 4);
+    EXPECT_GT(router_buffers[1].send_buffers[DOWN_LINK].size(), 0);
+    EXPECT_EQ(router_buffers[1].send_buffers[UP_LINK].size(), 0);
+
+    EXPECT_CALL(*this, transport_recv_frame(_, _, _))
+        .Times(0);
+    EXPECT_CALL(*this, baud_negotiation_recv_frame(UP_LINK, _, _))
+        .With(Args<1, 2>(ElementsAreArray(data.data)));
+    simulate_transport(1, 2);
+    EXPECT_EQ(router_buffers[2].send_buffers[DOWN_LINK].size(), 0);
+    EXPECT_EQ(router_buffers[2].send_buffers[UP_LINK].size(), 0);
+}
+
+TEST_F(FrameRouter, link_frame_up_is_received_by_the_master) {
+    frame_buffer_t data;
+    data.data = {0xAB, 0x70, 0x55, 0xBB};
+    activate_router(1);
+    router_send_link_frame(UP_LINK, (uint8_t*)&data, 4);
+    EXPECT_GT(router_buffers[1].send_buffers[UP_LINK].size(), 0);
+
+    EXPECT_CALL(*this, transport_recv_frame(_, _, _))
+        .Times(0);
+    EXPECT_CALL(*this, baud_negotiation_recv_frame(DOWN_LINK, _, _))
+        .With(Args<1, 2>(ElementsAreArray(data.data)));
+    simulate_transport(1, 0);
+    EXPECT_EQ(router_buffers[0].send_buffers[DOWN_LINK].size(), 0);
+    EXPECT_EQ(router_buffers[0].send_buffers[UP_LINK].size(), 0);
+}
+
+TEST_F(FrameRouter, link_frame_up_is_not_forwarded_by_a_slave) {
+    frame_buffer_t data;
+    data.data = {0xAB, 0x70, 0x55, 0xBB};
+    activate_router(2);
+    router_send_link_frame(UP_LINK, (uint8_t*)&data, 4);
+
+    EXPECT_CALL(*this, baud_negotiation_recv_frame(DOWN_LINK, _, _))
+        .With(Args<1, 2>(ElementsAreArray(data.data)));
+    simulate_transport(2, 1);
+    EXPECT_EQ(router_buffers[1].send_buffers[DOWN_LINK].size(), 0);
+    EXPECT_EQ(router_buffers[1].send_buffers[UP_LINK].size(), 0);
+}
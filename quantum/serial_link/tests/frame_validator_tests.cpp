@@ -26,6 +26,7 @@ SOFTWARE.
 #include "gmock/gmock.h"
 extern "C" {
 #include "serial_link/protocol/frame_validator.h"
+#include "serial_link/protocol/link_stats.h"
 }
 
 using testing::_;
@@ -36,6 +37,7 @@ class FrameValidator : public testing::Test {
 public:
     FrameValidator() {
         Instance = this;
+        link_stats_reset();
     }
 
     ~FrameValidator() {
@@ -60,6 +62,7 @@ void byte_stuffer_send_frame(uint8_t link, uint8_t* data, uint16_t size) {
 }
 }
 
+#ifndef SERIAL_LINK_CRC16
 TEST_F(FrameValidator, doesnt_validate_frames_under_5_bytes) {
     EXPECT_CALL(*this, route_incoming_frame(_, _, _))
         .Times(0);
@@ -98,6 +101,18 @@ TEST_F(FrameValidator, validates_five_byte_frame_with_correct_crc) {
     validator_recv_frame(0, data, 9);
 }
 
+TEST_F(FrameValidator, counts_received_frames_and_crc_errors) {
+    uint8_t valid[] = {0x44, 0x04, 0x6A, 0xB3, 0xA3};
+    uint8_t invalid[] = {0x44, 0, 0, 0, 0};
+    EXPECT_CALL(*this, route_incoming_frame(_, _, _));
+    validator_recv_frame(1, valid, 5);
+    validator_recv_frame(1, invalid, 5);
+    validator_recv_frame(1, invalid, 2);
+    EXPECT_EQ(link_stats.links[1].frames_received, 1);
+    EXPECT_EQ(link_stats.links[1].crc_errors, 2);
+    EXPECT_EQ(link_stats.links[0].crc_errors, 0);
+}
+
 TEST_F(FrameValidator, sends_one_byte_with_correct_crc) {
     uint8_t original[] = {0x44, 0, 0, 0, 0};
     uint8_t expected[] = {0x44, 0x04, 0x6A, 0xB3, 0xA3};
@@ -113,3 +128,34 @@ TEST_F(FrameValidator, sends_five_bytes_with_correct_crc) {
         .With(Args<1, 2>(ElementsAreArray(expected)));
     validator_send_frame(0, original, 5);
 }
+#else
+TEST_F(FrameValidator, doesnt_validate_frames_under_3_bytes) {
+    EXPECT_CALL(*this, route_incoming_frame(_, _, _))
+        .Times(0);
+    uint8_t data[] = {1, 2};
+    validator_recv_frame(0, 0, 1);
+    validator_recv_frame(0, data, 2);
+}
+
+TEST_F(FrameValidator, validates_one_byte_frame_with_correct_crc) {
+    uint8_t data[] = {0x44, 0xB0, 0xE9};
+    EXPECT_CALL(*this, route_incoming_frame(_, _, _))
+        .With(Args<1, 2>(ElementsAreArray(data, 1)));
+    validator_recv_frame(0, data, 3);
+}
+
+TEST_F(FrameValidator, does_not_validate_one_byte_frame_with_incorrect_crc) {
+    uint8_t data[] = {0x44, 0xB0, 0xE8};
+    EXPECT_CALL(*this, route_incoming_frame(_, _, _))
+        .Times(0);
+    validator_recv_frame(1, data, 3);
+}
+
+TEST_F(FrameValidator, sends_five_bytes_with_correct_crc) {
+    uint8_t original[] = {1, 2, 3, 4, 5, 0, 0};
+    uint8_t expected[] = {1, 2, 3, 4, 5, 0x04, 0x93};
+    EXPECT_CALL(*this, byte_stuffer_send_frame(_, _, _))
+        .With(Args<1, 2>(ElementsAreArray(expected)));
+    validator_send_frame(0, original, 5);
+}
+#endif
@@ -0,0 +1,278 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "gtest/gtest.h"
+extern "C" {
+#include "serial_link/protocol/transport.h"
+#include "serial_link/protocol/byte_stuffer.h"
+#include "serial_link/protocol/frame_router.h"
+#include "serial_link/protocol/physical.h"
+#include "serial_link/system/physical_loopback.h"
+#include "serial_link/protocol/link_stats.h"
+}
+
+// The whole protocol stack, from the transport objects down to the physical
+// layer, with a slave and the master in the same process
+
+struct test_matrix {
+    uint32_t rows[8];
+};
+
+MASTER_TO_ALL_SLAVES_OBJECT(connected, uint8_t);
+SLAVE_TO_MASTER_DELTA_OBJECT(matrix, test_matrix);
+SLAVE_TO_MASTER_OBJECT_WITH_FLAGS(reliable_matrix, test_matrix, REMOTE_OBJECT_DELTA | REMOTE_OBJECT_RELIABLE);
+
+static remote_object_t* test_remote_objects[] = {
+    REMOTE_OBJECT(connected),
+    REMOTE_OBJECT(matrix),
+    REMOTE_OBJECT(reliable_matrix),
+};
+
+static uint16_t now = 0;
+
+extern "C" {
+void signal_data_written(void) {
+}
+
+uint16_t timer_read(void) {
+    return now;
+}
+}
+
+class Loopback : public testing::Test {
+public:
+    Loopback() {
+        add_remote_objects(test_remote_objects, sizeof(test_remote_objects) / sizeof(remote_object_t*));
+        init_byte_stuffer();
+        physical_init();
+        physical_start();
+        loopback_chunk_size = 0;
+        loopback_error_rate = 0;
+        link_stats_reset();
+    }
+
+    ~Loopback() {
+        reinitialize_serial_link_transport();
+    }
+
+    void send_from_slave(const test_matrix& m) {
+        router_set_master(false);
+        *begin_write_matrix() = m;
+        end_write_matrix();
+        update_transport();
+    }
+
+    bool receive_on_master() {
+        router_set_master(true);
+        return physical_receive();
+    }
+
+    // The wire loops back whatever a slave forwards, so each receive as a
+    // slave is one more hop of a chain. Returns how many hops got a frame.
+    int relay(int hops) {
+        router_set_master(false);
+        int received = 0;
+        for (int i = 0; i < hops; i++) {
+            received += physical_receive();
+        }
+        return received;
+    }
+};
+
+TEST_F(Loopback, receives_nothing_when_nothing_is_sent) {
+    EXPECT_FALSE(receive_on_master());
+}
+
+TEST_F(Loopback, slave_matrix_reaches_the_master) {
+    test_matrix m = {};
+    m.rows[3] = 0x1234;
+    send_from_slave(m);
+    EXPECT_TRUE(receive_on_master());
+    test_matrix* received = read_matrix(0);
+    ASSERT_NE(received, nullptr);
+    EXPECT_EQ(received->rows[3], 0x1234);
+}
+
+TEST_F(Loopback, master_object_reaches_the_slave) {
+    router_set_master(true);
+    *begin_write_connected() = 1;
+    end_write_connected();
+    update_transport();
+    router_set_master(false);
+    EXPECT_TRUE(physical_receive());
+    uint8_t* received = read_connected();
+    ASSERT_NE(received, nullptr);
+    EXPECT_EQ(*received, 1);
+}
+
+TEST_F(Loopback, matrix_deltas_arrive_in_any_chunk_size) {
+    for (uint16_t chunk : {1, 3, 7, 64, 0}) {
+        loopback_chunk_size = chunk;
+        test_matrix m = {};
+        for (int i = 0; i < 40; i++) {
+            m.rows[i % 8] = i * 0x01010101;
+            send_from_slave(m);
+            receive_on_master();
+            test_matrix* received = read_matrix(0);
+            ASSERT_NE(received, nullptr) << "chunk " << chunk << " update " << i;
+            EXPECT_EQ(memcmp(received, &m, sizeof(m)), 0) << "chunk " << chunk << " update " << i;
+        }
+    }
+}
+
+TEST_F(Loopback, several_frames_are_received_at_once) {
+    test_matrix m = {};
+    for (int i = 0; i < 5; i++) {
+        m.rows[i] = i + 1;
+        send_from_slave(m);
+    }
+    receive_on_master();
+    test_matrix* received = read_matrix(0);
+    ASSERT_NE(received, nullptr);
+    EXPECT_EQ(memcmp(received, &m, sizeof(m)), 0);
+    EXPECT_EQ(loopback_dropped, 0);
+}
+
+TEST_F(Loopback, counts_the_frames_on_each_link) {
+    test_matrix m = {};
+    for (int i = 0; i < 3; i++) {
+        m.rows[0] = i + 1;
+        send_from_slave(m);
+    }
+    receive_on_master();
+    EXPECT_EQ(link_stats.links[UP_LINK].frames_sent, 3);
+    EXPECT_EQ(link_stats.links[DOWN_LINK].frames_received, 3);
+    EXPECT_EQ(link_stats.links[DOWN_LINK].crc_errors, 0);
+    EXPECT_EQ(link_stats.links[DOWN_LINK].overruns, 0);
+}
+
+TEST_F(Loopback, counts_an_overrun_when_the_wire_is_full) {
+    test_matrix m = {};
+    // Every frame is at least a few bytes, so this is plenty to fill it
+    for (int i = 0; i < LOOPBACK_BUFFER_SIZE; i++) {
+        m.rows[i % 8] = i + 1;
+        m.rows[(i + 4) % 8] = ~i;
+        send_from_slave(m);
+    }
+    EXPECT_GT(loopback_dropped, 0);
+    EXPECT_GT(link_stats.links[DOWN_LINK].overruns, 0);
+    receive_on_master();
+    loopback_clear();
+}
+
+// Noise corrupts some of the frames and the answers to them, the retransmits
+// still get the last matrix to the master
+TEST_F(Loopback, reliable_matrix_survives_a_noisy_line) {
+    loopback_seed(42);
+    loopback_error_rate = 65536 / 1000;
+    auto exchange = [this]() {
+        receive_on_master();
+        router_set_master(false);
+        physical_receive();
+        now++;
+    };
+    test_matrix m = {};
+    for (int i = 0; i < 300; i++) {
+        m.rows[i % 8] = i * 0x01030507;
+        router_set_master(false);
+        *begin_write_reliable_matrix() = m;
+        end_write_reliable_matrix();
+        update_transport();
+        exchange();
+    }
+    for (int i = 0; i < 500; i++) {
+        router_set_master(false);
+        update_transport();
+        exchange();
+    }
+    test_matrix* received = nullptr;
+    while (test_matrix* r = read_reliable_matrix(0)) {
+        received = r;
+    }
+    ASSERT_NE(received, nullptr);
+    EXPECT_EQ(memcmp(received, &m, sizeof(m)), 0);
+    EXPECT_GT(link_stats.links[DOWN_LINK].crc_errors + link_stats.links[DOWN_LINK].cobs_resets, 0);
+    EXPECT_GT(link_stats.links[UP_LINK].retransmits, 0);
+}
+
+// The third slave of a chain sends, the master answers it at 0b100, so the
+// answer passes the first two slaves and stops at the third
+TEST_F(Loopback, answer_reaches_the_third_slave) {
+    test_matrix m = {};
+    m.rows[0] = 1;
+    router_set_master(false);
+    *begin_write_reliable_matrix() = m;
+    end_write_reliable_matrix();
+    update_transport();
+    EXPECT_EQ(relay(2), 2);
+    EXPECT_TRUE(receive_on_master());
+    test_matrix* received = read_reliable_matrix(2);
+    ASSERT_NE(received, nullptr);
+    EXPECT_EQ(received->rows[0], 1);
+    EXPECT_EQ(read_reliable_matrix(0), nullptr);
+    uint32_t received_before = link_stats.links[UP_LINK].frames_received;
+    EXPECT_EQ(relay(4), 3);
+    EXPECT_EQ(link_stats.links[UP_LINK].frames_received, received_before + 3);
+    now += 1000;
+    router_set_master(false);
+    update_transport();
+    EXPECT_EQ(link_stats.links[UP_LINK].retransmits, 0);
+}
+
+// Like above, but noise corrupts frames on every hop in both directions
+TEST_F(Loopback, reliable_matrix_survives_a_noisy_chain_of_three_slaves) {
+    loopback_seed(7);
+    loopback_error_rate = 65536 / 1000;
+    auto exchange = [this]() {
+        relay(2);
+        receive_on_master();
+        relay(3);
+        now++;
+    };
+    test_matrix m = {};
+    for (int i = 0; i < 300; i++) {
+        m.rows[i % 8] = i * 0x01030507;
+        router_set_master(false);
+        *begin_write_reliable_matrix() = m;
+        end_write_reliable_matrix();
+        update_transport();
+        exchange();
+    }
+    for (int i = 0; i < 500; i++) {
+        router_set_master(false);
+        update_transport();
+        exchange();
+    }
+    test_matrix* received = nullptr;
+    while (test_matrix* r = read_reliable_matrix(2)) {
+        received = r;
+    }
+    ASSERT_NE(received, nullptr);
+    EXPECT_EQ(memcmp(received, &m, sizeof(m)), 0);
+    EXPECT_EQ(read_reliable_matrix(0), nullptr);
+    EXPECT_EQ(read_reliable_matrix(1), nullptr);
+    EXPECT_GT(link_stats.links[DOWN_LINK].crc_errors + link_stats.links[DOWN_LINK].cobs_resets, 0);
+    EXPECT_GT(link_stats.links[UP_LINK].retransmits, 0);
+    EXPECT_EQ(link_stats.links[UP_LINK].lost_frames, 0);
+}
@@ -1,22 +1,64 @@
 serial_link_byte_stuffer_SRC :=\
 	$(SERIAL_PATH)/tests/byte_stuffer_tests.cpp \
-	$(SERIAL_PATH)/protocol/byte_stuffer.c
+	$(SERIAL_PATH)/protocol/byte_stuffer.c \
+	$(SERIAL_PATH)/protocol/link_stats.c
 
 serial_link_frame_validator_SRC := \
 	$(SERIAL_PATH)/tests/frame_validator_tests.cpp \
-	$(SERIAL_PATH)/protocol/frame_validator.c 
+	$(SERIAL_PATH)/protocol/frame_validator.c \
+	$(SERIAL_PATH)/protocol/crc.c \
+	$(SERIAL_PATH)/protocol/link_stats.c
+
+serial_link_frame_validator_slice4_DEFS := -DSERIAL_LINK_CRC32_SLICE=4
+serial_link_frame_validator_slice4_SRC := $(serial_link_frame_validator_SRC)
+
+serial_link_frame_validator_slice8_DEFS := -DSERIAL_LINK_CRC32_SLICE=8
+serial_link_frame_validator_slice8_SRC := $(serial_link_frame_validator_SRC)
+
+serial_link_frame_validator_crc16_DEFS := -DSERIAL_LINK_CRC16
+serial_link_frame_validator_crc16_SRC := $(serial_link_frame_validator_SRC)
+
+serial_link_crc_SRC := \
+	$(SERIAL_PATH)/tests/crc_tests.cpp \
+	$(SERIAL_PATH)/protocol/crc.c
 
 serial_link_frame_router_SRC := \
 	$(SERIAL_PATH)/tests/frame_router_tests.cpp \
 	$(SERIAL_PATH)/protocol/byte_stuffer.c \
 	$(SERIAL_PATH)/protocol/frame_validator.c \
+	$(SERIAL_PATH)/protocol/crc.c \
+	$(SERIAL_PATH)/protocol/link_stats.c \
 	$(SERIAL_PATH)/protocol/frame_router.c
 
+serial_link_triple_buffered_object_DEFS := -DSERIAL_LINK_STDATOMIC
 serial_link_triple_buffered_object_SRC := \
 	$(SERIAL_PATH)/tests/triple_buffered_object_tests.cpp \
-	$(SERIAL_PATH)/protocol/triple_buffered_object.c 
+	$(SERIAL_PATH)/protocol/triple_buffered_object.c \
+	$(SERIAL_PATH)/protocol/double_buffered_object.c
 
+serial_link_transport_DEFS := -DSERIAL_LINK_POOL_SIZE=2048 -DNUM_SLAVES=12
 serial_link_transport_SRC := \
 	$(SERIAL_PATH)/tests/transport_tests.cpp \
 	$(SERIAL_PATH)/protocol/transport.c \
-	$(SERIAL_PATH)/protocol/triple_buffered_object.c 
+	$(SERIAL_PATH)/protocol/triple_buffered_object.c \
+	$(SERIAL_PATH)/protocol/double_buffered_object.c \
+	$(SERIAL_PATH)/protocol/link_stats.c
+
+serial_link_loopback_DEFS := -DSERIAL_LINK_LOOPBACK
+serial_link_loopback_SRC := \
+	$(SERIAL_PATH)/tests/loopback_tests.cpp \
+	$(SERIAL_PATH)/protocol/byte_stuffer.c \
+	$(SERIAL_PATH)/protocol/crc.c \
+	$(SERIAL_PATH)/protocol/frame_validator.c \
+	$(SERIAL_PATH)/protocol/frame_router.c \
+	$(SERIAL_PATH)/protocol/transport.c \
+	$(SERIAL_PATH)/protocol/triple_buffered_object.c \
+	$(SERIAL_PATH)/protocol/double_buffered_object.c \
+	$(SERIAL_PATH)/protocol/link_stats.c \
+	$(SERIAL_PATH)/protocol/baud_negotiation.c \
+	$(SERIAL_PATH)/system/physical_loopback.c
+
+serial_link_baud_negotiation_DEFS := -DSERIAL_LINK_LOOPBACK
+serial_link_baud_negotiation_SRC := \
+	$(SERIAL_PATH)/tests/baud_negotiation_tests.cpp \
+	$(filter-out $(SERIAL_PATH)/tests/loopback_tests.cpp,$(serial_link_loopback_SRC))
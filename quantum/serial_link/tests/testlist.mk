@@ -1,6 +1,12 @@
 TEST_LIST +=\
 	serial_link_byte_stuffer\
 	serial_link_frame_validator\
+	serial_link_frame_validator_slice4\
+	serial_link_frame_validator_slice8\
+	serial_link_frame_validator_crc16\
+	serial_link_crc\
 	serial_link_frame_router\
 	serial_link_triple_buffered_object\
-	serial_link_transport
\ No newline at end of file
+	serial_link_transport\
+	serial_link_loopback\
+	serial_link_baud_negotiation
\ No newline at end of file
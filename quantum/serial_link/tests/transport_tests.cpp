@@ -28,10 +28,13 @@ SOFTWARE.
 using testing::_;
 using testing::ElementsAreArray;
 using testing::Args;
+using testing::AnyNumber;
 
 extern "C" {
 #include "serial_link/protocol/transport.h"
+#include "serial_link/protocol/link_stats.h"
 }
+#include <random>
 
 struct test_object1 {
     uint32_t test;
@@ -42,25 +45,41 @@ struct test_object2 {
     uint32_t test2;
 };
 
+struct test_matrix {
+    uint32_t rows[8];
+};
+
 MASTER_TO_ALL_SLAVES_OBJECT(master_to_slave, test_object1);
 MASTER_TO_SINGLE_SLAVE_OBJECT(master_to_single_slave, test_object1);
 SLAVE_TO_MASTER_OBJECT(slave_to_master, test_object1);
+SLAVE_TO_MASTER_DELTA_OBJECT(matrix, test_matrix);
+MASTER_TO_ALL_SLAVES_OBJECT_WITH_FLAGS(settings, test_object2, REMOTE_OBJECT_DOUBLE_BUFFERED);
+SLAVE_TO_MASTER_OBJECT_WITH_FLAGS(reliable_matrix, test_matrix, REMOTE_OBJECT_DELTA | REMOTE_OBJECT_RELIABLE);
+MASTER_TO_SINGLE_SLAVE_OBJECT_WITH_FLAGS(reliable_command, test_object1, REMOTE_OBJECT_RELIABLE);
 
 static remote_object_t* test_remote_objects[] = {
     REMOTE_OBJECT(master_to_slave),
     REMOTE_OBJECT(master_to_single_slave),
     REMOTE_OBJECT(slave_to_master),
+    REMOTE_OBJECT(matrix),
+    REMOTE_OBJECT(settings),
+    REMOTE_OBJECT(reliable_matrix),
+    REMOTE_OBJECT(reliable_command),
 };
 
 class Transport : public testing::Test {
 public:
     Transport() {
         Instance = this;
+        link_stats_reset();
         add_remote_objects(test_remote_objects, sizeof(test_remote_objects) / sizeof(remote_object_t*));
     }
 
     ~Transport() {
         Instance = nullptr;
+        for (remote_object_t* obj : test_remote_objects) {
+            transport_set_schedule(obj, REMOTE_OBJECT_PRIORITY_LOW, 0);
+        }
         reinitialize_serial_link_transport();
     }
 
@@ -70,10 +89,34 @@ public:
     void router_send_frame(uint8_t destination, uint8_t* data, uint16_t size) {
         router_send_frame(destination);
         std::copy(data, data + size, std::back_inserter(sent_data));
+        frames.push_back({destination, std::vector<uint8_t>(data, data + size)});
+    }
+
+    // Writes the matrix with one row changed, and returns the frame sent for it
+    std::vector<uint8_t> send_matrix(int row, uint32_t value) {
+        matrix.rows[row] = value;
+        *begin_write_matrix() = matrix;
+        end_write_matrix();
+        sent_data.clear();
+        update_transport();
+        return sent_data;
+    }
+
+    void recv_matrix(std::vector<uint8_t> frame) {
+        transport_recv_frame(1, frame.data(), frame.size());
     }
 
     static Transport* Instance;
 
+    test_matrix matrix = {};
+
+    uint16_t now = 0;
+
+    bool is_master = false;
+
+    // Every frame sent, with the destination
+    std::vector<std::pair<uint8_t, std::vector<uint8_t>>> frames;
+
     std::vector<uint8_t> sent_data;
 };
 
@@ -87,6 +130,14 @@ void signal_data_written(void) {
 void router_send_frame(uint8_t destination, uint8_t* data, uint16_t size) {
     Transport::Instance->router_send_frame(destination, data, size);
 }
+
+bool router_is_master(void) {
+    return Transport::Instance->is_master;
+}
+
+uint16_t timer_read(void) {
+    return Transport::Instance ? Transport::Instance->now : 0;
+}
 }
 
 TEST_F(Transport, write_to_local_signals_an_event) {
@@ -186,3 +237,437 @@ TEST_F(Transport, ignores_object_with_size_too_big) {
     test_object1* obj2 = read_master_to_slave();
     EXPECT_EQ(obj2, nullptr);
 }
+
+TEST_F(Transport, last_slave_can_send) {
+    update_transport();
+    begin_write_slave_to_master()->test = 9;
+    EXPECT_CALL(*this, signal_data_written());
+    end_write_slave_to_master();
+    EXPECT_CALL(*this, router_send_frame(0));
+    update_transport();
+    transport_recv_frame(NUM_SLAVES, sent_data.data(), sent_data.size());
+    test_object1* obj = read_slave_to_master(NUM_SLAVES - 1);
+    EXPECT_NE(obj, nullptr);
+    EXPECT_EQ(obj->test, 9);
+}
+
+TEST_F(Transport, pool_use_grows_with_the_slaves_present) {
+    EXPECT_EQ(transport_get_pool_used(), 0);
+    EXPECT_EQ(read_slave_to_master(3), nullptr);
+    EXPECT_EQ(transport_get_pool_used(), 0);
+    EXPECT_CALL(*this, signal_data_written()).Times(AnyNumber());
+    EXPECT_CALL(*this, router_send_frame(0)).Times(AnyNumber());
+    begin_write_slave_to_master()->test = 1;
+    end_write_slave_to_master();
+    update_transport();
+    transport_recv_frame(1, sent_data.data(), sent_data.size());
+    uint16_t one_slave = transport_get_pool_used();
+    EXPECT_GT(one_slave, 0);
+    transport_recv_frame(1, sent_data.data(), sent_data.size());
+    EXPECT_EQ(transport_get_pool_used(), one_slave);
+    transport_recv_frame(5, sent_data.data(), sent_data.size());
+    EXPECT_EQ(transport_get_pool_used(), 2 * one_slave);
+    EXPECT_NE(read_slave_to_master(4), nullptr);
+    EXPECT_EQ(read_slave_to_master(1), nullptr);
+}
+
+TEST_F(Transport, block_size_macros_match_the_pool_use) {
+    EXPECT_CALL(*this, signal_data_written()).Times(AnyNumber());
+    begin_write_master_to_single_slave(0);
+    end_write_master_to_single_slave(0);
+    EXPECT_EQ(transport_get_pool_used(),
+        MASTER_TO_SINGLE_SLAVE_BLOCK_SIZE(test_object1, 0) +
+        SLAVE_TO_MASTER_BLOCK_SIZE(test_object1, 0) +
+        SLAVE_TO_MASTER_BLOCK_SIZE(test_matrix, REMOTE_OBJECT_DELTA) +
+        SLAVE_TO_MASTER_BLOCK_SIZE(test_matrix, REMOTE_OBJECT_DELTA | REMOTE_OBJECT_RELIABLE) +
+        MASTER_TO_SINGLE_SLAVE_BLOCK_SIZE(test_object1, REMOTE_OBJECT_RELIABLE));
+}
+
+TEST_F(Transport, single_slave_writes_fail_when_the_pool_is_full) {
+    EXPECT_CALL(*this, signal_data_written()).Times(AnyNumber());
+    EXPECT_CALL(*this, router_send_frame(_)).Times(AnyNumber());
+    uint8_t slave = 0;
+    while (slave < NUM_SLAVES && begin_write_master_to_single_slave(slave)) {
+        end_write_master_to_single_slave(slave);
+        slave++;
+    }
+    ASSERT_LT(slave, NUM_SLAVES);
+    EXPECT_GT(slave, 0);
+    EXPECT_LE(transport_get_pool_used(), SERIAL_LINK_POOL_SIZE);
+    EXPECT_EQ(link_stats.pool_exhausted, 1);
+    EXPECT_EQ(begin_write_master_to_single_slave(NUM_SLAVES), nullptr);
+    EXPECT_EQ(link_stats.pool_exhausted, 1);
+    // a frame from a slave without a block is dropped
+    std::vector<uint8_t> frame(sizeof(test_object1) + 1, 0);
+    frame.back() = remote_object_slave_to_master.object.id;
+    transport_recv_frame(slave + 1, frame.data(), frame.size());
+    EXPECT_EQ(link_stats.pool_exhausted, 2);
+    EXPECT_EQ(read_slave_to_master(slave), nullptr);
+    update_transport();
+    EXPECT_EQ(sent_data.size(), slave * (sizeof(test_object1) + 1));
+}
+
+TEST_F(Transport, double_buffered_object_keeps_the_latest_write) {
+    EXPECT_CALL(*this, signal_data_written()).Times(2);
+    test_object2* obj = begin_write_settings();
+    obj->test1 = 1;
+    end_write_settings();
+    obj = begin_write_settings();
+    obj->test1 = 2;
+    obj->test2 = 3;
+    end_write_settings();
+    EXPECT_CALL(*this, router_send_frame(0xFF));
+    update_transport();
+    EXPECT_EQ(sent_data.size(), sizeof(test_object2) + 1);
+    transport_recv_frame(0, sent_data.data(), sent_data.size());
+    test_object2* obj2 = read_settings();
+    EXPECT_NE(obj2, nullptr);
+    EXPECT_EQ(obj2->test1, 2);
+    EXPECT_EQ(obj2->test2, 3);
+    EXPECT_EQ(read_settings(), nullptr);
+}
+
+TEST_F(Transport, sends_nothing_when_nothing_is_written) {
+    EXPECT_CALL(*this, router_send_frame(_)).Times(0);
+    EXPECT_EQ(update_transport(), 0);
+}
+
+TEST_F(Transport, sends_higher_priority_objects_first) {
+    testing::InSequence seq;
+    transport_set_schedule(REMOTE_OBJECT(slave_to_master), REMOTE_OBJECT_PRIORITY_HIGH, 0);
+    EXPECT_CALL(*this, signal_data_written()).Times(2);
+    begin_write_master_to_slave()->test = 1;
+    end_write_master_to_slave();
+    begin_write_slave_to_master()->test = 2;
+    end_write_slave_to_master();
+    EXPECT_CALL(*this, router_send_frame(0));
+    EXPECT_CALL(*this, router_send_frame(0xFF));
+    update_transport();
+}
+
+TEST_F(Transport, object_written_while_sending_goes_before_lower_priority_ones) {
+    transport_set_schedule(REMOTE_OBJECT(slave_to_master), REMOTE_OBJECT_PRIORITY_HIGH, 0);
+    EXPECT_CALL(*this, signal_data_written()).Times(AnyNumber());
+    begin_write_master_to_slave()->test = 1;
+    end_write_master_to_slave();
+    begin_write_settings()->test1 = 1;
+    end_write_settings();
+    testing::InSequence seq;
+    // The link is busy with the first low priority frame when a key is pressed
+    EXPECT_CALL(*this, router_send_frame(0xFF)).WillOnce(testing::InvokeWithoutArgs([]() {
+        begin_write_slave_to_master()->test = 2;
+        end_write_slave_to_master();
+    }));
+    EXPECT_CALL(*this, router_send_frame(0));
+    EXPECT_CALL(*this, router_send_frame(0xFF));
+    update_transport();
+}
+
+TEST_F(Transport, rate_limited_object_sends_the_latest_write_when_the_interval_ends) {
+    transport_set_schedule(REMOTE_OBJECT(master_to_slave), REMOTE_OBJECT_PRIORITY_LOW, 10);
+    EXPECT_CALL(*this, signal_data_written()).Times(AnyNumber());
+    begin_write_master_to_slave()->test = 1;
+    end_write_master_to_slave();
+    EXPECT_CALL(*this, router_send_frame(0xFF)).Times(1);
+    EXPECT_EQ(update_transport(), 0);
+    now = 4;
+    begin_write_master_to_slave()->test = 2;
+    end_write_master_to_slave();
+    begin_write_master_to_slave()->test = 3;
+    end_write_master_to_slave();
+    EXPECT_EQ(update_transport(), 6);
+    testing::Mock::VerifyAndClearExpectations(this);
+    now = 10;
+    sent_data.clear();
+    EXPECT_CALL(*this, router_send_frame(0xFF)).Times(1);
+    EXPECT_EQ(update_transport(), 0);
+    transport_recv_frame(0, sent_data.data(), sent_data.size());
+    test_object1* obj = read_master_to_slave();
+    ASSERT_NE(obj, nullptr);
+    EXPECT_EQ(obj->test, 3);
+}
+
+class DeltaTransport : public Transport {
+public:
+    DeltaTransport() {
+        EXPECT_CALL(*this, signal_data_written()).Times(AnyNumber());
+        EXPECT_CALL(*this, router_send_frame(0)).Times(AnyNumber());
+    }
+};
+
+TEST_F(DeltaTransport, first_frame_is_a_keyframe) {
+    std::vector<uint8_t> frame = send_matrix(2, 0x12345678);
+    EXPECT_EQ(frame.size(), sizeof(test_matrix) + 2);
+    recv_matrix(frame);
+    test_matrix* received = read_matrix(0);
+    EXPECT_NE(received, nullptr);
+    EXPECT_EQ(received->rows[2], 0x12345678);
+}
+
+TEST_F(DeltaTransport, sends_only_the_changed_row) {
+    recv_matrix(send_matrix(0, 1));
+    read_matrix(0);
+    std::vector<uint8_t> frame = send_matrix(5, 0xAABB);
+    // one run of the two changed bytes, the sequence and the id
+    EXPECT_EQ(frame.size(), 2 + 2 + 2);
+    recv_matrix(frame);
+    test_matrix* received = read_matrix(0);
+    EXPECT_NE(received, nullptr);
+    EXPECT_EQ(received->rows[0], 1);
+    EXPECT_EQ(received->rows[5], 0xAABB);
+}
+
+TEST_F(DeltaTransport, unchanged_matrix_sends_an_empty_delta) {
+    recv_matrix(send_matrix(0, 1));
+    std::vector<uint8_t> frame = send_matrix(0, 1);
+    EXPECT_EQ(frame.size(), 2);
+    recv_matrix(frame);
+    test_matrix* received = read_matrix(0);
+    EXPECT_NE(received, nullptr);
+    EXPECT_EQ(received->rows[0], 1);
+}
+
+TEST_F(DeltaTransport, recovers_from_a_lost_delta_on_the_next_keyframe) {
+    recv_matrix(send_matrix(0, 1));
+    read_matrix(0);
+    send_matrix(1, 2);
+    std::vector<uint8_t> frame;
+    for (int i = 2; i < DELTA_KEYFRAME_INTERVAL; i++) {
+        frame = send_matrix(3, i);
+        EXPECT_LT(frame.size(), sizeof(test_matrix) + 2);
+        recv_matrix(frame);
+        EXPECT_EQ(read_matrix(0), nullptr);
+    }
+    frame = send_matrix(4, 4);
+    EXPECT_EQ(frame.size(), sizeof(test_matrix) + 2);
+    recv_matrix(frame);
+    test_matrix* received = read_matrix(0);
+    EXPECT_NE(received, nullptr);
+    EXPECT_EQ(received->rows[0], 1);
+    EXPECT_EQ(received->rows[1], 2);
+    EXPECT_EQ(received->rows[3], DELTA_KEYFRAME_INTERVAL - 1);
+    EXPECT_EQ(received->rows[4], 4);
+    recv_matrix(send_matrix(5, 5));
+    received = read_matrix(0);
+    EXPECT_NE(received, nullptr);
+    EXPECT_EQ(received->rows[5], 5);
+}
+
+TEST_F(DeltaTransport, ignores_delta_writing_outside_the_object) {
+    recv_matrix(send_matrix(0, 1));
+    read_matrix(0);
+    std::vector<uint8_t> frame = send_matrix(7, 0xFF000000);
+    // the run ends exactly at the end of the object, move it one byte past
+    frame[0]++;
+    recv_matrix(frame);
+    EXPECT_EQ(read_matrix(0), nullptr);
+}
+
+TEST_F(DeltaTransport, keeps_slaves_apart) {
+    std::vector<uint8_t> frame = send_matrix(0, 1);
+    transport_recv_frame(1, frame.data(), frame.size());
+    frame = send_matrix(0, 2);
+    transport_recv_frame(2, frame.data(), frame.size());
+    EXPECT_EQ(read_matrix(1), nullptr);
+    test_matrix* received = read_matrix(0);
+    EXPECT_NE(received, nullptr);
+    EXPECT_EQ(received->rows[0], 1);
+}
+
+class ReliableTransport : public Transport {
+public:
+    ReliableTransport() {
+        EXPECT_CALL(*this, signal_data_written()).Times(AnyNumber());
+        EXPECT_CALL(*this, router_send_frame(_)).Times(AnyNumber());
+    }
+
+    // Sends the matrix from the slave, and returns the frames sent
+    std::vector<std::pair<uint8_t, std::vector<uint8_t>>> send_matrix(int row, uint32_t value) {
+        matrix.rows[row] = value;
+        is_master = false;
+        *begin_write_reliable_matrix() = matrix;
+        end_write_reliable_matrix();
+        return update();
+    }
+
+    std::vector<std::pair<uint8_t, std::vector<uint8_t>>> update() {
+        frames.clear();
+        update_transport();
+        return frames;
+    }
+
+    // Delivers the frame the slave sent to the master, and returns the answer
+    std::vector<uint8_t> recv_on_master(std::vector<uint8_t> frame) {
+        is_master = true;
+        frames.clear();
+        transport_recv_frame(1, frame.data(), frame.size());
+        is_master = false;
+        return frames.size() == 1 ? frames[0].second : std::vector<uint8_t>();
+    }
+
+    std::vector<std::pair<uint8_t, std::vector<uint8_t>>> recv_on_slave(std::vector<uint8_t> frame) {
+        is_master = false;
+        frames.clear();
+        transport_recv_frame(0, frame.data(), frame.size());
+        return frames;
+    }
+};
+
+static const uint8_t reliable_matrix_id = 5;
+
+TEST_F(ReliableTransport, receiver_acknowledges_the_frame) {
+    auto sent = send_matrix(0, 1);
+    ASSERT_EQ(sent.size(), 1);
+    EXPECT_EQ(sent[0].first, 0);
+    std::vector<uint8_t> answer = recv_on_master(sent[0].second);
+    EXPECT_EQ(frames[0].first, 1);
+    uint8_t ack[] = {reliable_matrix_id, 1, 0, 0x7F};
+    EXPECT_THAT(answer, ElementsAreArray(ack));
+    EXPECT_EQ(recv_on_slave(answer).size(), 0);
+    now += 1000;
+    EXPECT_EQ(update().size(), 0);
+    EXPECT_EQ(link_stats.links[0].retransmits, 0);
+}
+
+TEST_F(ReliableTransport, answers_each_slave_at_its_own_address) {
+    auto sent = send_matrix(0, 1)[0].second;
+    for (uint8_t from = 1; from <= NUM_SLAVES; from++) {
+        is_master = true;
+        frames.clear();
+        transport_recv_frame(from, sent.data(), sent.size());
+        ASSERT_EQ(frames.size(), 1);
+        // the hops to the slave, the same as the hops the frame came up
+        EXPECT_EQ(frames[0].first, from);
+    }
+}
+
+TEST_F(ReliableTransport, gives_up_after_the_retries) {
+    send_matrix(0, 1);
+    int retransmits = 0;
+    for (int i = 0; i < 10000; i++) {
+        now++;
+        retransmits += update().size();
+    }
+    EXPECT_EQ(retransmits, SERIAL_LINK_MAX_RETRIES);
+    EXPECT_EQ(link_stats.links[0].retransmits, SERIAL_LINK_MAX_RETRIES);
+    EXPECT_EQ(link_stats.links[0].lost_frames, 1);
+    // the next write is sent and retried as usual
+    EXPECT_EQ(send_matrix(0, 2).size(), 1);
+    now += SERIAL_LINK_RETRANSMIT_MS;
+    EXPECT_EQ(update().size(), 1);
+}
+
+TEST_F(ReliableTransport, unacknowledged_frame_is_sent_again_with_backoff) {
+    send_matrix(0, 1);
+    now += SERIAL_LINK_RETRANSMIT_MS - 1;
+    EXPECT_EQ(update().size(), 0);
+    now += 1;
+    auto sent = update();
+    ASSERT_EQ(sent.size(), 1);
+    EXPECT_EQ(sent[0].second.size(), sizeof(test_matrix) + 2);
+    EXPECT_EQ(link_stats.links[0].retransmits, 1);
+    // Twice the time before the next try
+    now += SERIAL_LINK_RETRANSMIT_MS;
+    EXPECT_EQ(update().size(), 0);
+    now += SERIAL_LINK_RETRANSMIT_MS;
+    EXPECT_EQ(update().size(), 1);
+    std::vector<uint8_t> answer = recv_on_master(sent[0].second);
+    recv_on_slave(answer);
+    now += 1000;
+    EXPECT_EQ(update().size(), 0);
+    test_matrix* received = read_reliable_matrix(0);
+    ASSERT_NE(received, nullptr);
+    EXPECT_EQ(received->rows[0], 1);
+}
+
+TEST_F(ReliableTransport, lost_delta_is_recovered_right_away) {
+    recv_on_slave(recv_on_master(send_matrix(0, 1)[0].second));
+    read_reliable_matrix(0);
+    send_matrix(1, 2);
+    auto delta = send_matrix(2, 3)[0].second;
+    ASSERT_LT(delta.size(), sizeof(test_matrix));
+    std::vector<uint8_t> nack = recv_on_master(delta);
+    uint8_t expected_nack[] = {reliable_matrix_id, 3, 1, 0x7F};
+    EXPECT_THAT(nack, ElementsAreArray(expected_nack));
+    // The next delta can't be applied either, but only the first answer gets
+    // a keyframe
+    std::vector<uint8_t> nack2 = recv_on_master(send_matrix(3, 4)[0].second);
+    auto keyframe = recv_on_slave(nack);
+    ASSERT_EQ(keyframe.size(), 1);
+    EXPECT_EQ(keyframe[0].second.size(), sizeof(test_matrix) + 2);
+    EXPECT_EQ(recv_on_slave(nack2).size(), 0);
+    std::vector<uint8_t> ack = recv_on_master(keyframe[0].second);
+    EXPECT_EQ(ack[2], 0);
+    test_matrix* received = read_reliable_matrix(0);
+    ASSERT_NE(received, nullptr);
+    EXPECT_EQ(memcmp(received, &matrix, sizeof(matrix)), 0);
+}
+
+TEST_F(ReliableTransport, single_slave_object_is_acknowledged_by_the_slave) {
+    is_master = true;
+    begin_write_reliable_command(2)->test = 5;
+    end_write_reliable_command(2);
+    auto sent = update();
+    ASSERT_EQ(sent.size(), 1);
+    EXPECT_EQ(sent[0].first, 3);
+    EXPECT_EQ(sent[0].second.size(), sizeof(test_object1) + 2);
+    auto answer = recv_on_slave(sent[0].second);
+    ASSERT_EQ(answer.size(), 1);
+    EXPECT_EQ(answer[0].first, 0);
+    test_object1* received = read_reliable_command();
+    ASSERT_NE(received, nullptr);
+    EXPECT_EQ(received->test, 5);
+    is_master = true;
+    transport_recv_frame(3, answer[0].second.data(), answer[0].second.size());
+    now += 1000;
+    EXPECT_EQ(update().size(), 0);
+}
+
+// Drops frames at random in both directions, the master still ends up with the
+// last matrix the slave sent
+TEST_F(ReliableTransport, lossy_link_delivers_the_last_matrix) {
+    std::mt19937 random(1234);
+    std::bernoulli_distribution lost(0.25);
+    std::vector<std::vector<uint8_t>> to_master;
+    std::vector<std::vector<uint8_t>> to_slave;
+    auto deliver = [&]() {
+        for (auto& frame : to_master) {
+            if (!lost(random)) {
+                std::vector<uint8_t> answer = recv_on_master(frame);
+                if (!answer.empty()) {
+                    to_slave.push_back(answer);
+                }
+            }
+        }
+        to_master.clear();
+        for (auto& frame : to_slave) {
+            if (!lost(random)) {
+                for (auto& sent : recv_on_slave(frame)) {
+                    to_master.push_back(sent.second);
+                }
+            }
+        }
+        to_slave.clear();
+    };
+    for (int i = 0; i < 500; i++) {
+        for (auto& sent : send_matrix(random() % 8, random())) {
+            to_master.push_back(sent.second);
+        }
+        deliver();
+        now++;
+    }
+    for (int i = 0; i < 1000; i++) {
+        for (auto& sent : update()) {
+            to_master.push_back(sent.second);
+        }
+        deliver();
+        now++;
+    }
+    test_matrix* received = nullptr;
+    while (test_matrix* r = read_reliable_matrix(0)) {
+        received = r;
+    }
+    ASSERT_NE(received, nullptr);
+    EXPECT_EQ(memcmp(received, &matrix, sizeof(matrix)), 0);
+    EXPECT_GT(link_stats.links[0].retransmits, 0);
+}
@@ -23,8 +23,11 @@ SOFTWARE.
 */
 
 #include "gtest/gtest.h"
+#include <atomic>
+#include <thread>
 extern "C" {
 #include "serial_link/protocol/triple_buffered_object.h"
+#include "serial_link/protocol/double_buffered_object.h"
 }
 
 struct test_object{
@@ -82,3 +85,175 @@ TEST_F(TripleBufferedObject, performs_two_writes_in_the_middle_of_read) {
     EXPECT_EQ(*triple_buffer_read(&test_object), 3);
     EXPECT_EQ(triple_buffer_read(&test_object), nullptr);
 }
+
+struct stress_payload {
+    uint32_t sequence;
+    uint32_t data[31];
+};
+
+struct stress_object {
+    uint8_t state;
+    stress_payload buffer[3];
+};
+
+static stress_object stress_object;
+
+// The writer keeps publishing while the reader checks that every object it
+// gets is complete, and newer than the previous one
+TEST_F(TripleBufferedObject, concurrent_reads_are_never_torn) {
+    const uint32_t num_writes = 200000;
+    triple_buffer_init((triple_buffer_object_t*)&stress_object);
+    std::atomic<bool> done(false);
+    std::thread writer([&]() {
+        for (uint32_t i = 1; i <= num_writes; i++) {
+            stress_payload* p = triple_buffer_begin_write(&stress_object);
+            p->sequence = i;
+            for (uint32_t j = 0; j < 31; j++) {
+                p->data[j] = i * 2654435761u + j;
+            }
+            triple_buffer_end_write(&stress_object);
+            if (i % 64 == 0) {
+                std::this_thread::yield();
+            }
+        }
+        done = true;
+    });
+    uint32_t last = 0;
+    uint32_t reads = 0;
+    uint32_t torn = 0;
+    uint32_t out_of_order = 0;
+    for (;;) {
+        bool finished = done;
+        stress_payload* p = triple_buffer_read(&stress_object);
+        if (p) {
+            reads++;
+            uint32_t sequence = p->sequence;
+            for (uint32_t j = 0; j < 31; j++) {
+                if (p->data[j] != sequence * 2654435761u + j) {
+                    torn++;
+                    break;
+                }
+            }
+            if (sequence <= last) {
+                out_of_order++;
+            }
+            last = sequence;
+        }
+        else if (finished) {
+            break;
+        }
+        else {
+            // Let the writer run when there's only one core
+            std::this_thread::yield();
+        }
+    }
+    writer.join();
+    EXPECT_EQ(torn, 0);
+    EXPECT_EQ(out_of_order, 0);
+    EXPECT_EQ(last, num_writes);
+    EXPECT_GT(reads, 1);
+}
+
+struct double_test_object {
+    uint8_t state;
+    uint32_t buffer[2];
+};
+
+static double_test_object double_test_object;
+
+class DoubleBufferedObject : public testing::Test {
+public:
+    DoubleBufferedObject() {
+        double_buffer_init((double_buffer_object_t*)&double_test_object);
+    }
+};
+
+TEST_F(DoubleBufferedObject, writes_and_reads_object) {
+    *double_buffer_begin_write(&double_test_object) = 0x3456ABCC;
+    double_buffer_end_write(&double_test_object);
+    EXPECT_EQ(*double_buffer_read(&double_test_object), 0x3456ABCC);
+    EXPECT_EQ(double_buffer_read(&double_test_object), nullptr);
+}
+
+TEST_F(DoubleBufferedObject, does_not_read_empty) {
+    EXPECT_EQ(double_buffer_read(&double_test_object), nullptr);
+}
+
+TEST_F(DoubleBufferedObject, does_not_read_while_writing_over_unread_data) {
+    *double_buffer_begin_write(&double_test_object) = 1;
+    double_buffer_end_write(&double_test_object);
+    *double_buffer_begin_write(&double_test_object) = 2;
+    EXPECT_EQ(double_buffer_read(&double_test_object), nullptr);
+    double_buffer_end_write(&double_test_object);
+    EXPECT_EQ(*double_buffer_read(&double_test_object), 2);
+}
+
+TEST_F(DoubleBufferedObject, performs_two_writes_in_the_middle_of_read) {
+    *double_buffer_begin_write(&double_test_object) = 1;
+    double_buffer_end_write(&double_test_object);
+    uint32_t* read = double_buffer_read(&double_test_object);
+    *double_buffer_begin_write(&double_test_object) = 2;
+    double_buffer_end_write(&double_test_object);
+    *double_buffer_begin_write(&double_test_object) = 3;
+    double_buffer_end_write(&double_test_object);
+    EXPECT_EQ(*read, 1);
+    EXPECT_EQ(*double_buffer_read(&double_test_object), 3);
+    EXPECT_EQ(double_buffer_read(&double_test_object), nullptr);
+}
+
+struct double_stress_object {
+    uint8_t state;
+    stress_payload buffer[2];
+};
+
+static double_stress_object double_stress_object;
+
+TEST_F(DoubleBufferedObject, concurrent_reads_are_never_torn) {
+    const uint32_t num_writes = 200000;
+    double_buffer_init((double_buffer_object_t*)&double_stress_object);
+    std::atomic<bool> done(false);
+    std::thread writer([&]() {
+        for (uint32_t i = 1; i <= num_writes; i++) {
+            stress_payload* p = double_buffer_begin_write(&double_stress_object);
+            p->sequence = i;
+            for (uint32_t j = 0; j < 31; j++) {
+                p->data[j] = i * 2654435761u + j;
+            }
+            double_buffer_end_write(&double_stress_object);
+            if (i % 64 == 0) {
+                std::this_thread::yield();
+            }
+        }
+        done = true;
+    });
+    uint32_t last = 0;
+    uint32_t torn = 0;
+    uint32_t out_of_order = 0;
+    for (;;) {
+        bool finished = done;
+        stress_payload* p = double_buffer_read(&double_stress_object);
+        if (p) {
+            uint32_t sequence = p->sequence;
+            for (uint32_t j = 0; j < 31; j++) {
+                if (p->data[j] != sequence * 2654435761u + j) {
+                    torn++;
+                    break;
+                }
+            }
+            if (sequence <= last) {
+                out_of_order++;
+            }
+            last = sequence;
+        }
+        else if (finished) {
+            break;
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+    writer.join();
+    EXPECT_EQ(torn, 0);
+    EXPECT_EQ(out_of_order, 0);
+    EXPECT_EQ(last, num_writes);
+}
@@ -0,0 +1,20 @@
+#include <stdint.h>
+#include "i2c.h"
+#include "twi.h"
+
+#ifdef USE_I2C
+
+// The registers of the slave, see I2C_SLAVE_ROWS. Both sides use the TWI
+// driver in tmk_core.
+volatile uint8_t i2c_slave_buffer[SLAVE_BUFFER_SIZE];
+
+void i2c_master_init(void) {
+  twi_init();
+}
+
+// address is the 8-bit address, the way SLAVE_I2C_ADDRESS is given
+void i2c_slave_init(uint8_t address) {
+  twi_slave_init(address >> 1, i2c_slave_buffer, SLAVE_BUFFER_SIZE);
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef I2C_H
+#define I2C_H
+
+#include <stdint.h>
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#ifndef SLAVE_I2C_ADDRESS
+#define SLAVE_I2C_ADDRESS           0x32
+#endif
+
+#define SLAVE_BUFFER_SIZE 0x20
+
+// Where the master reads the rows of the slave, one byte each, followed by
+// the version of the master data the slave has, and writes its
+// split_master_data_t, which has to fit in the 16 bytes after it
+#define I2C_SLAVE_ROWS 0x00
+#define I2C_SLAVE_MASTER_DATA 0x10
+
+extern volatile uint8_t i2c_slave_buffer[SLAVE_BUFFER_SIZE];
+
+void i2c_master_init(void);
+void i2c_slave_init(uint8_t address);
+
+#endif
@@ -12,7 +12,7 @@
 #include <stdbool.h>
 #include "serial.h"
 
-#ifdef USE_SERIAL
+#if defined(USE_SERIAL) && !defined(USE_SERIAL_USART)
 
 // Serial pulse period in microseconds. Its probably a bad idea to lower this
 // value.
@@ -24,6 +24,9 @@ uint8_t volatile serial_master_buffer[SERIAL_MASTER_BUFFER_LENGTH] = {0};
 #define SLAVE_DATA_CORRUPT (1<<0)
 volatile uint8_t status = 0;
 
+// The slave takes the data of the master from here once the checksum is good
+static uint8_t received[SERIAL_MASTER_BUFFER_LENGTH];
+
 inline static
 void serial_delay(void) {
   _delay_us(SERIAL_DELAY);
@@ -139,11 +142,16 @@ ISR(SERIAL_PIN_INTERRUPT) {
   // read the middle of pulses
   _delay_us(SERIAL_DELAY/2);
 
-  uint8_t checksum_computed = 0;
-  for (int i = 0; i < SERIAL_MASTER_BUFFER_LENGTH; ++i) {
-    serial_master_buffer[i] = serial_read_byte();
+  uint8_t size = serial_read_byte();
+  sync_send();
+  if (size > SERIAL_MASTER_BUFFER_LENGTH) {
+    size = SERIAL_MASTER_BUFFER_LENGTH;
+  }
+  uint8_t checksum_computed = size;
+  for (int i = 0; i < size; ++i) {
+    received[i] = serial_read_byte();
     sync_send();
-    checksum_computed += serial_master_buffer[i];
+    checksum_computed += received[i];
   }
   uint8_t checksum_received = serial_read_byte();
   sync_send();
@@ -154,6 +162,12 @@ ISR(SERIAL_PIN_INTERRUPT) {
     status |= SLAVE_DATA_CORRUPT;
   } else {
     status &= ~SLAVE_DATA_CORRUPT;
+    // only complete data, the master sends all of it or nothing
+    if (size == SERIAL_MASTER_BUFFER_LENGTH) {
+      for (int i = 0; i < size; ++i) {
+        serial_master_buffer[i] = received[i];
+      }
+    }
   }
 }
 
@@ -162,13 +176,13 @@ bool serial_slave_DATA_CORRUPT(void) {
   return status & SLAVE_DATA_CORRUPT;
 }
 
-// Copies the serial_slave_buffer to the master and sends the
-// serial_master_buffer to the slave.
+// Copies the serial_slave_buffer to the master and sends the first
+// master_size bytes of the serial_master_buffer to the slave.
 //
 // Returns:
 // 0 => no error
 // 1 => slave did not respond
-int serial_update_buffers(void) {
+int serial_update_buffers(uint8_t master_size) {
   // this code is very time dependent, so we need to disable interrupts
   cli();
 
@@ -207,9 +221,11 @@ int serial_update_buffers(void) {
     return 1;
   }
 
-  uint8_t checksum = 0;
-  // send data to the slave
-  for (int i = 0; i < SERIAL_MASTER_BUFFER_LENGTH; ++i) {
+  // send data to the slave, after its size
+  serial_write_byte(master_size);
+  sync_recv();
+  uint8_t checksum = master_size;
+  for (int i = 0; i < master_size; ++i) {
     serial_write_byte(serial_master_buffer[i]);
     sync_recv();
     checksum += serial_master_buffer[i];
@@ -3,16 +3,21 @@
 
 #include "config.h"
 #include <stdbool.h>
+#include "split/split.h"
 
 /* TODO:  some defines for interrupt setup */
+#ifndef SERIAL_PIN_DDR
 #define SERIAL_PIN_DDR DDRD
 #define SERIAL_PIN_PORT PORTD
 #define SERIAL_PIN_INPUT PIND
 #define SERIAL_PIN_MASK _BV(PD0)
 #define SERIAL_PIN_INTERRUPT INT0_vect
+#endif
 
-#define SERIAL_SLAVE_BUFFER_LENGTH MATRIX_ROWS/2
-#define SERIAL_MASTER_BUFFER_LENGTH 1
+// The rows of the slave, one byte each, and the version of the master data
+// it has
+#define SERIAL_SLAVE_BUFFER_LENGTH (SPLIT_ROWS_PER_HAND + 1)
+#define SERIAL_MASTER_BUFFER_LENGTH sizeof(split_master_data_t)
 
 // Buffers for master - slave communication
 extern volatile uint8_t serial_slave_buffer[SERIAL_SLAVE_BUFFER_LENGTH];
@@ -20,7 +25,9 @@ extern volatile uint8_t serial_master_buffer[SERIAL_MASTER_BUFFER_LENGTH];
 
 void serial_master_init(void);
 void serial_slave_init(void);
-int serial_update_buffers(void);
+// The master only sends the first master_size bytes of its buffer, the
+// slave only takes a frame with all of them
+int serial_update_buffers(uint8_t master_size);
 bool serial_slave_data_corrupt(void);
 
 #endif
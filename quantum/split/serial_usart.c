@@ -0,0 +1,279 @@
+/*
+ * Serial link over the hardware USART1, half-duplex on a single wire.
+ *
+ * RXI (PD2) and TXO (PD3) are both connected to the data line of the cable,
+ * TXO through a 1kΩ resistor. The transmitter is only enabled while a side
+ * is sending, the rest of the time TXO is an input with the pull-up on, so
+ * the other side can drive the line. PD0, the pin the bit-banged serial uses,
+ * is left floating, so it can stay connected to the line too.
+ *
+ * Frames are the buffer followed by its checksum, with 9 data bits. The
+ * frames of the master start with the number of bytes of its buffer they
+ * carry, which is all of them or none. The
+ * ninth bit marks the first byte of a frame, so a receiver that lost a byte
+ * finds the start of the next frame again.
+ *
+ * The master starts a transaction from serial_update_buffers by sending its
+ * buffer. The slave answers with its own buffer from the receive interrupt.
+ * Everything else happens in the interrupts, so serial_update_buffers never
+ * waits, it returns the result of the last finished transaction, and starts
+ * the next one.
+ */
+
+#ifndef F_CPU
+#define F_CPU 16000000
+#endif
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/delay.h>
+#include <stdbool.h>
+#include "serial.h"
+#include "timer.h"
+
+#if defined(USE_SERIAL) && defined(USE_SERIAL_USART)
+
+#ifndef SERIAL_USART_BAUD
+#define SERIAL_USART_BAUD 500000
+#endif
+
+// The master gives up on the slave after this long
+#ifndef SERIAL_USART_TIMEOUT_MS
+#define SERIAL_USART_TIMEOUT_MS 2
+#endif
+
+// The time the slave gives the master to release the line before answering
+#ifndef SERIAL_USART_TURNAROUND_US
+#define SERIAL_USART_TURNAROUND_US 10
+#endif
+
+// Double speed mode
+#define SERIAL_USART_UBRR ((F_CPU / (8UL * SERIAL_USART_BAUD)) - 1)
+
+#define MASTER_FRAME_SIZE (SERIAL_MASTER_BUFFER_LENGTH + 2)
+#define SLAVE_FRAME_SIZE (SERIAL_SLAVE_BUFFER_LENGTH + 1)
+#define MAX_FRAME_SIZE (MASTER_FRAME_SIZE > SLAVE_FRAME_SIZE ? MASTER_FRAME_SIZE : SLAVE_FRAME_SIZE)
+
+// Waiting for the start of a frame
+#define RX_NO_FRAME 0xFF
+
+uint8_t volatile serial_slave_buffer[SERIAL_SLAVE_BUFFER_LENGTH] = {0};
+uint8_t volatile serial_master_buffer[SERIAL_MASTER_BUFFER_LENGTH] = {0};
+
+enum {
+  STATE_IDLE,
+  STATE_SENDING,
+  STATE_RECEIVING,
+  // The master has the answer, serial_update_buffers checks it
+  STATE_DONE,
+};
+
+static bool is_master;
+static volatile uint8_t state = STATE_IDLE;
+
+static uint8_t tx_frame[MAX_FRAME_SIZE];
+static uint8_t tx_size;
+static volatile uint8_t tx_pos;
+
+static uint8_t rx_frame[MAX_FRAME_SIZE];
+static uint8_t rx_size;
+static volatile uint8_t rx_pos = RX_NO_FRAME;
+
+static uint16_t transaction_start;
+static bool last_transaction_ok = false;
+
+#define SLAVE_DATA_CORRUPT (1<<0)
+static volatile uint8_t status = 0;
+
+static uint8_t build_frame(uint8_t* frame, volatile uint8_t* buffer, uint8_t size) {
+  uint8_t checksum = 0;
+  for (uint8_t i = 0; i < size; ++i) {
+    frame[i] = buffer[i];
+    checksum += frame[i];
+  }
+  frame[size] = checksum;
+  return size + 1;
+}
+
+// The size, the first master_size bytes of the buffer and the checksum
+static uint8_t build_master_frame(uint8_t master_size) {
+  tx_frame[0] = master_size;
+  uint8_t size = build_frame(tx_frame + 1, serial_master_buffer, master_size);
+  tx_frame[size] += master_size;
+  return size + 1;
+}
+
+static bool frame_is_valid(uint8_t* frame, uint8_t size) {
+  uint8_t checksum = 0;
+  for (uint8_t i = 0; i < size - 1; ++i) {
+    checksum += frame[i];
+  }
+  return checksum == frame[size - 1];
+}
+
+// Stops driving the line and listens to it. Called with interrupts off.
+static void release_line(void) {
+  UCSR1B &= ~(_BV(TXEN1) | _BV(UDRIE1) | _BV(TXCIE1));
+  DDRD &= ~_BV(PD3);
+  PORTD |= _BV(PD3);
+  rx_pos = RX_NO_FRAME;
+  UCSR1B |= _BV(RXEN1) | _BV(RXCIE1);
+}
+
+// Sends tx_frame, the data register empty interrupt does the rest. Called
+// with interrupts off.
+static void start_sending(void) {
+  // Don't receive our own bytes
+  UCSR1B &= ~(_BV(RXEN1) | _BV(RXCIE1));
+  UCSR1B |= _BV(TXEN1);
+  tx_pos = 0;
+  // Cleared by writing a one
+  UCSR1A |= _BV(TXC1);
+  UCSR1B |= _BV(UDRIE1);
+}
+
+static void usart_init(void) {
+  UBRR1 = SERIAL_USART_UBRR;
+  UCSR1A = _BV(U2X1);
+  // 9 data bits, no parity, 1 stop bit
+  UCSR1C = _BV(UCSZ11) | _BV(UCSZ10);
+  UCSR1B = _BV(UCSZ12);
+
+  DDRD &= ~(_BV(PD0) | _BV(PD2));
+  PORTD &= ~_BV(PD0);
+  PORTD |= _BV(PD2);
+
+  uint8_t sreg = SREG;
+  cli();
+  state = STATE_IDLE;
+  release_line();
+  SREG = sreg;
+}
+
+void serial_master_init(void) {
+  is_master = true;
+  rx_size = SLAVE_FRAME_SIZE;
+  usart_init();
+}
+
+void serial_slave_init(void) {
+  is_master = false;
+  rx_size = MASTER_FRAME_SIZE;
+  usart_init();
+}
+
+ISR(USART1_UDRE_vect) {
+  if (tx_pos == 0) {
+    UCSR1B |= _BV(TXB81);
+  } else {
+    UCSR1B &= ~_BV(TXB81);
+  }
+  UDR1 = tx_frame[tx_pos++];
+  if (tx_pos == tx_size) {
+    // Wait for the last byte to leave before releasing the line
+    UCSR1B &= ~_BV(UDRIE1);
+    UCSR1B |= _BV(TXCIE1);
+  }
+}
+
+ISR(USART1_TX_vect) {
+  release_line();
+  if (is_master) {
+    state = STATE_RECEIVING;
+  }
+}
+
+static void slave_frame_received(void) {
+  if (frame_is_valid(rx_frame, rx_size)) {
+    // Only complete data, the master sends all of it or nothing
+    if (rx_frame[0] == SERIAL_MASTER_BUFFER_LENGTH) {
+      for (uint8_t i = 0; i < SERIAL_MASTER_BUFFER_LENGTH; ++i) {
+        serial_master_buffer[i] = rx_frame[i + 1];
+      }
+    }
+    status &= ~SLAVE_DATA_CORRUPT;
+  } else {
+    status |= SLAVE_DATA_CORRUPT;
+  }
+
+  // Answer even when the frame was corrupt, the master checks our checksum
+  _delay_us(SERIAL_USART_TURNAROUND_US);
+  tx_size = build_frame(tx_frame, serial_slave_buffer, SERIAL_SLAVE_BUFFER_LENGTH);
+  start_sending();
+}
+
+ISR(USART1_RX_vect) {
+  // The status and the ninth bit have to be read before the data
+  uint8_t error = UCSR1A & (_BV(FE1) | _BV(DOR1) | _BV(UPE1));
+  bool first = UCSR1B & _BV(RXB81);
+  uint8_t data = UDR1;
+
+  if (error) {
+    rx_pos = RX_NO_FRAME;
+    return;
+  }
+  if (first) {
+    rx_pos = 0;
+    if (!is_master) {
+      // The first byte of the master is the size of its data
+      rx_size = 2 + (data < SERIAL_MASTER_BUFFER_LENGTH ? data : SERIAL_MASTER_BUFFER_LENGTH);
+    }
+  }
+  if (rx_pos >= rx_size) {
+    return;
+  }
+  rx_frame[rx_pos++] = data;
+  if (rx_pos == rx_size) {
+    rx_pos = RX_NO_FRAME;
+    if (is_master) {
+      if (state == STATE_RECEIVING) {
+        state = STATE_DONE;
+      }
+    } else {
+      slave_frame_received();
+    }
+  }
+}
+
+bool serial_slave_data_corrupt(void) {
+  return status & SLAVE_DATA_CORRUPT;
+}
+
+// Copies the serial_slave_buffer to the master and sends the first
+// master_size bytes of the serial_master_buffer to the slave, without waiting
+// for it.
+//
+// Returns the result of the last finished transaction:
+// 0 => no error
+// 1 => slave did not respond, or the answer was corrupt
+int serial_update_buffers(uint8_t master_size) {
+  uint8_t current = state;
+
+  if (current == STATE_SENDING || current == STATE_RECEIVING) {
+    if (timer_elapsed(transaction_start) < SERIAL_USART_TIMEOUT_MS) {
+      return last_transaction_ok ? 0 : 1;
+    }
+    // The slave is not there, start over
+    last_transaction_ok = false;
+  } else if (current == STATE_DONE) {
+    last_transaction_ok = frame_is_valid(rx_frame, SLAVE_FRAME_SIZE);
+    if (last_transaction_ok) {
+      for (uint8_t i = 0; i < SERIAL_SLAVE_BUFFER_LENGTH; ++i) {
+        serial_slave_buffer[i] = rx_frame[i];
+      }
+    }
+  }
+
+  uint8_t sreg = SREG;
+  cli();
+  release_line();
+  tx_size = build_master_frame(master_size);
+  transaction_start = timer_read();
+  state = STATE_SENDING;
+  start_sending();
+  SREG = sreg;
+
+  return last_transaction_ok ? 0 : 1;
+}
+
+#endif
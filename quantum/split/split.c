@@ -0,0 +1,186 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include "split.h"
+#include "action_layer.h"
+#include "host.h"
+#include "led.h"
+#ifdef RGBLIGHT_ENABLE
+#include "rgblight.h"
+#endif
+#ifdef BACKLIGHT_ENABLE
+#include "backlight.h"
+#endif
+
+static const split_transport_t *transport;
+static bool is_master;
+static bool is_left;
+static uint8_t error_count;
+static split_master_data_t master_data;
+// The version of master_data the slave has, once it reported one
+static bool slave_version_known;
+static uint8_t slave_version;
+static matrix_row_t remote_rows[SPLIT_ROWS_PER_HAND];
+
+__attribute__ ((weak))
+void split_transfer_kb(bool ok) {
+    split_transfer_user(ok);
+}
+
+__attribute__ ((weak))
+void split_transfer_user(bool ok) {
+}
+
+__attribute__ ((weak))
+void split_master_data_kb(const split_master_data_t *data) {
+    split_master_data_user(data);
+}
+
+__attribute__ ((weak))
+void split_master_data_user(const split_master_data_t *data) {
+}
+
+void split_init(const split_transport_t *_transport, bool _is_master, bool _is_left) {
+    transport = _transport;
+    is_master = _is_master;
+    is_left = _is_left;
+    error_count = 0;
+    slave_version_known = false;
+    slave_version = 0;
+    memset(&master_data, 0, sizeof(master_data));
+    if (is_master) {
+        transport->master_init();
+    } else {
+        transport->slave_init();
+    }
+}
+
+bool is_keyboard_master(void) {
+    return is_master;
+}
+
+bool is_keyboard_left(void) {
+    return is_left;
+}
+
+uint8_t split_local_offset(void) {
+    return is_left ? 0 : SPLIT_ROWS_PER_HAND;
+}
+
+uint8_t split_remote_offset(void) {
+    return is_left ? SPLIT_ROWS_PER_HAND : 0;
+}
+
+void split_master_start(void) {
+    split_master_data_t data;
+    // also clears the padding, the whole struct is compared below
+    memset(&data, 0, sizeof(data));
+#ifndef NO_ACTION_LAYER
+    data.layer_state = layer_state;
+#endif
+    data.host_leds = host_keyboard_leds();
+#ifdef RGBLIGHT_ENABLE
+    data.rgblight = rgblight_config.raw;
+#else
+    data.rgblight = 0;
+#endif
+#ifdef BACKLIGHT_ENABLE
+    data.backlight = backlight_config.raw;
+#else
+    data.backlight = 0;
+#endif
+    data.version = master_data.version;
+
+    if (memcmp(&data, &master_data, sizeof(data)) != 0) {
+        master_data = data;
+        if (++master_data.version == 0) {
+            master_data.version = 1;
+        }
+    }
+    bool send = slave_version_known && slave_version != master_data.version;
+    transport->master_start(send ? &master_data : NULL);
+}
+
+bool split_master_finish(matrix_row_t matrix[]) {
+    uint8_t offset = split_remote_offset();
+    uint8_t version;
+    bool ok = transport->master_finish(remote_rows, &version);
+
+    if (ok) {
+        if (!slave_version_known) {
+            // The slave may still have a version from before the master was
+            // reset, continue after it
+            slave_version_known = true;
+            master_data.version = version;
+            if (++master_data.version == 0) {
+                master_data.version = 1;
+            }
+        }
+        slave_version = version;
+        error_count = 0;
+        for (uint8_t i = 0; i < SPLIT_ROWS_PER_HAND; i++) {
+            matrix[offset + i] = remote_rows[i];
+        }
+    } else if (error_count <= SPLIT_ERROR_DISCONNECT_COUNT) {
+        error_count++;
+        if (error_count > SPLIT_ERROR_DISCONNECT_COUNT) {
+            // the other half is gone, release its keys
+            for (uint8_t i = 0; i < SPLIT_ROWS_PER_HAND; i++) {
+                matrix[offset + i] = 0;
+            }
+            slave_version_known = false;
+        }
+    }
+
+    split_transfer_kb(ok);
+    return ok;
+}
+
+void split_slave_update(const matrix_row_t matrix[]) {
+    split_master_data_t data;
+    transport->slave_transfer(&matrix[split_local_offset()], master_data.version, &data);
+
+    if (data.version == master_data.version) {
+        return;
+    }
+    split_master_data_t old = master_data;
+    master_data = data;
+    // the LEDs still show the settings of the slave itself
+    bool first = old.version == 0;
+
+#ifndef NO_ACTION_LAYER
+    layer_state = master_data.layer_state;
+#endif
+    if (first || master_data.host_leds != old.host_leds) {
+        led_set(master_data.host_leds);
+    }
+#ifdef RGBLIGHT_ENABLE
+    if (first || master_data.rgblight != old.rgblight) {
+        rgblight_update_dword_noeeprom(master_data.rgblight);
+    }
+#endif
+#ifdef BACKLIGHT_ENABLE
+    if (first || master_data.backlight != old.backlight) {
+        backlight_config.raw = master_data.backlight;
+        backlight_set(backlight_config.enable ? backlight_config.level : 0);
+    }
+#endif
+    split_master_data_kb(&master_data);
+}
+
+const split_master_data_t *split_get_master_data(void) {
+    return &master_data;
+}
@@ -0,0 +1,122 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPLIT_H
+#define SPLIT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "matrix.h"
+
+/*
+ * Split keyboards, where each half has its own controller.
+ *
+ * The half with USB is the master. It scans its own rows and gets the rows
+ * of the other half, the slave, over a transport, once per matrix scan.
+ *
+ * The slave also gets the state of the master that its LEDs and displays
+ * show, so it can render them itself. The state is versioned, the master
+ * bumps the version when something changes and sends the state along until
+ * the slave reports having that version. Most transfers only carry the rows
+ * and the version.
+ *
+ * The left half has the first MATRIX_ROWS/2 rows of the matrix, the right
+ * half the rest. Each half debounces its own rows.
+ *
+ * quantum/split/matrix.c is a matrix for halves wired to pins, keyboards with
+ * a custom matrix call split_master_start/split_master_finish around their
+ * own scan instead.
+ */
+
+#define SPLIT_ROWS_PER_HAND (MATRIX_ROWS / 2)
+
+/* Failed transfers in a row before the keys of the other half are released */
+#ifndef SPLIT_ERROR_DISCONNECT_COUNT
+#define SPLIT_ERROR_DISCONNECT_COUNT 5
+#endif
+
+/* What the master sends to the slave */
+typedef struct {
+    uint32_t layer_state;
+    uint8_t host_leds;
+    /* rgblight_config_t, with RGBLIGHT_ENABLE */
+    uint32_t rgblight;
+    /* backlight_config_t, with BACKLIGHT_ENABLE */
+    uint8_t backlight;
+    /* Last, so a slave that reads the state while it is being written
+     * doesn't take the fields before the new version is in. 0 is the version
+     * of a slave that has nothing yet.
+     */
+    uint8_t version;
+} __attribute__((packed)) split_master_data_t;
+
+/* The link between the halves.
+ *
+ * master_start and master_finish are called around the scan of the local
+ * half, so a transport that works in the background overlaps the two.
+ * master_start gets NULL for data when the slave has it already.
+ * master_finish returns false when the transfer failed, rows and version
+ * are left alone then. version is the one the slave reported.
+ *
+ * slave_transfer gives the transport the rows and the version for the next
+ * transfer, and copies the last complete data the master sent to data.
+ */
+typedef struct {
+    void (*master_init)(void);
+    void (*slave_init)(void);
+    void (*master_start)(const split_master_data_t *data);
+    bool (*master_finish)(matrix_row_t rows[], uint8_t *version);
+    void (*slave_transfer)(const matrix_row_t rows[], uint8_t version, split_master_data_t *data);
+} split_transport_t;
+
+/* The transport selected in config.h, see quantum/split/transport.c */
+extern const split_transport_t split_transport;
+
+void split_init(const split_transport_t *transport, bool is_master, bool is_left);
+
+bool is_keyboard_master(void);
+bool is_keyboard_left(void);
+
+/* The first row of this half in the matrix */
+uint8_t split_local_offset(void);
+/* The first row of the other half in the matrix */
+uint8_t split_remote_offset(void);
+
+/* On the master, starts the transfer with the slave */
+void split_master_start(void);
+/* On the master, finishes the transfer and copies the rows of the slave to
+ * matrix. Returns false if the transfer failed.
+ */
+bool split_master_finish(matrix_row_t matrix[]);
+
+/* On the slave, hands the rows of this half, the ones at
+ * split_local_offset() in matrix, to the master.
+ */
+void split_slave_update(const matrix_row_t matrix[]);
+
+/* The state of the master, on the slave the last one received */
+const split_master_data_t *split_get_master_data(void);
+
+/* Called on the master after each transfer */
+void split_transfer_kb(bool ok);
+void split_transfer_user(bool ok);
+
+/* Called on the slave when the state of the master changes. The layer
+ * state, led_set, rgblight and the backlight are already updated then.
+ */
+void split_master_data_kb(const split_master_data_t *data);
+void split_master_data_user(const split_master_data_t *data);
+
+#endif
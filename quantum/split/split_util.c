@@ -5,46 +5,26 @@
 #include <util/delay.h>
 #include <avr/eeprom.h>
 #include "split_util.h"
+#include "split.h"
 #include "matrix.h"
 #include "keyboard.h"
 #include "config.h"
-
-#ifdef USE_I2C
-#  include "i2c.h"
-#else
-#  include "serial.h"
+#ifdef RGBLIGHT_ENABLE
+#include "rgblight.h"
 #endif
 
-volatile bool isLeftHand = true;
-
-static void setup_handedness(void) {
+static bool is_left_hand(void) {
   #ifdef EE_HANDS
-    isLeftHand = eeprom_read_byte(EECONFIG_HANDEDNESS);
+    return eeprom_read_byte(EECONFIG_HANDEDNESS);
   #else
     #ifdef I2C_MASTER_RIGHT
-      isLeftHand = !has_usb();
+      return !has_usb();
     #else
-      isLeftHand = has_usb();
+      return has_usb();
     #endif
   #endif
 }
 
-static void keyboard_master_setup(void) {
-#ifdef USE_I2C
-    i2c_master_init();
-#else
-    serial_master_init();
-#endif
-}
-
-static void keyboard_slave_setup(void) {
-#ifdef USE_I2C
-    i2c_slave_init(SLAVE_I2C_ADDRESS);
-#else
-    serial_slave_init();
-#endif
-}
-
 bool has_usb(void) {
    USBCON |= (1 << OTGPADE); //enables VBUS pad
    _delay_us(5);
@@ -52,18 +32,16 @@ bool has_usb(void) {
 }
 
 void split_keyboard_setup(void) {
-   setup_handedness();
-
-   if (has_usb()) {
-      keyboard_master_setup();
-   } else {
-      keyboard_slave_setup();
-   }
+   split_init(&split_transport, has_usb(), is_left_hand());
    sei();
 }
 
 void keyboard_slave_loop(void) {
    matrix_init();
+#ifdef RGBLIGHT_ENABLE
+   // the master sends its settings, until then the ones in the eeprom
+   rgblight_init();
+#endif
 
    while (1) {
       matrix_slave_scan();
@@ -74,7 +52,7 @@ void keyboard_slave_loop(void) {
 void matrix_setup(void) {
     split_keyboard_setup();
 
-    if (!has_usb()) {
+    if (!is_keyboard_master()) {
         keyboard_slave_loop();
     }
 }
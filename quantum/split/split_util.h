@@ -8,10 +8,6 @@
 	#define EECONFIG_HANDEDNESS         EECONFIG_BOOTMAGIC_END
 #endif
 
-#define SLAVE_I2C_ADDRESS           0x32
-
-extern volatile bool isLeftHand;
-
 // slave version of matix scan, defined in matrix.c
 void matrix_slave_scan(void);
 
@@ -0,0 +1,8 @@
+split_DEFS := \
+	-DMATRIX_ROWS=8 \
+	-DMATRIX_COLS=6 \
+	-DBACKLIGHT_ENABLE
+
+split_SRC := \
+	$(QUANTUM_PATH)/split/tests/split_tests.cpp \
+	$(QUANTUM_PATH)/split/split.c
@@ -0,0 +1,374 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+#include <vector>
+
+extern "C" {
+#include "split/split.h"
+#include "backlight.h"
+
+uint32_t layer_state;
+static uint8_t host_leds;
+static std::vector<uint8_t> leds_set;
+
+uint8_t host_keyboard_leds(void) {
+    return host_leds;
+}
+
+void led_set(uint8_t usb_led) {
+    leds_set.push_back(usb_led);
+}
+
+backlight_config_t backlight_config;
+static std::vector<uint8_t> backlight_levels;
+
+void backlight_set(uint8_t level) {
+    backlight_levels.push_back(level);
+}
+}
+
+// The other end of the fake transport
+static bool transfer_ok;
+static matrix_row_t slave_rows[SPLIT_ROWS_PER_HAND];
+static uint8_t slave_version;
+// The data of each transfer, empty when none was sent
+static std::vector<split_master_data_t> sent;
+static split_master_data_t received;
+static matrix_row_t handed_rows[SPLIT_ROWS_PER_HAND];
+static uint8_t handed_version;
+static int master_inits;
+static int slave_inits;
+static std::vector<bool> transfers;
+static std::vector<split_master_data_t> data_changes;
+
+static void fake_master_init(void) {
+    master_inits++;
+}
+
+static void fake_slave_init(void) {
+    slave_inits++;
+}
+
+static void fake_master_start(const split_master_data_t *data) {
+    if (data) {
+        sent.push_back(*data);
+    }
+}
+
+static bool fake_master_finish(matrix_row_t rows[], uint8_t *version) {
+    if (!transfer_ok) {
+        return false;
+    }
+    std::copy(slave_rows, slave_rows + SPLIT_ROWS_PER_HAND, rows);
+    *version = slave_version;
+    return true;
+}
+
+static void fake_slave_transfer(const matrix_row_t rows[], uint8_t version, split_master_data_t *data) {
+    std::copy(rows, rows + SPLIT_ROWS_PER_HAND, handed_rows);
+    handed_version = version;
+    *data = received;
+}
+
+static const split_transport_t fake_transport = {
+    fake_master_init,
+    fake_slave_init,
+    fake_master_start,
+    fake_master_finish,
+    fake_slave_transfer
+};
+
+extern "C" {
+void split_transfer_user(bool ok) {
+    transfers.push_back(ok);
+}
+
+void split_master_data_user(const split_master_data_t *data) {
+    data_changes.push_back(*data);
+}
+}
+
+class Split : public testing::Test {
+public:
+    Split() {
+        layer_state = 0;
+        host_leds = 0;
+        leds_set.clear();
+        backlight_config.raw = 0;
+        backlight_levels.clear();
+        transfer_ok = true;
+        std::fill(slave_rows, slave_rows + SPLIT_ROWS_PER_HAND, 0);
+        slave_version = 0;
+        sent.clear();
+        received = {};
+        std::fill(handed_rows, handed_rows + SPLIT_ROWS_PER_HAND, 0);
+        handed_version = 0;
+        master_inits = 0;
+        slave_inits = 0;
+        transfers.clear();
+        data_changes.clear();
+    }
+
+    void scan() {
+        split_master_start();
+        split_master_finish(matrix);
+    }
+
+    // Lets the master send its state and the slave take it
+    void sync() {
+        scan();
+        scan();
+        slave_version = split_get_master_data()->version;
+        scan();
+        sent.clear();
+    }
+
+    matrix_row_t matrix[MATRIX_ROWS] = {};
+};
+
+TEST_F(Split, the_master_inits_the_master_side_of_the_transport) {
+    split_init(&fake_transport, true, true);
+    EXPECT_TRUE(is_keyboard_master());
+    EXPECT_EQ(master_inits, 1);
+    EXPECT_EQ(slave_inits, 0);
+}
+
+TEST_F(Split, the_slave_inits_the_slave_side_of_the_transport) {
+    split_init(&fake_transport, false, true);
+    EXPECT_FALSE(is_keyboard_master());
+    EXPECT_EQ(master_inits, 0);
+    EXPECT_EQ(slave_inits, 1);
+}
+
+TEST_F(Split, the_left_half_has_the_first_rows) {
+    split_init(&fake_transport, true, true);
+    EXPECT_TRUE(is_keyboard_left());
+    EXPECT_EQ(split_local_offset(), 0);
+    EXPECT_EQ(split_remote_offset(), SPLIT_ROWS_PER_HAND);
+}
+
+TEST_F(Split, the_right_half_has_the_last_rows) {
+    split_init(&fake_transport, true, false);
+    EXPECT_FALSE(is_keyboard_left());
+    EXPECT_EQ(split_local_offset(), SPLIT_ROWS_PER_HAND);
+    EXPECT_EQ(split_remote_offset(), 0);
+}
+
+TEST_F(Split, a_left_master_gets_the_rows_of_the_right_half) {
+    split_init(&fake_transport, true, true);
+    matrix[0] = 0x01;
+    slave_rows[0] = 0x02;
+    slave_rows[SPLIT_ROWS_PER_HAND - 1] = 0x04;
+    scan();
+    EXPECT_EQ(matrix[0], 0x01);
+    EXPECT_EQ(matrix[SPLIT_ROWS_PER_HAND], 0x02);
+    EXPECT_EQ(matrix[MATRIX_ROWS - 1], 0x04);
+    EXPECT_EQ(transfers, std::vector<bool>({true}));
+}
+
+TEST_F(Split, a_right_master_gets_the_rows_of_the_left_half) {
+    split_init(&fake_transport, true, false);
+    matrix[SPLIT_ROWS_PER_HAND] = 0x01;
+    slave_rows[0] = 0x02;
+    scan();
+    EXPECT_EQ(matrix[0], 0x02);
+    EXPECT_EQ(matrix[SPLIT_ROWS_PER_HAND], 0x01);
+}
+
+TEST_F(Split, the_keys_of_the_slave_stay_down_over_a_few_failed_transfers) {
+    split_init(&fake_transport, true, true);
+    slave_rows[1] = 0x08;
+    scan();
+    transfer_ok = false;
+    for (int i = 0; i < SPLIT_ERROR_DISCONNECT_COUNT; i++) {
+        scan();
+        EXPECT_EQ(matrix[SPLIT_ROWS_PER_HAND + 1], 0x08);
+    }
+    EXPECT_EQ(transfers.size(), SPLIT_ERROR_DISCONNECT_COUNT + 1);
+    EXPECT_FALSE(transfers.back());
+}
+
+TEST_F(Split, the_keys_of_a_disconnected_slave_are_released) {
+    split_init(&fake_transport, true, true);
+    slave_rows[1] = 0x08;
+    scan();
+    transfer_ok = false;
+    for (int i = 0; i < SPLIT_ERROR_DISCONNECT_COUNT + 1; i++) {
+        scan();
+    }
+    EXPECT_EQ(matrix[SPLIT_ROWS_PER_HAND + 1], 0);
+}
+
+TEST_F(Split, the_keys_of_the_slave_come_back_when_it_reconnects) {
+    split_init(&fake_transport, true, true);
+    slave_rows[1] = 0x08;
+    transfer_ok = false;
+    for (int i = 0; i < 100; i++) {
+        scan();
+    }
+    EXPECT_EQ(matrix[SPLIT_ROWS_PER_HAND + 1], 0);
+    transfer_ok = true;
+    scan();
+    EXPECT_EQ(matrix[SPLIT_ROWS_PER_HAND + 1], 0x08);
+}
+
+TEST_F(Split, the_master_sends_the_layer_state_and_the_host_leds) {
+    split_init(&fake_transport, true, true);
+    layer_state = 0x80000002;
+    host_leds = 0x05;
+    // the first transfer tells the master which version the slave has
+    scan();
+    EXPECT_TRUE(sent.empty());
+    scan();
+    ASSERT_EQ(sent.size(), 1);
+    EXPECT_EQ(sent[0].layer_state, 0x80000002);
+    EXPECT_EQ(sent[0].host_leds, 0x05);
+    EXPECT_NE(sent[0].version, 0);
+    EXPECT_EQ(split_get_master_data()->layer_state, 0x80000002);
+}
+
+TEST_F(Split, the_master_sends_the_state_until_the_slave_has_it) {
+    split_init(&fake_transport, true, true);
+    scan();
+    scan();
+    scan();
+    ASSERT_EQ(sent.size(), 2);
+    slave_version = sent.back().version;
+    scan();
+    scan();
+    EXPECT_EQ(sent.size(), 3);
+}
+
+TEST_F(Split, the_master_sends_changes_with_a_new_version) {
+    split_init(&fake_transport, true, true);
+    sync();
+    scan();
+    EXPECT_TRUE(sent.empty());
+    layer_state = 0x04;
+    scan();
+    ASSERT_EQ(sent.size(), 1);
+    EXPECT_EQ(sent[0].layer_state, 0x04);
+    EXPECT_NE(sent[0].version, slave_version);
+}
+
+TEST_F(Split, a_reset_master_continues_after_the_version_of_the_slave) {
+    split_init(&fake_transport, true, true);
+    slave_version = 7;
+    scan();
+    scan();
+    ASSERT_EQ(sent.size(), 1);
+    EXPECT_EQ(sent[0].version, 8);
+}
+
+TEST_F(Split, the_version_skips_the_one_of_a_slave_with_nothing) {
+    split_init(&fake_transport, true, true);
+    slave_version = 0xFF;
+    scan();
+    scan();
+    ASSERT_EQ(sent.size(), 1);
+    EXPECT_EQ(sent[0].version, 1);
+}
+
+TEST_F(Split, a_reset_slave_gets_the_state_again) {
+    split_init(&fake_transport, true, true);
+    sync();
+    uint8_t version = slave_version;
+    slave_version = 0;
+    scan();
+    scan();
+    ASSERT_EQ(sent.size(), 1);
+    EXPECT_EQ(sent[0].version, version);
+}
+
+TEST_F(Split, a_right_slave_hands_its_own_rows_to_the_transport) {
+    split_init(&fake_transport, false, false);
+    matrix[0] = 0x01;
+    matrix[SPLIT_ROWS_PER_HAND] = 0x02;
+    matrix[MATRIX_ROWS - 1] = 0x04;
+    split_slave_update(matrix);
+    EXPECT_EQ(handed_rows[0], 0x02);
+    EXPECT_EQ(handed_rows[SPLIT_ROWS_PER_HAND - 1], 0x04);
+}
+
+TEST_F(Split, the_slave_takes_the_state_of_the_master) {
+    split_init(&fake_transport, false, true);
+    received.layer_state = 0x06;
+    received.host_leds = 0x02;
+    received.version = 1;
+    split_slave_update(matrix);
+    EXPECT_EQ(layer_state, 0x06);
+    EXPECT_EQ(leds_set, std::vector<uint8_t>({0x02}));
+    ASSERT_EQ(data_changes.size(), 1);
+    EXPECT_EQ(data_changes[0].layer_state, 0x06);
+    EXPECT_EQ(split_get_master_data()->host_leds, 0x02);
+}
+
+TEST_F(Split, the_slave_reports_the_version_it_has) {
+    split_init(&fake_transport, false, true);
+    split_slave_update(matrix);
+    EXPECT_EQ(handed_version, 0);
+    received.version = 3;
+    split_slave_update(matrix);
+    split_slave_update(matrix);
+    EXPECT_EQ(handed_version, 3);
+}
+
+TEST_F(Split, the_slave_applies_everything_the_first_time) {
+    split_init(&fake_transport, false, true);
+    received.version = 1;
+    split_slave_update(matrix);
+    EXPECT_EQ(leds_set, std::vector<uint8_t>({0x00}));
+    EXPECT_EQ(backlight_levels, std::vector<uint8_t>({0}));
+}
+
+TEST_F(Split, the_slave_is_only_told_about_new_versions) {
+    split_init(&fake_transport, false, true);
+    received.layer_state = 0x06;
+    received.version = 1;
+    split_slave_update(matrix);
+    split_slave_update(matrix);
+    EXPECT_EQ(data_changes.size(), 1);
+    // a state that is still being written
+    received.layer_state = 0x02;
+    split_slave_update(matrix);
+    EXPECT_EQ(data_changes.size(), 1);
+    EXPECT_EQ(layer_state, 0x06);
+    received.version = 2;
+    split_slave_update(matrix);
+    EXPECT_EQ(data_changes.size(), 2);
+    EXPECT_EQ(layer_state, 0x02);
+    // the leds never changed
+    EXPECT_EQ(leds_set, std::vector<uint8_t>({0x00}));
+}
+
+TEST_F(Split, the_slave_sets_the_backlight_of_the_master) {
+    split_init(&fake_transport, false, true);
+    received.version = 1;
+    split_slave_update(matrix);
+    backlight_config_t backlight = {};
+    backlight.enable = true;
+    backlight.level = 3;
+    received.backlight = backlight.raw;
+    received.version = 2;
+    split_slave_update(matrix);
+    EXPECT_EQ(backlight_config.raw, backlight.raw);
+    EXPECT_EQ(backlight_levels, std::vector<uint8_t>({0, 3}));
+    backlight.enable = false;
+    received.backlight = backlight.raw;
+    received.version = 3;
+    split_slave_update(matrix);
+    EXPECT_EQ(backlight_levels, std::vector<uint8_t>({0, 3, 0}));
+}
@@ -0,0 +1,2 @@
+TEST_LIST +=\
+	split
\ No newline at end of file
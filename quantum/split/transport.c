@@ -0,0 +1,189 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The split transports for AVR, selected in config.h:
+ *   USE_I2C          - i2c, see i2c.c
+ *   USE_SERIAL       - the bit-banged serial, see serial.c
+ *   USE_SERIAL_USART - with USE_SERIAL, the serial on the hardware USART,
+ *                      see serial_usart.c
+ *
+ * The drivers don't know about the split, this file moves the rows and
+ * split_master_data_t through their buffers.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <string.h>
+#include "split.h"
+#include "config.h"
+
+#if MATRIX_COLS > 8
+#   error "The split transports send each row as one byte, MATRIX_COLS can't be more than 8"
+#endif
+
+#if defined(USE_I2C)
+
+#include "i2c.h"
+#include "twi.h"
+
+// The version the slave has is in the register after its rows
+#define I2C_SLAVE_VERSION (I2C_SLAVE_ROWS + SPLIT_ROWS_PER_HAND)
+
+#if I2C_SLAVE_VERSION + 1 > I2C_SLAVE_MASTER_DATA
+#   error "The rows of the slave don't fit in the i2c slave registers"
+#endif
+
+static twi_transaction_t master_write;
+static twi_transaction_t slave_read;
+static bool master_write_submitted;
+static uint8_t master_write_data[1 + sizeof(split_master_data_t)];
+static const uint8_t slave_rows_register = I2C_SLAVE_ROWS;
+// The rows and the version
+static uint8_t slave_rows[SPLIT_ROWS_PER_HAND + 1];
+
+static void transport_slave_init(void) {
+    i2c_slave_init(SLAVE_I2C_ADDRESS);
+}
+
+// Queues the write of the master data, if there is any, and the read of the
+// rows, the i2c interrupt does them while the local half is scanned
+static void transport_master_start(const split_master_data_t *data) {
+    master_write_submitted = data != NULL;
+    if (master_write_submitted) {
+        master_write_data[0] = I2C_SLAVE_MASTER_DATA;
+        memcpy(&master_write_data[1], data, sizeof(*data));
+        master_write = (twi_transaction_t) {
+            .address = SLAVE_I2C_ADDRESS >> 1,
+            .write_data = master_write_data,
+            .write_size = sizeof(master_write_data),
+        };
+        twi_submit(&master_write);
+    }
+
+    slave_read = (twi_transaction_t) {
+        .address = SLAVE_I2C_ADDRESS >> 1,
+        .write_data = &slave_rows_register,
+        .write_size = 1,
+        .read_data = slave_rows,
+        .read_size = sizeof(slave_rows),
+    };
+    twi_submit(&slave_read);
+}
+
+static bool transport_master_finish(matrix_row_t rows[], uint8_t *version) {
+    // The transactions run in order, so the write is done as well
+    if (twi_wait(&slave_read) || (master_write_submitted && master_write.status)) {
+        // the cable is disconnected, or something else went wrong
+        return false;
+    }
+    for (uint8_t i = 0; i < SPLIT_ROWS_PER_HAND; i++) {
+        rows[i] = slave_rows[i];
+    }
+    *version = slave_rows[SPLIT_ROWS_PER_HAND];
+    return true;
+}
+
+static void transport_slave_transfer(const matrix_row_t rows[], uint8_t version, split_master_data_t *data) {
+    uint8_t *bytes = (uint8_t *)data;
+
+    // The i2c interrupt reads and writes the registers
+    uint8_t sreg = SREG;
+    cli();
+    for (uint8_t i = 0; i < SPLIT_ROWS_PER_HAND; i++) {
+        i2c_slave_buffer[I2C_SLAVE_ROWS + i] = rows[i];
+    }
+    i2c_slave_buffer[I2C_SLAVE_VERSION] = version;
+    // The master may be part way through writing the data, then the copy
+    // would mix two versions. Nothing changes while the interrupts are off,
+    // so that's only the case when the write sequence is odd.
+    if (twi_slave_write_sequence & 1) {
+        // the slave keeps what it has, the rest comes with the next pass
+        data->version = version;
+    } else {
+        for (uint8_t i = 0; i < sizeof(*data); i++) {
+            bytes[i] = i2c_slave_buffer[I2C_SLAVE_MASTER_DATA + i];
+        }
+    }
+    SREG = sreg;
+}
+
+const split_transport_t split_transport = {
+    i2c_master_init,
+    transport_slave_init,
+    transport_master_start,
+    transport_master_finish,
+    transport_slave_transfer
+};
+
+#elif defined(USE_SERIAL)
+
+#include "serial.h"
+
+// The bytes of serial_master_buffer sent with the next transfer, all of them
+// or none
+static uint8_t master_size;
+
+static void transport_master_start(const split_master_data_t *data) {
+    master_size = 0;
+    if (data) {
+        const uint8_t *bytes = (const uint8_t *)data;
+        for (uint8_t i = 0; i < SERIAL_MASTER_BUFFER_LENGTH; i++) {
+            serial_master_buffer[i] = bytes[i];
+        }
+        master_size = SERIAL_MASTER_BUFFER_LENGTH;
+    }
+}
+
+// The bit-banged serial does the whole transfer here, the USART one returns
+// right away with the result of the previous transfer
+static bool transport_master_finish(matrix_row_t rows[], uint8_t *version) {
+    if (serial_update_buffers(master_size)) {
+        return false;
+    }
+    for (uint8_t i = 0; i < SPLIT_ROWS_PER_HAND; i++) {
+        rows[i] = serial_slave_buffer[i];
+    }
+    *version = serial_slave_buffer[SPLIT_ROWS_PER_HAND];
+    return true;
+}
+
+static void transport_slave_transfer(const matrix_row_t rows[], uint8_t version, split_master_data_t *data) {
+    uint8_t *bytes = (uint8_t *)data;
+
+    // The serial interrupt reads and writes the buffers
+    uint8_t sreg = SREG;
+    cli();
+    for (uint8_t i = 0; i < SPLIT_ROWS_PER_HAND; i++) {
+        serial_slave_buffer[i] = rows[i];
+    }
+    serial_slave_buffer[SPLIT_ROWS_PER_HAND] = version;
+    for (uint8_t i = 0; i < SERIAL_MASTER_BUFFER_LENGTH; i++) {
+        bytes[i] = serial_master_buffer[i];
+    }
+    SREG = sreg;
+}
+
+const split_transport_t split_transport = {
+    serial_master_init,
+    serial_slave_init,
+    transport_master_start,
+    transport_master_finish,
+    transport_slave_transfer
+};
+
+#else
+#   error "Select the split transport with USE_I2C or USE_SERIAL in config.h"
+#endif
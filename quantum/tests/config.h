@@ -0,0 +1,33 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "config_common.h"
+
+/* Configuration shared by the native quantum test keymaps */
+
+#define MATRIX_ROWS 4
+#define MATRIX_COLS 12
+
+#define TAPPING_TERM 200
+#define LEADER_TIMEOUT 300
+#define UNICODE_TYPE_DELAY 10
+
+#define NO_PRINT
+#define NO_DEBUG
+
+#endif
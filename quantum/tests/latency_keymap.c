@@ -0,0 +1,72 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Keymap exercised by latency_tests.cpp, every feature under test has its own
+ * keys so the corpora can be mixed freely. */
+
+#include "quantum.h"
+
+enum {
+    TD_MINS_EQL = 0,
+};
+
+#define HM_A MT(MOD_LSFT, KC_A)
+#define HM_S MT(MOD_LCTL, KC_S)
+#define HM_L MT(MOD_RCTL, KC_L)
+#define HM_SCLN MT(MOD_RSFT, KC_SCLN)
+#define LT_SPC LT(1, KC_SPC)
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    [0] = {
+        { KC_Q,    KC_W,    KC_E,    KC_R,    KC_T,    KC_Y,    KC_U,    KC_I,    KC_O,    KC_P,    KC_BSPC, TD(TD_MINS_EQL) },
+        { HM_A,    HM_S,    KC_D,    KC_F,    KC_G,    KC_H,    KC_J,    KC_K,    HM_L,    HM_SCLN, KC_ENT,  KC_LEAD },
+        { KC_Z,    KC_X,    KC_C,    KC_V,    KC_B,    KC_N,    KC_M,    KC_COMM, KC_DOT,  KC_SLSH, UC(0x00E9), UC(0x00FC) },
+        { KC_LCTL, KC_LGUI, KC_LALT, KC_LSFT, LT_SPC,  KC_SPC,  KC_A,    KC_S,    KC_L,    KC_SCLN, KC_NO,   KC_NO }
+    },
+    [1] = {
+        { KC_1,    KC_2,    KC_3,    KC_4,    KC_5,    KC_6,    KC_7,    KC_8,    KC_9,    KC_0,    KC_DEL,  KC_TRNS },
+        { KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS },
+        { KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS },
+        { KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS }
+    },
+};
+
+
+qk_tap_dance_action_t tap_dance_actions[] = {
+    [TD_MINS_EQL] = ACTION_TAP_DANCE_DOUBLE(KC_MINS, KC_EQL),
+};
+
+LEADER_EXTERNS();
+
+void matrix_init_user(void) {
+    set_unicode_input_mode(UC_LNX);
+}
+
+void matrix_scan_user(void) {
+    LEADER_DICTIONARY() {
+        leading = false;
+        leader_end();
+
+        SEQ_TWO_KEYS(KC_F, KC_S) {
+            SEND_STRING("qmk");
+        }
+        SEQ_ONE_KEY(KC_G) {
+            register_code(KC_LGUI);
+            register_code(KC_G);
+            unregister_code(KC_G);
+            unregister_code(KC_LGUI);
+        }
+    }
+}
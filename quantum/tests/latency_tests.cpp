@@ -0,0 +1,569 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * End-to-end latency benchmarks: typing corpora are replayed through
+ * keyboard_task -> action_exec -> action_tapping -> process_record_quantum
+ * against the simulated native clock, and the keyboard reports that come out
+ * are decoded back into text. Each case checks the text and reports
+ *
+ *   - p50/p99 latency from the key press to the report carrying its output,
+ *     so the wait for the next scan is included,
+ *   - keyboard reports sent per key press,
+ *   - instructions (or cycles, when no counter is available) per key event,
+ *     counting only the scans that see a key change.
+ */
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+extern "C" {
+#include "keyboard.h"
+#include "matrix.h"
+#include "host.h"
+#include "host_driver.h"
+#include "report.h"
+#include "keycode.h"
+#include "action_util.h"
+#include "action_layer.h"
+#include "native/timer_native.h"
+
+void matrix_init_quantum(void);
+void matrix_scan_quantum(void);
+void matrix_init_user(void);
+void matrix_scan_user(void);
+}
+
+#define SCAN_INTERVAL_US 1000
+#define TAIL_US 1000000
+
+// Positions in latency_keymap.c
+struct key_pos {
+    uint8_t row;
+    uint8_t col;
+};
+
+static const key_pos K_Q = {0, 0}, K_W = {0, 1}, K_E = {0, 2}, K_R = {0, 3}, K_T = {0, 4},
+    K_Y = {0, 5}, K_U = {0, 6}, K_I = {0, 7}, K_O = {0, 8}, K_P = {0, 9}, K_TD = {0, 11},
+    K_D = {1, 2}, K_F = {1, 3}, K_G = {1, 4}, K_H = {1, 5}, K_J = {1, 6}, K_K = {1, 7},
+    K_LEAD = {1, 11}, K_Z = {2, 0}, K_X = {2, 1}, K_C = {2, 2}, K_V = {2, 3}, K_B = {2, 4},
+    K_N = {2, 5}, K_M = {2, 6}, K_COMM = {2, 7}, K_DOT = {2, 8}, K_E_ACUTE = {2, 10},
+    K_U_UMLAUT = {2, 11}, K_LSFT = {3, 3}, K_LT_SPC = {3, 4}, K_SPC = {3, 5},
+    // home row mod-taps
+    K_MT_A = {1, 0}, K_MT_S = {1, 1}, K_MT_L = {1, 8}, K_MT_SCLN = {1, 9},
+    // plain versions of the mod-tap keys
+    K_A = {3, 6}, K_S = {3, 7}, K_L = {3, 8}, K_SCLN = {3, 9};
+
+struct key_event {
+    uint64_t time;
+    key_pos key;
+    bool pressed;
+};
+
+struct stroke {
+    std::string output;
+    uint64_t trigger;
+};
+
+// Deterministic typing rhythm, roughly 100 wpm with some rolls
+class Corpus {
+public:
+    Corpus& tap(key_pos key, const char* output) {
+        bool roll = rolling && allow_rolls;
+        uint64_t start = roll ? last_start + gap() : next_free + gap();
+        if (roll && key.row == last_key.row && key.col == last_key.col) {
+            // the same switch can't be pressed again before it is released
+            start = std::max(start, next_free + between(20, 40));
+        }
+        uint64_t hold = between(50, 90);
+        add(key, start, start + hold);
+        strokes.push_back({output, start});
+        last_start = start;
+        last_key = key;
+        rolling = true;
+        return *this;
+    }
+
+    // Stay idle, so timeouts like the leader key one can expire
+    Corpus& pause(unsigned ms) {
+        next_free += ms * 1000;
+        rolling = false;
+        return *this;
+    }
+
+    // Type every key only after the previous one was released
+    Corpus& no_rolls() {
+        allow_rolls = false;
+        return *this;
+    }
+
+    // Tap key while hold is held down, in the order down, down, up, up.
+    // hold is kept down past the tapping term, so dual role keys resolve to hold.
+    Corpus& chord(key_pos hold, key_pos key, const char* output) {
+        uint64_t start = next_free + gap();
+        uint64_t press = start + between(TAPPING_TERM + 20, TAPPING_TERM + 60);
+        uint64_t release = press + between(50, 90);
+        add(hold, start, release + between(20, 40));
+        add(key, press, release);
+        strokes.push_back({output, press});
+        last_start = start;
+        rolling = false;
+        return *this;
+    }
+
+    // Each key is pressed before the one before it is released, output
+    // measured from the first press
+    Corpus& roll(std::initializer_list<key_pos> keys, const char* output) {
+        uint64_t start = next_free + gap();
+        uint64_t press = start;
+        const key_pos* prev = nullptr;
+        for (auto& key : keys) {
+            if (prev) {
+                uint64_t next = press + between(30, 60);
+                add(*prev, press, next + between(10, 30));
+                press = next;
+            }
+            prev = &key;
+        }
+        add(*prev, press, press + between(40, 70));
+        strokes.push_back({output, start});
+        last_start = start;
+        rolling = false;
+        return *this;
+    }
+
+    // Keys tapped one after another without overlap, output measured from the last press
+    Corpus& sequence(std::initializer_list<key_pos> keys, const char* output) {
+        uint64_t start = next_free + gap();
+        uint64_t press = start;
+        for (auto& key : keys) {
+            uint64_t release = press + between(40, 70);
+            add(key, press, release);
+            start = press;
+            press = release + between(40, 80);
+        }
+        strokes.push_back({output, start});
+        last_start = start;
+        rolling = false;
+        return *this;
+    }
+
+    Corpus& text(const char* str, const key_pos* (*lookup)(char)) {
+        for (; *str; str++) {
+            const key_pos* key = lookup(*str);
+            char output[2] = {*str, 0};
+            tap(*key, output);
+        }
+        return *this;
+    }
+
+    std::string expected() const {
+        std::string result;
+        for (auto& s : strokes) {
+            result += s.output;
+        }
+        return result;
+    }
+
+    unsigned presses() const {
+        return events.size() / 2;
+    }
+
+    std::vector<key_event> sorted_events() const {
+        std::vector<key_event> result = events;
+        std::stable_sort(result.begin(), result.end(),
+            [](const key_event& a, const key_event& b) { return a.time < b.time; });
+        return result;
+    }
+
+    std::vector<key_event> events;
+    std::vector<stroke> strokes;
+
+private:
+    void add(key_pos key, uint64_t press, uint64_t release) {
+        events.push_back({press, key, true});
+        events.push_back({release, key, false});
+        next_free = std::max(next_free, release);
+    }
+
+    // Random time in us between low and high ms, not aligned to the scans
+    uint64_t between(unsigned low, unsigned high) {
+        seed = seed * 1103515245 + 12345;
+        return low * 1000 + (seed >> 8) % ((high - low) * 1000 + 1);
+    }
+
+    uint64_t gap() {
+        return between(60, 140);
+    }
+
+    uint32_t seed = 1;
+    uint64_t last_start = 0;
+    uint64_t next_free = 0;
+    key_pos last_key = {0xFF, 0xFF};
+    bool rolling = false;
+    bool allow_rolls = true;
+};
+
+static const key_pos* base_key(char c) {
+    static const key_pos letters[26] = {
+        K_A, K_B, K_C, K_D, K_E, K_F, K_G, K_H, K_I, K_J, K_K, K_L, K_M,
+        K_N, K_O, K_P, K_Q, K_R, K_S, K_T, K_U, K_V, K_W, K_X, K_Y, K_Z
+    };
+    if (c >= 'a' && c <= 'z') return &letters[c - 'a'];
+    if (c == ' ') return &K_SPC;
+    if (c == ',') return &K_COMM;
+    if (c == '.') return &K_DOT;
+    if (c == ';') return &K_SCLN;
+    return nullptr;
+}
+
+static const key_pos* home_row_mod_key(char c) {
+    if (c == 'a') return &K_MT_A;
+    if (c == 's') return &K_MT_S;
+    if (c == 'l') return &K_MT_L;
+    if (c == ';') return &K_MT_SCLN;
+    return base_key(c);
+}
+
+static char keycode_to_char(uint8_t code, bool shifted) {
+    static const char digits[] = "1234567890";
+    static const char shifted_digits[] = "!@#$%^&*()";
+    if (code >= KC_A && code <= KC_Z) return (shifted ? 'A' : 'a') + code - KC_A;
+    if (code >= KC_1 && code <= KC_0) return (shifted ? shifted_digits : digits)[code - KC_1];
+    switch (code) {
+        case KC_SPC: return ' ';
+        case KC_ENT: return '\n';
+        case KC_MINS: return shifted ? '_' : '-';
+        case KC_EQL: return shifted ? '+' : '=';
+        case KC_SCLN: return shifted ? ':' : ';';
+        case KC_COMM: return shifted ? '<' : ',';
+        case KC_DOT: return shifted ? '>' : '.';
+        case KC_SLSH: return shifted ? '?' : '/';
+    }
+    return '~';
+}
+
+struct typed_char {
+    char c;
+    uint64_t time;
+};
+
+static uint64_t read_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Counts retired user space instructions, falls back to cycles when the
+// kernel or the container does not expose the counter
+class InstructionCounter {
+public:
+    InstructionCounter() {
+#ifdef __linux__
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+
+    ~InstructionCounter() {
+#ifdef __linux__
+        if (fd >= 0) close(fd);
+#endif
+    }
+
+    bool has_instructions() const { return fd >= 0; }
+
+    void start() {
+#ifdef __linux__
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            return;
+        }
+#endif
+        started = read_cycles();
+    }
+
+    void stop() {
+#ifdef __linux__
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            return;
+        }
+#endif
+        total += read_cycles() - started;
+    }
+
+    uint64_t count() {
+#ifdef __linux__
+        if (fd >= 0) {
+            uint64_t value = 0;
+            if (read(fd, &value, sizeof(value)) != sizeof(value)) return 0;
+            return value;
+        }
+#endif
+        return total;
+    }
+
+private:
+    int fd = -1;
+    uint64_t started = 0;
+    uint64_t total = 0;
+};
+
+class Latency : public testing::Test {
+public:
+    Latency() {
+        Instance = this;
+        host_set_driver(&driver);
+        matrix_init_quantum();
+    }
+
+    ~Latency() {
+        clear_keyboard();
+        layer_clear();
+        Instance = nullptr;
+    }
+
+    void run(const char* name, const Corpus& corpus) {
+        auto events = corpus.sorted_events();
+        uint64_t start = timer_read_us();
+        uint64_t end = start + events.back().time + TAIL_US;
+        InstructionCounter counter;
+        size_t next = 0;
+
+        reports = 0;
+        typed.clear();
+        while (timer_read_us() <= end) {
+            uint64_t now = timer_read_us();
+            bool changed = false;
+            for (; next < events.size() && start + events[next].time <= now; next++) {
+                auto& e = events[next];
+                if (e.pressed) {
+                    matrix[e.key.row] |= (matrix_row_t)1 << e.key.col;
+                } else {
+                    matrix[e.key.row] &= ~((matrix_row_t)1 << e.key.col);
+                }
+                changed = true;
+            }
+            // the idle scans would only dilute the cost of the events
+            if (changed) {
+                counter.start();
+            }
+            keyboard_task();
+            if (changed) {
+                counter.stop();
+            }
+            timer_advance_us(SCAN_INTERVAL_US);
+        }
+
+        std::string text;
+        for (auto& t : typed) {
+            text += t.c;
+        }
+        ASSERT_EQ(text, corpus.expected());
+
+        std::vector<uint64_t> latencies;
+        size_t pos = 0;
+        for (auto& s : corpus.strokes) {
+            if (pos < typed.size()) {
+                latencies.push_back(typed[pos].time - (start + s.trigger));
+            }
+            pos += s.output.size();
+        }
+        std::sort(latencies.begin(), latencies.end());
+        ASSERT_FALSE(latencies.empty());
+
+        unsigned presses = corpus.presses();
+        std::cout << "[ LATENCY  ] " << name << ": " << presses << " key presses"
+                  << ", p50 " << percentile(latencies, 50) / 1000.0 << " ms"
+                  << ", p99 " << percentile(latencies, 99) / 1000.0 << " ms"
+                  << ", " << std::setprecision(3) << (double)reports / presses << " reports/press"
+                  << ", " << counter.count() / (presses * 2)
+                  << (counter.has_instructions() ? " instructions/event" : " cycles/event")
+                  << std::endl;
+        reports_per_press = (double)reports / presses;
+    }
+
+    static uint64_t percentile(const std::vector<uint64_t>& sorted, unsigned p) {
+        size_t index = (sorted.size() * p + 99) / 100;
+        return sorted[index ? index - 1 : 0];
+    }
+
+    static void send_keyboard(report_keyboard_t* report) {
+        Instance->record(report);
+    }
+
+    void record(report_keyboard_t* report) {
+        reports++;
+        bool shifted = report->mods & (MOD_BIT(KC_LSFT) | MOD_BIT(KC_RSFT));
+        for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+            uint8_t code = report->keys[i];
+            if (code && !std::count(last.keys, last.keys + KEYBOARD_REPORT_KEYS, code)) {
+                typed.push_back({keycode_to_char(code, shifted), timer_read_us()});
+            }
+        }
+        last = *report;
+    }
+
+    static Latency* Instance;
+
+    host_driver_t driver = {
+        [](void) -> uint8_t { return 0; },
+        send_keyboard,
+        [](report_mouse_t*) {},
+        [](uint16_t) {},
+        [](uint16_t) {},
+    };
+    matrix_row_t matrix[MATRIX_ROWS] = {};
+    report_keyboard_t last = {};
+    std::vector<typed_char> typed;
+    unsigned reports = 0;
+    double reports_per_press = 0;
+};
+
+Latency* Latency::Instance = nullptr;
+
+extern "C" {
+void matrix_init(void) {}
+void matrix_print(void) {}
+
+uint8_t matrix_scan(void) {
+    matrix_scan_quantum();
+    return 1;
+}
+
+matrix_row_t matrix_get_row(uint8_t row) {
+    return Latency::Instance->matrix[row];
+}
+
+void matrix_init_kb(void) {
+    matrix_init_user();
+}
+
+void matrix_scan_kb(void) {
+    matrix_scan_user();
+}
+}
+
+static const char* sentence = "the quick brown fox jumps over the lazy dog, then naps. ";
+
+TEST_F(Latency, plain_typing) {
+    Corpus corpus;
+    for (int i = 0; i < 4; i++) {
+        corpus.text(sentence, base_key);
+    }
+    run("plain", corpus);
+    EXPECT_LE(reports_per_press, 2.0);
+}
+
+// Rolling over mod-tap keys still misfires, so this corpus types cleanly, see
+// mod_tap_rolls for the rolls
+TEST_F(Latency, mod_tap_home_row) {
+    Corpus corpus;
+    corpus.no_rolls();
+    for (int i = 0; i < 4; i++) {
+        corpus.text("as all lads ask; a salad lasts. ", home_row_mod_key);
+    }
+    corpus.chord(K_MT_A, K_D, "D").chord(K_MT_L, K_F, "f").chord(K_MT_SCLN, K_G, "G");
+    run("mod-tap", corpus);
+    EXPECT_LE(reports_per_press, 2.5);
+}
+
+TEST_F(Latency, layer_tap_space) {
+    Corpus corpus;
+    for (int i = 0; i < 4; i++) {
+        // pressing the key again right after a tap would auto-repeat the space
+        corpus.text("type", base_key).tap(K_LT_SPC, " ").text("n", base_key);
+        corpus.chord(K_LT_SPC, K_Q, "1").chord(K_LT_SPC, K_W, "2").chord(K_LT_SPC, K_P, "0");
+        corpus.tap(K_LT_SPC, " ");
+    }
+    run("layer-tap", corpus);
+    EXPECT_LE(reports_per_press, 2.5);
+}
+
+TEST_F(Latency, tap_dance) {
+    Corpus corpus;
+    // the dance finishes when another key is pressed or the tapping term ends
+    for (int i = 0; i < 8; i++) {
+        corpus.sequence({K_TD}, "-").tap(K_X, "x");
+        corpus.sequence({K_TD, K_TD}, "=").pause(TAPPING_TERM);
+    }
+    run("tap dance", corpus);
+    EXPECT_LE(reports_per_press, 2.0);
+}
+
+TEST_F(Latency, leader) {
+    Corpus corpus;
+    for (int i = 0; i < 8; i++) {
+        corpus.sequence({K_LEAD, K_F, K_S}, "qmk").pause(LEADER_TIMEOUT);
+        corpus.tap(K_C, "c");
+    }
+    run("leader", corpus);
+    EXPECT_LE(reports_per_press, 3.0);
+}
+
+TEST_F(Latency, unicode) {
+    Corpus corpus;
+    for (int i = 0; i < 8; i++) {
+        corpus.sequence({K_E_ACUTE}, "U00e9 ");
+        corpus.sequence({K_U_UMLAUT}, "U00fc ");
+    }
+    run("unicode", corpus);
+    EXPECT_LE(reports_per_press, 16.0);
+}
+
+// Rolls into and out of the home row mod-taps, which keep the tapping buffer
+// busy with the other keys. A mod-tap with another key pressed inside it is
+// cancelled, see the ad hoc case of MODS_TAP in action.c, so its letter is
+// missing from the text, and the keys pressed inside it wait for the end of
+// its tapping term.
+TEST_F(Latency, mod_tap_rolls) {
+    Corpus corpus;
+    for (int i = 0; i < 8; i++) {
+        corpus.roll({K_D, K_MT_A}, "da").roll({K_D, K_F, K_MT_A}, "dfa");
+        // pressed again right after its tap, the mod-tap would tap again
+        corpus.pause(TAPPING_TERM);
+        corpus.roll({K_MT_A, K_D}, "d").roll({K_MT_A, K_MT_S}, "s");
+        corpus.roll({K_D, K_MT_A, K_F}, "df").roll({K_D, K_MT_SCLN, K_MT_A, K_F}, "daf");
+        corpus.pause(TAPPING_TERM);
+    }
+    run("mod-tap rolls", corpus);
+    EXPECT_LE(reports_per_press, 2.0);
+}
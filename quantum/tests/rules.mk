@@ -0,0 +1,29 @@
+quantum_latency_DEFS := \
+	-DTAP_DANCE_ENABLE \
+	-DUNICODE_ENABLE
+
+quantum_latency_CONFIG := $(QUANTUM_PATH)/tests/config.h
+
+quantum_latency_SRC := \
+	$(QUANTUM_PATH)/tests/latency_tests.cpp \
+	$(QUANTUM_PATH)/tests/latency_keymap.c \
+	$(QUANTUM_PATH)/quantum.c \
+	$(QUANTUM_PATH)/keymap_common.c \
+	$(QUANTUM_PATH)/keycode_config.c \
+	$(QUANTUM_PATH)/process_keycode/process_leader.c \
+	$(QUANTUM_PATH)/process_keycode/process_tap_dance.c \
+	$(QUANTUM_PATH)/process_keycode/process_unicode.c \
+	$(TMK_PATH)/common/keyboard.c \
+	$(TMK_PATH)/common/action.c \
+	$(TMK_PATH)/common/action_tapping.c \
+	$(TMK_PATH)/common/action_macro.c \
+	$(TMK_PATH)/common/action_layer.c \
+	$(TMK_PATH)/common/action_util.c \
+	$(TMK_PATH)/common/host.c \
+	$(TMK_PATH)/common/magic.c \
+	$(TMK_PATH)/common/eeconfig.c \
+	$(TMK_PATH)/common/debug.c \
+	$(TMK_PATH)/common/util.c \
+	$(TMK_PATH)/common/native/timer.c \
+	$(TMK_PATH)/common/native/eeprom.c \
+	$(TMK_PATH)/common/native/bootloader.c
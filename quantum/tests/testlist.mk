@@ -0,0 +1,2 @@
+TEST_LIST +=\
+	quantum_latency
\ No newline at end of file
@@ -74,7 +74,8 @@ static bool visualizer_enabled = false;
 static keyframe_animation_t* animations[MAX_SIMULTANEOUS_ANIMATIONS] = {};
 
 #ifdef SERIAL_LINK_ENABLE
-MASTER_TO_ALL_SLAVES_OBJECT(current_status, visualizer_keyboard_status_t);
+// The status only changes with the layers and leds, so two buffers are enough
+MASTER_TO_ALL_SLAVES_OBJECT_WITH_FLAGS(current_status, visualizer_keyboard_status_t, REMOTE_OBJECT_DOUBLE_BUFFERED);
 
 static remote_object_t* remote_objects[] = {
     REMOTE_OBJECT(current_status),
@@ -3,6 +3,8 @@ ifeq ($(PLATFORM),AVR)
 	PLATFORM_COMMON_DIR = $(COMMON_DIR)/avr
 else ifeq ($(PLATFORM),CHIBIOS)
 	PLATFORM_COMMON_DIR = $(COMMON_DIR)/chibios
+else ifeq ($(PLATFORM),NATIVE)
+	PLATFORM_COMMON_DIR = $(COMMON_DIR)/native
 endif
 
 TMK_COMMON_SRC +=	$(COMMON_DIR)/host.c \
@@ -27,6 +29,11 @@ endif
 ifeq ($(PLATFORM),CHIBIOS)
 	TMK_COMMON_SRC += $(PLATFORM_COMMON_DIR)/printf.c
 	TMK_COMMON_SRC += $(PLATFORM_COMMON_DIR)/eeprom.c
+	TMK_COMMON_SRC += $(COMMON_DIR)/report_queue.c
+endif
+
+ifeq ($(PLATFORM),NATIVE)
+	TMK_COMMON_SRC += $(PLATFORM_COMMON_DIR)/eeprom.c
 endif
 
 
@@ -81,6 +88,11 @@ ifeq ($(strip $(BACKLIGHT_ENABLE)), yes)
     TMK_COMMON_DEFS += -DBACKLIGHT_ENABLE
 endif
 
+ifeq ($(strip $(TWI_ENABLE)), yes)
+    TMK_COMMON_SRC += $(PLATFORM_COMMON_DIR)/twi.c
+    TMK_COMMON_DEFS += -DTWI_ENABLE
+endif
+
 ifeq ($(strip $(BLUETOOTH_ENABLE)), yes)
     TMK_COMMON_DEFS += -DBLUETOOTH_ENABLE
 endif
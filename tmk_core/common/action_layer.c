@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include <string.h>
 #include "keyboard.h"
 #include "action.h"
 #include "util.h"
@@ -174,30 +175,90 @@ action_t store_or_get_action(bool pressed, keypos_t key)
 }
 
 
-int8_t layer_switch_get_layer(keypos_t key)
+#if !defined(NO_ACTION_LAYER) && defined(LAYER_CACHE_ENABLE)
+/*
+ * Resolved layer and action per key, so repeated lookups for the same
+ * layer state don't walk the layers and the keymap again. Entries hold
+ * the layer plus one, so zero (the initial state) means unresolved.
+ * The layer state the entries were resolved with is kept alongside, which
+ * also catches code that writes layer_state directly.
+ */
+static uint8_t layer_cache_layer[MATRIX_ROWS][MATRIX_COLS];
+static action_t layer_cache_action[MATRIX_ROWS][MATRIX_COLS];
+static uint32_t layer_cache_state = 0;
+
+void layer_cache_invalidate(void)
 {
-    action_t action;
-    action.code = ACTION_TRANSPARENT;
+    memset(layer_cache_layer, 0, sizeof(layer_cache_layer));
+}
 
+static inline void layer_cache_check_state(void)
+{
+    uint32_t layers = layer_state | default_layer_state;
+    if (layers != layer_cache_state) {
+        layer_cache_state = layers;
+        layer_cache_invalidate();
+    }
+}
+#endif
+
+/* walk the active layers from the top and return the first non-transparent one */
+static int8_t layer_switch_resolve(keypos_t key, action_t *action)
+{
 #ifndef NO_ACTION_LAYER
     uint32_t layers = layer_state | default_layer_state;
     /* check top layer first */
     for (int8_t i = 31; i >= 0; i--) {
         if (layers & (1UL<<i)) {
-            action = action_for_key(i, key);
-            if (action.code != ACTION_TRANSPARENT) {
+            *action = action_for_key(i, key);
+            if (action->code != ACTION_TRANSPARENT) {
                 return i;
             }
         }
     }
     /* fall back to layer 0 */
+    *action = action_for_key(0, key);
     return 0;
 #else
-    return biton32(default_layer_state);
+    int8_t layer = biton32(default_layer_state);
+    *action = action_for_key(layer, key);
+    return layer;
+#endif
+}
+
+#if !defined(NO_ACTION_LAYER) && defined(LAYER_CACHE_ENABLE)
+static uint8_t layer_cache_lookup(keypos_t key)
+{
+    layer_cache_check_state();
+    uint8_t cached = layer_cache_layer[key.row][key.col];
+    if (!cached) {
+        action_t action;
+        cached = layer_switch_resolve(key, &action) + 1;
+        layer_cache_layer[key.row][key.col] = cached;
+        layer_cache_action[key.row][key.col] = action;
+    }
+    return cached - 1;
+}
+#endif
+
+int8_t layer_switch_get_layer(keypos_t key)
+{
+#if !defined(NO_ACTION_LAYER) && defined(LAYER_CACHE_ENABLE)
+    return layer_cache_lookup(key);
+#else
+    action_t action;
+    return layer_switch_resolve(key, &action);
 #endif
 }
 
 action_t layer_switch_get_action(keypos_t key)
 {
-    return action_for_key(layer_switch_get_layer(key), key);
+#if !defined(NO_ACTION_LAYER) && defined(LAYER_CACHE_ENABLE)
+    layer_cache_lookup(key);
+    return layer_cache_action[key.row][key.col];
+#else
+    action_t action;
+    layer_switch_resolve(key, &action);
+    return action;
+#endif
 }
@@ -80,6 +80,14 @@ uint8_t read_source_layers_cache(keypos_t key);
 #endif
 action_t store_or_get_action(bool pressed, keypos_t key);
 
+/* resolved layer/action cache, see LAYER_CACHE_ENABLE */
+#if !defined(NO_ACTION_LAYER) && defined(LAYER_CACHE_ENABLE)
+/* call when something other than the layer state changes what keys resolve to */
+void layer_cache_invalidate(void);
+#else
+#define layer_cache_invalidate()
+#endif
+
 /* return the topmost non-transparent layer currently associated with key */
 int8_t layer_switch_get_layer(keypos_t key);
 
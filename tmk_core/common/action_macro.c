@@ -60,6 +60,8 @@ void action_macro_play(const macro_t *macro_p)
             case WAIT:
                 MACRO_READ();
                 dprintf("WAIT(%u)\n", macro);
+                // the host has to see the state we are waiting in
+                flush_keyboard_report();
                 { uint8_t ms = macro; while (ms--) wait_ms(1); }
                 break;
             case INTERVAL:
@@ -79,6 +81,9 @@ void action_macro_play(const macro_t *macro_p)
                 return;
         }
         // interval
+        if (interval) {
+            flush_keyboard_report();
+        }
         { uint8_t ms = interval; while (ms--) wait_ms(1); }
     }
 }
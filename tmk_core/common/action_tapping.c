@@ -5,6 +5,7 @@
 #include "action_tapping.h"
 #include "keycode.h"
 #include "timer.h"
+#include "progmem.h"
 
 #ifdef DEBUG_ACTION
 #include "debug.h"
@@ -18,17 +19,33 @@
 #define IS_TAPPING_PRESSED()    (IS_TAPPING() && tapping_key.event.pressed)
 #define IS_TAPPING_RELEASED()   (IS_TAPPING() && !tapping_key.event.pressed)
 #define IS_TAPPING_KEY(k)       (IS_TAPPING() && KEYEQ(tapping_key.event.key, (k)))
-#define WITHIN_TAPPING_TERM(e)  (TIMER_DIFF_16(e.time, tapping_key.event.time) < TAPPING_TERM)
+#define WITHIN_TAPPING_TERM(e)  (TIMER_DIFF_16(e.time, tapping_key.event.time) < GET_TAPPING_TERM(tapping_key.event.key))
 
 
 static keyrecord_t tapping_key = {};
+#ifdef RETRO_TAPPING
+/* tap key settled as hold by timeout, taps on release unless interrupted */
+static keyrecord_t retro_tapping_key = {};
+#endif
 static keyrecord_t waiting_buffer[WAITING_BUFFER_SIZE] = {};
 static uint8_t waiting_buffer_head = 0;
 static uint8_t waiting_buffer_tail = 0;
 
+/* Summary of the waiting buffer, kept up to date on enq/deq so that queries
+ * made for every event and tick don't have to walk the buffer.
+ * A key bit is set while the buffer holds at least one such event of the key.
+ */
+#define WAITING_KEY_BYTES   ((MATRIX_ROWS * MATRIX_COLS + 7) / 8)
+static uint8_t waiting_pressed_keys[WAITING_KEY_BYTES];
+static uint8_t waiting_released_keys[WAITING_KEY_BYTES];
+static uint8_t waiting_buffer_pressed = 0;
+// events of keys outside the matrix, queries fall back to a scan for them
+static uint8_t waiting_buffer_offmatrix = 0;
+
 static bool process_tapping(keyrecord_t *record);
 static bool waiting_buffer_enq(keyrecord_t record);
-static void waiting_buffer_clear(void);
+static void waiting_buffer_deq(void);
+static void waiting_buffer_process(void);
 static bool waiting_buffer_typed(keyevent_t event);
 static bool waiting_buffer_has_anykey_pressed(void);
 static void waiting_buffer_scan_tap(void);
@@ -36,6 +53,18 @@ static void debug_tapping_key(void);
 static void debug_waiting_buffer(void);
 
 
+#ifdef TAPPING_TERM_PER_KEY
+uint16_t get_tapping_term(keypos_t key)
+{
+    if (key.row >= MATRIX_ROWS || key.col >= MATRIX_COLS) {
+        return TAPPING_TERM;
+    }
+    uint16_t term = pgm_read_word(&tapping_terms[key.row][key.col]);
+    return term ? term : TAPPING_TERM;
+}
+#endif
+
+
 void action_tapping_process(keyrecord_t record)
 {
     if (process_tapping(&record)) {
@@ -43,12 +72,16 @@ void action_tapping_process(keyrecord_t record)
             debug("processed: "); debug_record(record); debug("\n");
         }
     } else {
-        if (!waiting_buffer_enq(record)) {
-            // clear all in case of overflow.
-            debug("OVERFLOW: CLEAR ALL STATES\n");
-            clear_keyboard();
-            waiting_buffer_clear();
+        while (!waiting_buffer_enq(record)) {
+            // Settle the tapping key as hold to make room, as if TAPPING_TERM
+            // had passed, rather than losing what is waiting.
+            // The first waiting event always goes through after this.
+            debug("OVERFLOW: SETTLE TAPPING KEY\n");
+            if (IS_TAPPING_PRESSED() && tapping_key.tap.count == 0) {
+                process_record(&tapping_key);
+            }
             tapping_key = (keyrecord_t){};
+            waiting_buffer_process();
         }
     }
 
@@ -56,14 +89,7 @@ void action_tapping_process(keyrecord_t record)
     if (!IS_NOEVENT(record.event) && waiting_buffer_head != waiting_buffer_tail) {
         debug("---- action_exec: process waiting_buffer -----\n");
     }
-    for (; waiting_buffer_tail != waiting_buffer_head; waiting_buffer_tail = (waiting_buffer_tail + 1) % WAITING_BUFFER_SIZE) {
-        if (process_tapping(&waiting_buffer[waiting_buffer_tail])) {
-            debug("processed: waiting_buffer["); debug_dec(waiting_buffer_tail); debug("] = ");
-            debug_record(waiting_buffer[waiting_buffer_tail]); debug("\n\n");
-        } else {
-            break;
-        }
-    }
+    waiting_buffer_process();
     if (!IS_NOEVENT(record.event)) {
         debug("\n");
     }
@@ -80,6 +106,12 @@ bool process_tapping(keyrecord_t *keyp)
 {
     keyevent_t event = keyp->event;
 
+#ifdef RETRO_TAPPING
+    if (IS_PRESSED(event)) {
+        retro_tapping_key = (keyrecord_t){};
+    }
+#endif
+
     // if tapping
     if (IS_TAPPING_PRESSED()) {
         if (WITHIN_TAPPING_TERM(event)) {
@@ -96,7 +128,7 @@ bool process_tapping(keyrecord_t *keyp)
                     // enqueue
                     return false;
                 }
-#if TAPPING_TERM >= 500
+#if TAPPING_TERM >= 500 || defined(PERMISSIVE_HOLD)
                 /* Process a key typed within TAPPING_TERM
                  * This can register the key before settlement of tapping,
                  * useful for long TAPPING_TERM but may prevent fast typing.
@@ -138,6 +170,12 @@ bool process_tapping(keyrecord_t *keyp)
                     // set interrupted flag when other key preesed during tapping
                     if (event.pressed) {
                         tapping_key.tap.interrupted = true;
+#ifdef HOLD_ON_OTHER_KEY_PRESS
+                        debug("Tapping: End. No tap. Other key pressed\n");
+                        process_record(&tapping_key);
+                        tapping_key = (keyrecord_t){};
+                        debug_tapping_key();
+#endif
                     }
                     // enqueue
                     return false;
@@ -186,6 +224,11 @@ bool process_tapping(keyrecord_t *keyp)
                 debug("Tapping: End. Timeout. Not tap(0): ");
                 debug_event(event); debug("\n");
                 process_record(&tapping_key);
+#ifdef RETRO_TAPPING
+                if (!tapping_key.tap.interrupted) {
+                    retro_tapping_key = tapping_key;
+                }
+#endif
                 tapping_key = (keyrecord_t){};
                 debug_tapping_key();
                 return false;
@@ -281,6 +324,18 @@ bool process_tapping(keyrecord_t *keyp)
             return true;
         } else {
             process_record(keyp);
+#ifdef RETRO_TAPPING
+            if (IS_RELEASED(event) && KEYEQ(event.key, retro_tapping_key.event.key) &&
+                    !IS_NOEVENT(retro_tapping_key.event)) {
+                debug("Tapping: Retro tap.\n");
+                retro_tapping_key = (keyrecord_t){};
+                keyrecord_t tap = { .event = event, .tap = { .count = 1 } };
+                tap.event.pressed = true;
+                process_record(&tap);
+                tap.event.pressed = false;
+                process_record(&tap);
+            }
+#endif
             return true;
         }
     }
@@ -290,6 +345,32 @@ bool process_tapping(keyrecord_t *keyp)
 /*
  * Waiting buffer
  */
+static inline bool key_in_matrix(keypos_t key)
+{
+    return key.row < MATRIX_ROWS && key.col < MATRIX_COLS;
+}
+
+static inline uint16_t key_index(keypos_t key)
+{
+    return key.row * MATRIX_COLS + key.col;
+}
+
+static inline bool key_bit(uint8_t *keys, keypos_t key)
+{
+    uint16_t i = key_index(key);
+    return keys[i / 8] & (1 << (i % 8));
+}
+
+static inline void set_key_bit(uint8_t *keys, keypos_t key, bool on)
+{
+    uint16_t i = key_index(key);
+    if (on) {
+        keys[i / 8] |= (1 << (i % 8));
+    } else {
+        keys[i / 8] &= ~(1 << (i % 8));
+    }
+}
+
 bool waiting_buffer_enq(keyrecord_t record)
 {
     if (IS_NOEVENT(record.event)) {
@@ -304,18 +385,59 @@ bool waiting_buffer_enq(keyrecord_t record)
     waiting_buffer[waiting_buffer_head] = record;
     waiting_buffer_head = (waiting_buffer_head + 1) % WAITING_BUFFER_SIZE;
 
+    keyevent_t event = record.event;
+    if (event.pressed) waiting_buffer_pressed++;
+    if (key_in_matrix(event.key)) {
+        set_key_bit(event.pressed ? waiting_pressed_keys : waiting_released_keys, event.key, true);
+    } else {
+        waiting_buffer_offmatrix++;
+    }
+
     debug("waiting_buffer_enq: "); debug_waiting_buffer();
     return true;
 }
 
-void waiting_buffer_clear(void)
+/* remove the oldest event */
+void waiting_buffer_deq(void)
 {
-    waiting_buffer_head = 0;
-    waiting_buffer_tail = 0;
+    keyevent_t event = waiting_buffer[waiting_buffer_tail].event;
+    waiting_buffer_tail = (waiting_buffer_tail + 1) % WAITING_BUFFER_SIZE;
+
+    if (event.pressed) waiting_buffer_pressed--;
+    if (!key_in_matrix(event.key)) {
+        waiting_buffer_offmatrix--;
+        return;
+    }
+    // the bit stays while a later event of the same key is still waiting
+    for (uint8_t i = waiting_buffer_tail; i != waiting_buffer_head; i = (i + 1) % WAITING_BUFFER_SIZE) {
+        if (KEYEQ(event.key, waiting_buffer[i].event.key) && event.pressed == waiting_buffer[i].event.pressed) {
+            return;
+        }
+    }
+    set_key_bit(event.pressed ? waiting_pressed_keys : waiting_released_keys, event.key, false);
+}
+
+/* process waiting events until one needs the tapping key settled first */
+void waiting_buffer_process(void)
+{
+    while (waiting_buffer_tail != waiting_buffer_head) {
+        if (!process_tapping(&waiting_buffer[waiting_buffer_tail])) {
+            break;
+        }
+        debug("processed: waiting_buffer["); debug_dec(waiting_buffer_tail); debug("] = ");
+        debug_record(waiting_buffer[waiting_buffer_tail]); debug("\n\n");
+        waiting_buffer_deq();
+    }
 }
 
 bool waiting_buffer_typed(keyevent_t event)
 {
+    if (key_in_matrix(event.key)) {
+        return key_bit(event.pressed ? waiting_released_keys : waiting_pressed_keys, event.key);
+    }
+    if (!waiting_buffer_offmatrix) {
+        return false;
+    }
     for (uint8_t i = waiting_buffer_tail; i != waiting_buffer_head; i = (i + 1) % WAITING_BUFFER_SIZE) {
         if (KEYEQ(event.key, waiting_buffer[i].event.key) && event.pressed !=  waiting_buffer[i].event.pressed) {
             return true;
@@ -327,10 +449,7 @@ bool waiting_buffer_typed(keyevent_t event)
 __attribute__((unused))
 bool waiting_buffer_has_anykey_pressed(void)
 {
-    for (uint8_t i = waiting_buffer_tail; i != waiting_buffer_head; i = (i + 1) % WAITING_BUFFER_SIZE) {
-        if (waiting_buffer[i].event.pressed) return true;
-    }
-    return false;
+    return waiting_buffer_pressed > 0;
 }
 
 /* scan buffer for tapping */
@@ -340,6 +459,8 @@ void waiting_buffer_scan_tap(void)
     if (tapping_key.tap.count > 0) return;
     // invalid state: tapping_key released && tap.count == 0
     if (!tapping_key.event.pressed) return;
+    // release of the tapping key is not waiting
+    if (key_in_matrix(tapping_key.event.key) && !key_bit(waiting_released_keys, tapping_key.event.key)) return;
 
     for (uint8_t i = waiting_buffer_tail; i != waiting_buffer_head; i = (i + 1) % WAITING_BUFFER_SIZE) {
         if (IS_TAPPING_KEY(waiting_buffer[i].event.key) &&
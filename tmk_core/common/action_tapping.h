@@ -17,6 +17,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef ACTION_TAPPING_H
 #define ACTION_TAPPING_H
 
+#include <stdint.h>
+#include "keyboard.h"
 
 
 /* period of tapping(ms) */
@@ -24,12 +26,38 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define TAPPING_TERM    200
 #endif
 
+/* Per key tapping term
+ *
+ * With TAPPING_TERM_PER_KEY the keymap provides a table laid out like the
+ * keymaps, e.g. with the KEYMAP() macro of the keyboard. 0 means TAPPING_TERM.
+ *
+ *   const uint16_t PROGMEM tapping_terms[MATRIX_ROWS][MATRIX_COLS] = KEYMAP(...);
+ *
+ * Resolution policies for a tap key, all off by default:
+ *   PERMISSIVE_HOLD          hold when another key is pressed and released
+ *                            while the tap key is down
+ *   HOLD_ON_OTHER_KEY_PRESS  hold as soon as another key is pressed while the
+ *                            tap key is down
+ *   RETRO_TAPPING            tap when the tap key is released after the
+ *                            tapping term without any other key pressed
+ */
+#ifdef TAPPING_TERM_PER_KEY
+extern const uint16_t tapping_terms[MATRIX_ROWS][MATRIX_COLS];
+uint16_t get_tapping_term(keypos_t key);
+#   define GET_TAPPING_TERM(key)    get_tapping_term(key)
+#else
+#   define GET_TAPPING_TERM(key)    TAPPING_TERM
+#endif
+
 /* tap count needed for toggling a feature */
 #ifndef TAPPING_TOGGLE
 #define TAPPING_TOGGLE  5
 #endif
 
+/* events that can wait for the tapping key to settle, one slot stays free */
+#ifndef WAITING_BUFFER_SIZE
 #define WAITING_BUFFER_SIZE 8
+#endif
 
 
 #ifndef NO_ACTION_TAPPING
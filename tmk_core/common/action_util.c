@@ -14,6 +14,7 @@ GNU General Public License for more details.
 You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include <string.h>
 #include "host.h"
 #include "report.h"
 #include "debug.h"
@@ -50,6 +51,18 @@ static int8_t cb_count = 0;
 //report_keyboard_t keyboard_report = {};
 report_keyboard_t *keyboard_report = &(report_keyboard_t){};
 
+/* Report staging
+ *
+ * send_keyboard_report() only stages the report and keyboard_task() flushes it
+ * once per pass, so an action changing mods and keys together reaches the host
+ * as a single report. Reports equal to the last one sent are dropped. A staged
+ * change is flushed early when the next one would undo it, so a key pressed and
+ * released within one pass is still seen by the host.
+ */
+static report_keyboard_t staged_report = {};
+static report_keyboard_t sent_report = {};
+static bool report_staged = false;
+
 #ifndef NO_ACTION_ONESHOT
 static int8_t oneshot_mods = 0;
 static int8_t oneshot_locked_mods = 0;
@@ -117,6 +130,46 @@ bool is_oneshot_layer_active(void)
 }
 #endif
 
+static bool report_has_key(const report_keyboard_t *report, uint8_t key)
+{
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (report->keys[i] == key) return true;
+    }
+    return false;
+}
+
+/* true when report changes back something the staged report changed */
+static bool report_undoes_staged(const report_keyboard_t *report)
+{
+    if ((staged_report.mods ^ sent_report.mods) & (report->mods ^ staged_report.mods)) {
+        return true;
+    }
+#ifdef NKRO_ENABLE
+    if (keyboard_protocol && keymap_config.nkro) {
+        for (uint8_t i = 0; i < KEYBOARD_REPORT_BITS; i++) {
+            if ((staged_report.nkro.bits[i] ^ sent_report.nkro.bits[i]) &
+                (report->nkro.bits[i] ^ staged_report.nkro.bits[i])) {
+                return true;
+            }
+        }
+        return false;
+    }
+#endif
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        // keys only pressed in the staged report
+        uint8_t key = staged_report.keys[i];
+        if (key && !report_has_key(&sent_report, key) && !report_has_key(report, key)) {
+            return true;
+        }
+        // keys only released in the staged report
+        key = sent_report.keys[i];
+        if (key && !report_has_key(&staged_report, key) && report_has_key(report, key)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void send_keyboard_report(void) {
     keyboard_report->mods  = real_mods;
     keyboard_report->mods |= weak_mods;
@@ -136,7 +189,24 @@ void send_keyboard_report(void) {
     }
 
 #endif
-    host_keyboard_send(keyboard_report);
+    if (report_staged && report_undoes_staged(keyboard_report)) {
+        flush_keyboard_report();
+    }
+    if (memcmp(keyboard_report, &sent_report, sizeof(report_keyboard_t)) == 0) {
+        // the host already has this state
+        report_staged = false;
+        return;
+    }
+    staged_report = *keyboard_report;
+    report_staged = true;
+}
+
+void flush_keyboard_report(void)
+{
+    if (!report_staged) return;
+    report_staged = false;
+    sent_report = staged_report;
+    host_keyboard_send(&sent_report);
 }
 
 /* key */
@@ -27,6 +27,8 @@ extern "C" {
 extern report_keyboard_t *keyboard_report;
 
 void send_keyboard_report(void);
+/* send the report staged by send_keyboard_report() now, if it changed */
+void flush_keyboard_report(void);
 
 /* key */
 void add_key(uint8_t key);
@@ -0,0 +1,311 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * TWI(I2C) master with a transaction queue, and register file slave, for
+ * the AVR TWI peripheral. See twi.h.
+ */
+
+#include <stddef.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/twi.h>
+#include "config.h"
+#include "twi.h"
+#include "timer.h"
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#define TWCR_ACTIVE (1<<TWINT | 1<<TWEN | 1<<TWIE)
+
+/* master */
+static twi_transaction_t *volatile queue_head = NULL;
+static twi_transaction_t *queue_tail = NULL;
+/* the controller owns the bus, until the last queued transaction is done */
+static volatile bool active = false;
+static uint8_t pos;
+
+/* slave */
+static volatile uint8_t *slave_registers = NULL;
+static uint8_t slave_size;
+static uint8_t slave_pos;
+static bool slave_register_set;
+static bool slave_receiving;
+volatile uint8_t twi_slave_write_sequence = 0;
+
+void twi_init(void)
+{
+    // no prescaler, TWBR needs to be more than 10
+    TWSR = 0;
+    TWBR = ((F_CPU / TWI_SCL_CLOCK) - 16) / 2;
+    TWCR = 1<<TWEN;
+}
+
+static void start(void)
+{
+    // a stop from the last transaction can still be on its way
+    while (TWCR & (1<<TWSTO));
+    TWCR = TWCR_ACTIVE | 1<<TWSTA;
+}
+
+bool twi_submit(twi_transaction_t *transaction)
+{
+    if (transaction->status == TWI_STATUS_PENDING) {
+        return false;
+    }
+    transaction->status = TWI_STATUS_PENDING;
+    transaction->next = NULL;
+
+    uint8_t sreg = SREG;
+    cli();
+    if (queue_head) {
+        queue_tail->next = transaction;
+    } else {
+        queue_head = transaction;
+    }
+    queue_tail = transaction;
+    if (!active) {
+        active = true;
+        start();
+    }
+    SREG = sreg;
+    return true;
+}
+
+bool twi_is_idle(void)
+{
+    return !active;
+}
+
+/* Called with interrupts off */
+static void finish(uint8_t status)
+{
+    twi_transaction_t *t = queue_head;
+    queue_head = t->next;
+    t->next = NULL;
+    t->status = status;
+    // the callback can queue the next transaction, which then follows with
+    // a stop and a start
+    if (t->callback) {
+        t->callback(t);
+    }
+    if (queue_head) {
+        TWCR = TWCR_ACTIVE | 1<<TWSTO | 1<<TWSTA;
+    } else {
+        active = false;
+        TWCR = 1<<TWINT | 1<<TWEN | 1<<TWSTO | (slave_registers ? (1<<TWIE | 1<<TWEA) : 0);
+    }
+}
+
+void twi_reset(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+    TWCR = 0;
+    while (queue_head) {
+        twi_transaction_t *t = queue_head;
+        queue_head = t->next;
+        t->next = NULL;
+        t->status = TWI_STATUS_BUS_ERROR;
+    }
+    active = false;
+    TWCR = 1<<TWEN | (slave_registers ? (1<<TWIE | 1<<TWEA) : 0);
+    SREG = sreg;
+}
+
+uint8_t twi_wait(twi_transaction_t *transaction)
+{
+    uint16_t start_time = timer_read();
+    while (transaction->status == TWI_STATUS_PENDING) {
+        if (timer_elapsed(start_time) > TWI_TIMEOUT_MS) {
+            // something holds the bus, start over
+            twi_reset();
+            break;
+        }
+    }
+    return transaction->status;
+}
+
+uint8_t twi_write_read(uint8_t address, const uint8_t *write_data, uint8_t write_size,
+                       uint8_t *read_data, uint8_t read_size)
+{
+    twi_transaction_t t = {
+        .address = address,
+        .write_data = write_data,
+        .write_size = write_size,
+        .read_data = read_data,
+        .read_size = read_size,
+        .callback = NULL,
+        .status = TWI_STATUS_DONE,
+    };
+    twi_submit(&t);
+    return twi_wait(&t);
+}
+
+uint8_t twi_write(uint8_t address, const uint8_t *data, uint8_t size)
+{
+    return twi_write_read(address, data, size, NULL, 0);
+}
+
+void twi_slave_init(uint8_t address, volatile uint8_t *registers, uint8_t size)
+{
+    slave_registers = registers;
+    slave_size = size;
+    TWAR = address << 1;
+    TWCR = 1<<TWIE | 1<<TWEA | 1<<TWINT | 1<<TWEN;
+}
+
+static void master_interrupt(uint8_t status)
+{
+    twi_transaction_t *t = queue_head;
+    switch (status) {
+        case TW_START:
+            pos = 0;
+            // a probe without data only sends the address, as a write so that
+            // the device doesn't drive the bus after acknowledging it
+            if (t->write_size || !t->read_size) {
+                TWDR = t->address << 1 | TW_WRITE;
+            } else {
+                TWDR = t->address << 1 | TW_READ;
+            }
+            TWCR = TWCR_ACTIVE;
+            break;
+        case TW_REP_START:
+            pos = 0;
+            TWDR = t->address << 1 | TW_READ;
+            TWCR = TWCR_ACTIVE;
+            break;
+        case TW_MT_SLA_ACK:
+        case TW_MT_DATA_ACK:
+            if (pos < t->write_size) {
+                TWDR = t->write_data[pos++];
+                TWCR = TWCR_ACTIVE;
+            } else if (t->read_size) {
+                TWCR = TWCR_ACTIVE | 1<<TWSTA;
+            } else {
+                finish(TWI_STATUS_DONE);
+            }
+            break;
+        case TW_MR_SLA_ACK:
+            if (!t->read_size) {
+                finish(TWI_STATUS_DONE);
+                break;
+            }
+            // acknowledge all but the last byte
+            TWCR = TWCR_ACTIVE | (t->read_size > 1 ? 1<<TWEA : 0);
+            break;
+        case TW_MR_DATA_ACK:
+            t->read_data[pos++] = TWDR;
+            TWCR = TWCR_ACTIVE | (pos + 1 < t->read_size ? 1<<TWEA : 0);
+            break;
+        case TW_MR_DATA_NACK:
+            t->read_data[pos++] = TWDR;
+            finish(TWI_STATUS_DONE);
+            break;
+        case TW_MT_SLA_NACK:
+        case TW_MR_SLA_NACK:
+            finish(TWI_STATUS_ADDRESS_NACK);
+            break;
+        case TW_MT_DATA_NACK:
+            finish(TWI_STATUS_DATA_NACK);
+            break;
+        case TW_MT_ARB_LOST:
+            // another master won, start over once it's done with the bus
+            TWCR = TWCR_ACTIVE | 1<<TWSTA;
+            break;
+        default:
+            // TW_BUS_ERROR
+            finish(TWI_STATUS_BUS_ERROR);
+            break;
+    }
+}
+
+static void slave_write_done(void)
+{
+    if (slave_receiving) {
+        slave_receiving = false;
+        twi_slave_write_sequence++;
+    }
+}
+
+static void slave_interrupt(uint8_t status)
+{
+    uint8_t ack = 1;
+    uint8_t restart = 0;
+    switch (status) {
+        case TW_SR_ARB_LOST_SLA_ACK:
+        case TW_SR_SLA_ACK:
+            // addressed as a slave receiver, the first byte is the register
+            slave_register_set = false;
+            if (!slave_receiving) {
+                slave_receiving = true;
+                twi_slave_write_sequence++;
+            }
+            break;
+        case TW_SR_DATA_ACK:
+            if (!slave_register_set) {
+                slave_pos = TWDR;
+                // don't acknowledge registers that don't exist
+                if (slave_pos >= slave_size) {
+                    ack = 0;
+                    slave_pos = 0;
+                }
+                slave_register_set = true;
+            } else {
+                slave_registers[slave_pos] = TWDR;
+                slave_pos = (slave_pos + 1) % slave_size;
+            }
+            break;
+        case TW_ST_ARB_LOST_SLA_ACK:
+        case TW_ST_SLA_ACK:
+        case TW_ST_DATA_ACK:
+            TWDR = slave_registers[slave_pos];
+            slave_pos = (slave_pos + 1) % slave_size;
+            break;
+        case TW_SR_DATA_NACK:
+            slave_write_done();
+            break;
+        case TW_SR_STOP:
+            slave_write_done();
+            // fall through
+        case TW_ST_DATA_NACK:
+        case TW_ST_LAST_DATA:
+            // the queued transaction lost the bus to the master that addressed
+            // us, or waited for it, start it once the bus is free
+            restart = active && queue_head;
+            break;
+        case TW_BUS_ERROR:
+            slave_write_done();
+            TWCR = 0;
+            break;
+        default:
+            break;
+    }
+    TWCR = 1<<TWIE | 1<<TWINT | ack<<TWEA | 1<<TWEN | restart<<TWSTA;
+}
+
+ISR(TWI_vect)
+{
+    uint8_t status = TW_STATUS;
+    if (active && queue_head && status < TW_SR_SLA_ACK) {
+        master_interrupt(status);
+    } else if (slave_registers) {
+        slave_interrupt(status);
+    } else {
+        TWCR = 1<<TWINT | 1<<TWEN;
+    }
+}
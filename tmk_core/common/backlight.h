@@ -29,6 +29,8 @@ typedef union {
     };
 } backlight_config_t;
 
+extern backlight_config_t backlight_config;
+
 void backlight_init(void);
 void backlight_increase(void);
 void backlight_decrease(void);
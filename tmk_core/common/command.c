@@ -55,6 +55,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
     #include "audio.h"
 #endif /* AUDIO_ENABLE */
 
+#ifdef SERIAL_LINK_ENABLE
+    #include "serial_link/system/serial_link.h"
+#endif
+
 
 static bool command_common(uint8_t code);
 static void command_common_help(void);
@@ -364,6 +368,7 @@ static bool command_common(uint8_t code)
         // jump to bootloader
         case MAGIC_KC(MAGIC_KEY_BOOTLOADER):
             clear_keyboard(); // clear to prevent stuck keys
+            flush_keyboard_report();
             print("\n\nJumping to bootloader... ");
             #ifdef AUDIO_ENABLE
 	            stop_all_notes();
@@ -532,6 +537,9 @@ static void command_console_help(void)
           "ESC/q:	quit\n"
 #ifdef MOUSEKEY_ENABLE
           "m:	mousekey\n"
+#endif
+#ifdef SERIAL_LINK_ENABLE
+          "l:	serial link statistics\n"
 #endif
     );
 }
@@ -553,6 +561,11 @@ static bool command_console(uint8_t code)
             print("M> ");
             command_state = MOUSEKEY;
             return true;
+#endif
+#ifdef SERIAL_LINK_ENABLE
+        case KC_L:
+            serial_link_print_stats();
+            break;
 #endif
         default:
             print("?");
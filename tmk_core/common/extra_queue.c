@@ -0,0 +1,70 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <string.h>
+#include "extra_queue.h"
+
+#define QUEUE_MASK (EXTRA_QUEUE_SIZE - 1)
+
+static inline uint8_t queue_count(extra_queue_t *queue)
+{
+    return (uint8_t)(queue->head - queue->tail);
+}
+
+void extra_queue_init(extra_queue_t *queue)
+{
+    memset(queue, 0, sizeof(extra_queue_t));
+}
+
+void extra_queue_push(extra_queue_t *queue, uint8_t report_id, uint16_t usage)
+{
+    if (queue_count(queue) >= 2) {
+        extra_queue_entry_t *newest = &queue->entries[(uint8_t)(queue->head - 1) & QUEUE_MASK];
+        extra_queue_entry_t *before = &queue->entries[(uint8_t)(queue->head - 2) & QUEUE_MASK];
+        // the release is only implied by the new usage when the host sees
+        // it change, a second tap of the same key needs its own release
+        if (newest->report_id == report_id && !newest->usage &&
+            before->report_id == report_id && before->usage != usage) {
+            newest->usage = usage;
+            queue->merged++;
+            return;
+        }
+    }
+    if (queue_count(queue) == EXTRA_QUEUE_SIZE) {
+        queue->tail++;
+        queue->dropped++;
+    }
+    queue->entries[queue->head & QUEUE_MASK] = (extra_queue_entry_t){
+        .report_id = report_id,
+        .usage = usage
+    };
+    queue->head++;
+}
+
+extra_queue_entry_t *extra_queue_peek(extra_queue_t *queue)
+{
+    if (queue->head == queue->tail) {
+        return NULL;
+    }
+    return &queue->entries[queue->tail & QUEUE_MASK];
+}
+
+void extra_queue_pop(extra_queue_t *queue)
+{
+    if (queue->head != queue->tail) {
+        queue->tail++;
+    }
+}
@@ -0,0 +1,70 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef EXTRA_QUEUE_H
+#define EXTRA_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Queue of system and consumer reports waiting for the extra key endpoint
+ *
+ * Both report ids share the endpoint and so the queue. A queued release is
+ * replaced by the next usage of the same report id, the host seeing the usage
+ * before the release change straight to the new one. That only loses nothing
+ * when the two usages differ, two taps of the same key keep the release in
+ * between. A full queue drops its oldest report.
+ */
+
+#ifndef EXTRA_QUEUE_SIZE
+#   define EXTRA_QUEUE_SIZE 4
+#endif
+
+#if EXTRA_QUEUE_SIZE < 2 || EXTRA_QUEUE_SIZE > 128 || (EXTRA_QUEUE_SIZE & (EXTRA_QUEUE_SIZE - 1))
+#   error "EXTRA_QUEUE_SIZE must be a power of two between 2 and 128"
+#endif
+
+typedef struct {
+    uint8_t report_id;
+    uint16_t usage;
+} extra_queue_entry_t;
+
+typedef struct {
+    extra_queue_entry_t entries[EXTRA_QUEUE_SIZE];
+    uint8_t head;
+    uint8_t tail;
+    /* usages that replaced a queued release */
+    uint16_t merged;
+    /* reports dropped because the queue was full */
+    uint16_t dropped;
+} extra_queue_t;
+
+void extra_queue_init(extra_queue_t *queue);
+void extra_queue_push(extra_queue_t *queue, uint8_t report_id, uint16_t usage);
+/* oldest report, NULL when the queue is empty */
+extra_queue_entry_t *extra_queue_peek(extra_queue_t *queue);
+/* the report from extra_queue_peek() has been sent */
+void extra_queue_pop(extra_queue_t *queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
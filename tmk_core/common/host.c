@@ -19,6 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //#include <avr/interrupt.h>
 #include "keycode.h"
 #include "host.h"
+#include "action_util.h"
 #include "util.h"
 #include "debug.h"
 
@@ -57,9 +58,12 @@ void host_keyboard_send(report_keyboard_t *report)
     }
 }
 
+/* The keyboard report staged before any other report is sent first, so the
+ * host sees them in the order they happened. */
 void host_mouse_send(report_mouse_t *report)
 {
     if (!driver) return;
+    flush_keyboard_report();
     (*driver->send_mouse)(report);
 }
 
@@ -69,6 +73,7 @@ void host_system_send(uint16_t report)
     last_system_report = report;
 
     if (!driver) return;
+    flush_keyboard_report();
     (*driver->send_system)(report);
 }
 
@@ -78,6 +83,7 @@ void host_consumer_send(uint16_t report)
     last_consumer_report = report;
 
     if (!driver) return;
+    flush_keyboard_report();
     (*driver->send_consumer)(report);
 }
 
@@ -30,6 +30,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "eeconfig.h"
 #include "backlight.h"
 #include "action_layer.h"
+#include "action_util.h"
 #ifdef BOOTMAGIC_ENABLE
 #   include "bootmagic.h"
 #else
@@ -57,6 +58,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #   include "visualizer/visualizer.h"
 #endif
 
+/* Maximum number of key events collected from a single matrix scan.
+ * Changes beyond this are left in the matrix diff and picked up on the
+ * next pass, so nothing is lost when it overflows.
+ */
+#ifndef KEYBOARD_EVENT_BUFFER_SIZE
+#   define KEYBOARD_EVENT_BUFFER_SIZE 16
+#endif
 
 
 #ifdef MATRIX_HAS_GHOST
@@ -122,9 +130,11 @@ void keyboard_task(void)
 #ifdef MATRIX_HAS_GHOST
     static matrix_row_t matrix_ghost[MATRIX_ROWS];
 #endif
+    static keyevent_t events[KEYBOARD_EVENT_BUFFER_SIZE];
     static uint8_t led_status = 0;
     matrix_row_t matrix_row = 0;
     matrix_row_t matrix_change = 0;
+    uint8_t event_count = 0;
 
     matrix_scan();
     for (uint8_t r = 0; r < MATRIX_ROWS; r++) {
@@ -148,23 +158,33 @@ void keyboard_task(void)
             if (debug_matrix) matrix_print();
             for (uint8_t c = 0; c < MATRIX_COLS; c++) {
                 if (matrix_change & ((matrix_row_t)1<<c)) {
-                    action_exec((keyevent_t){
+                    // leave the rest for the next pass when the buffer is full
+                    if (event_count >= KEYBOARD_EVENT_BUFFER_SIZE) {
+                        goto MATRIX_LOOP_END;
+                    }
+                    events[event_count++] = (keyevent_t){
                         .key = (keypos_t){ .row = r, .col = c },
                         .pressed = (matrix_row & ((matrix_row_t)1<<c)),
                         .time = (timer_read() | 1) /* time should not be 0 */
-                    });
-                    // record a processed key
+                    };
+                    // record a collected key
                     matrix_prev[r] ^= ((matrix_row_t)1<<c);
-                    // process a key per task call
-                    goto MATRIX_LOOP_END;
                 }
             }
         }
     }
-    // call with pseudo tick event when no real key event.
-    action_exec(TICK);
 
 MATRIX_LOOP_END:
+    // process every key changed in this scan, in matrix order
+    for (uint8_t i = 0; i < event_count; i++) {
+        action_exec(events[i]);
+    }
+    // call with pseudo tick event when no real key event.
+    if (event_count == 0) {
+        action_exec(TICK);
+    }
+    // one keyboard report for everything that changed in this pass
+    flush_keyboard_report();
 
 #ifdef MOUSEKEY_ENABLE
     // mousekey repeat & acceleration
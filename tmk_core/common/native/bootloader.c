@@ -0,0 +1,4 @@
+#include "bootloader.h"
+
+/* There is nothing to jump to on the host */
+void bootloader_jump(void) {}
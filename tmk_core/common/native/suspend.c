@@ -0,0 +1,14 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "suspend.h"
+
+void suspend_idle(uint8_t time) {}
+
+void suspend_power_down(void) {}
+
+bool suspend_wakeup_condition(void)
+{
+    return false;
+}
+
+void suspend_wakeup_init(void) {}
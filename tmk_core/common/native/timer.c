@@ -0,0 +1,73 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "timer.h"
+#include "timer_native.h"
+#include "wait.h"
+
+// simulated time in microseconds
+static uint64_t now_us = 0;
+
+uint64_t timer_read_us(void)
+{
+    return now_us;
+}
+
+void timer_set_us(uint64_t us)
+{
+    now_us = us;
+}
+
+void timer_advance_us(uint32_t us)
+{
+    now_us += us;
+}
+
+void timer_init(void) {}
+
+void timer_clear(void)
+{
+    now_us = 0;
+}
+
+uint16_t timer_read(void)
+{
+    return (uint16_t)(now_us / 1000);
+}
+
+uint32_t timer_read32(void)
+{
+    return (uint32_t)(now_us / 1000);
+}
+
+uint16_t timer_elapsed(uint16_t last)
+{
+    return TIMER_DIFF_16(timer_read(), last);
+}
+
+uint32_t timer_elapsed32(uint32_t last)
+{
+    return TIMER_DIFF_32(timer_read32(), last);
+}
+
+void wait_ms(uint16_t ms)
+{
+    now_us += (uint32_t)ms * 1000;
+}
+
+void wait_us(uint16_t us)
+{
+    now_us += us;
+}
@@ -0,0 +1,35 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TIMER_NATIVE_H
+#define TIMER_NATIVE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The native timer is a simulated clock: it only moves when the host program
+ * (or wait_ms/wait_us) advances it, which makes runs fully deterministic. */
+uint64_t timer_read_us(void);
+void timer_set_us(uint64_t us);
+void timer_advance_us(uint32_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -3,10 +3,13 @@
 
 #if defined(__AVR__)
 #   include <avr/pgmspace.h>
-#elif defined(__arm__)
+#else
 #   define PROGMEM
-#   define pgm_read_byte(p)     *((unsigned char*)p)
-#   define pgm_read_word(p)     *((uint16_t*)p)
+#   define pgm_read_byte(p)     *((unsigned char*)(p))
+#   define pgm_read_word(p)     *((uint16_t*)(p))
+#   ifndef PSTR
+#       define PSTR(x)          x
+#   endif
 #endif
 
 #endif
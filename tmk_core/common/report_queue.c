@@ -0,0 +1,147 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include "report_queue.h"
+
+#define QUEUE_MASK (REPORT_QUEUE_SIZE - 1)
+
+static inline uint8_t queue_count(report_queue_t *queue)
+{
+    return (uint8_t)(queue->head - queue->tail);
+}
+
+void report_queue_init(report_queue_t *queue, bool nkro)
+{
+    memset(queue, 0, sizeof(report_queue_t));
+    queue->nkro = nkro;
+}
+
+bool report_queue_empty(report_queue_t *queue)
+{
+    return queue->head == queue->tail;
+}
+
+bool report_queue_full(report_queue_t *queue)
+{
+    return queue_count(queue) == REPORT_QUEUE_SIZE;
+}
+
+/* bits pressed in dropped and released again in after, or the other way round */
+static inline uint8_t lost_bits(uint8_t before, uint8_t dropped, uint8_t after)
+{
+    return (dropped & ~before & ~after) | (before & ~dropped & after);
+}
+
+static bool has_key(report_keyboard_t *report, uint8_t code)
+{
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (report->keys[i] == code) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* whether the host misses no press or release when going from before
+ * straight to after, without seeing dropped in between */
+static bool can_collapse(report_queue_t *queue, report_keyboard_t *before, report_keyboard_t *dropped, report_keyboard_t *after)
+{
+    if (lost_bits(before->mods, dropped->mods, after->mods)) {
+        return false;
+    }
+#ifdef NKRO_ENABLE
+    if (queue->nkro) {
+        for (uint8_t i = 0; i < KEYBOARD_REPORT_BITS; i++) {
+            if (lost_bits(before->nkro.bits[i], dropped->nkro.bits[i], after->nkro.bits[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+#else
+    (void)queue;
+#endif
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        uint8_t code = dropped->keys[i];
+        if (code && !has_key(before, code) && !has_key(after, code)) {
+            return false;
+        }
+        code = before->keys[i];
+        if (code && !has_key(dropped, code) && has_key(after, code)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool report_queue_push(report_queue_t *queue, report_keyboard_t *report)
+{
+    if (report_queue_full(queue)) {
+        // a full queue holds at least two reports, so the newest one
+        // has one before it and is not being sent
+        report_keyboard_t *before = &queue->reports[(uint8_t)(queue->head - 2) & QUEUE_MASK];
+        report_keyboard_t *newest = &queue->reports[(uint8_t)(queue->head - 1) & QUEUE_MASK];
+        if (!can_collapse(queue, before, newest, report)) {
+            return false;
+        }
+        *newest = *report;
+        queue->collapsed++;
+        return true;
+    }
+    queue->reports[queue->head & QUEUE_MASK] = *report;
+    queue->head++;
+    return true;
+}
+
+void report_queue_overwrite(report_queue_t *queue, report_keyboard_t *report)
+{
+    if (report_queue_push(queue, report)) {
+        return;
+    }
+    if (queue->sending) {
+        // never drop the report the endpoint is reading, the ones
+        // behind it move up a slot instead
+        for (uint8_t i = queue->tail + 1; i != (uint8_t)(queue->head - 1); i++) {
+            queue->reports[i & QUEUE_MASK] = queue->reports[(uint8_t)(i + 1) & QUEUE_MASK];
+        }
+        queue->head--;
+    } else {
+        queue->tail++;
+    }
+    queue->overflows++;
+    queue->reports[queue->head & QUEUE_MASK] = *report;
+    queue->head++;
+}
+
+report_keyboard_t *report_queue_start(report_queue_t *queue)
+{
+    if (queue->sending || report_queue_empty(queue)) {
+        return NULL;
+    }
+    queue->sending = true;
+    return &queue->reports[queue->tail & QUEUE_MASK];
+}
+
+void report_queue_done(report_queue_t *queue)
+{
+    // the endpoint also completes transfers the queue did not start,
+    // like the idle rate reports
+    if (!queue->sending) {
+        return;
+    }
+    queue->sending = false;
+    queue->tail++;
+}
@@ -0,0 +1,80 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef REPORT_QUEUE_H
+#define REPORT_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "report.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Queue of keyboard reports waiting for an IN endpoint
+ *
+ * The keyboard side pushes reports, the endpoint side takes the oldest one with
+ * report_queue_start() and gives it back with report_queue_done() once the
+ * transfer has completed, so the report stays valid while the hardware sends
+ * it. Pushing never waits. When the queue is full the newest pending report
+ * is replaced by the new one only if that loses no press or release, the host
+ * going straight from the report before it to the new one. Otherwise pushing
+ * fails and the caller has to wait for the endpoint to take a report, a burst
+ * like SEND_STRING has a transition in every report. Only a caller giving up
+ * on a host that stopped polling drops a report, with report_queue_overwrite().
+ *
+ * Pushing and the endpoint callbacks must not interleave, on ChibiOS both run
+ * inside the system lock.
+ */
+
+#ifndef REPORT_QUEUE_SIZE
+#   define REPORT_QUEUE_SIZE 4
+#endif
+
+#if REPORT_QUEUE_SIZE < 2 || REPORT_QUEUE_SIZE > 128 || (REPORT_QUEUE_SIZE & (REPORT_QUEUE_SIZE - 1))
+#   error "REPORT_QUEUE_SIZE must be a power of two between 2 and 128"
+#endif
+
+typedef struct {
+    report_keyboard_t reports[REPORT_QUEUE_SIZE];
+    uint8_t head;
+    uint8_t tail;
+    bool sending;
+    /* the reports carry a bitmap of keys instead of a list */
+    bool nkro;
+    /* reports replaced by a newer one without losing a transition */
+    uint16_t collapsed;
+    /* reports dropped by report_queue_overwrite() */
+    uint16_t overflows;
+} report_queue_t;
+
+void report_queue_init(report_queue_t *queue, bool nkro);
+bool report_queue_empty(report_queue_t *queue);
+bool report_queue_full(report_queue_t *queue);
+/* false when full and the report can not be collapsed without a loss */
+bool report_queue_push(report_queue_t *queue, report_keyboard_t *report);
+/* never fails, drops the oldest pending report when the push does */
+void report_queue_overwrite(report_queue_t *queue, report_keyboard_t *report);
+/* oldest report when the endpoint may start sending it, NULL otherwise */
+report_keyboard_t *report_queue_start(report_queue_t *queue);
+/* the report from report_queue_start() has been sent */
+void report_queue_done(report_queue_t *queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
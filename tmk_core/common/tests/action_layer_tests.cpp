@@ -0,0 +1,157 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+#include <chrono>
+#include <iostream>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+extern "C" {
+#include "action_layer.h"
+}
+
+#ifdef LAYER_CACHE_ENABLE
+static const char* variant = "cached";
+#else
+static const char* variant = "uncached";
+#endif
+
+// Every layer is transparent, except for the keys set up by the tests
+static uint16_t keymap[32][MATRIX_ROWS][MATRIX_COLS];
+static unsigned action_for_key_calls;
+
+extern "C" {
+action_t action_for_key(uint8_t layer, keypos_t key) {
+    action_for_key_calls++;
+    action_t action;
+    action.code = keymap[layer][key.row][key.col];
+    return action;
+}
+
+void clear_keyboard_but_mods(void) {}
+}
+
+static uint64_t read_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+class ActionLayer : public testing::Test {
+public:
+    ActionLayer() {
+        for (int l = 0; l < 32; l++) {
+            for (int r = 0; r < MATRIX_ROWS; r++) {
+                for (int c = 0; c < MATRIX_COLS; c++) {
+                    keymap[l][r][c] = l == 0 ? ACTION_KEY(KC_A + c) : ACTION_TRANSPARENT;
+                }
+            }
+        }
+        layer_clear();
+        default_layer_set(1UL << 0);
+        layer_cache_invalidate();
+        action_for_key_calls = 0;
+    }
+
+    ~ActionLayer() {
+        layer_clear();
+        default_layer_set(0);
+    }
+
+    // What action_exec and process_record_quantum look up for a single event
+    uint16_t lookup_event(keypos_t key) {
+        action_t action = layer_switch_get_action(key);
+        int8_t layer = layer_switch_get_layer(key);
+        return action.code + layer;
+    }
+};
+
+TEST_F(ActionLayer, falls_through_transparent_layers) {
+    layer_on(3);
+    layer_on(7);
+    keymap[3][1][2] = ACTION_KEY(KC_Z);
+    EXPECT_EQ(layer_switch_get_layer((keypos_t){ .col = 2, .row = 1 }), 3);
+    EXPECT_EQ(layer_switch_get_action((keypos_t){ .col = 2, .row = 1 }).code, ACTION_KEY(KC_Z));
+    EXPECT_EQ(layer_switch_get_layer((keypos_t){ .col = 3, .row = 1 }), 0);
+    EXPECT_EQ(layer_switch_get_action((keypos_t){ .col = 3, .row = 1 }).code, ACTION_KEY(KC_D));
+}
+
+TEST_F(ActionLayer, layer_changes_are_seen_by_the_next_lookup) {
+    keypos_t key = { .col = 4, .row = 2 };
+    keymap[5][2][4] = ACTION_KEY(KC_Y);
+    EXPECT_EQ(layer_switch_get_layer(key), 0);
+    layer_on(5);
+    EXPECT_EQ(layer_switch_get_layer(key), 5);
+    EXPECT_EQ(layer_switch_get_action(key).code, ACTION_KEY(KC_Y));
+    layer_off(5);
+    EXPECT_EQ(layer_switch_get_layer(key), 0);
+    // written directly, bypassing layer_on()
+    layer_state = 1UL << 5;
+    EXPECT_EQ(layer_switch_get_layer(key), 5);
+    default_layer_set(1UL << 6);
+    layer_clear();
+    EXPECT_EQ(layer_switch_get_layer(key), 0);
+}
+
+TEST_F(ActionLayer, repeated_lookups_resolve_once_per_layer_state) {
+    layer_on(2);
+    layer_on(9);
+    keypos_t key = { .col = 1, .row = 3 };
+    lookup_event(key);
+    lookup_event(key);
+    lookup_event(key);
+#ifdef LAYER_CACHE_ENABLE
+    // layers 9, 2 and then 0
+    EXPECT_EQ(action_for_key_calls, 3);
+#else
+    EXPECT_EQ(action_for_key_calls, 3 * 2 * 3);
+#endif
+}
+
+TEST_F(ActionLayer, benchmark_lookup_per_event) {
+    const int events = 20000;
+    for (int active : {1, 8, 32}) {
+        layer_clear();
+        for (int l = 1; l < active; l++) {
+            layer_on(l);
+        }
+        uint32_t sink = 0;
+        for (int r = 0; r < MATRIX_ROWS; r++) {
+            for (int c = 0; c < MATRIX_COLS; c++) {
+                sink += lookup_event((keypos_t){ .col = (uint8_t)c, .row = (uint8_t)r });
+            }
+        }
+        action_for_key_calls = 0;
+        uint64_t start = read_cycles();
+        for (int i = 0; i < events; i++) {
+            sink += lookup_event((keypos_t){ .col = (uint8_t)(i % MATRIX_COLS), .row = (uint8_t)((i / MATRIX_COLS) % MATRIX_ROWS) });
+        }
+        uint64_t cycles = read_cycles() - start;
+        EXPECT_NE(sink, 0);
+        std::cout << "[ BENCH    ] " << variant << ", " << active << " active layers: "
+                  << (double)cycles / events << " cycles/event, "
+                  << (double)action_for_key_calls / events << " keymap reads/event" << std::endl;
+#ifdef LAYER_CACHE_ENABLE
+        EXPECT_EQ(action_for_key_calls, 0);
+#else
+        EXPECT_EQ(action_for_key_calls, (unsigned)events * 2 * active);
+#endif
+    }
+}
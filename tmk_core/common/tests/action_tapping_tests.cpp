@@ -0,0 +1,333 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "action.h"
+#include "action_layer.h"
+#include "action_tapping.h"
+}
+
+// keys on row 0 are mod-taps, everything else is a plain key
+static std::vector<keyrecord_t> processed;
+
+#ifdef TAPPING_TERM_PER_KEY
+extern "C" {
+// T (0,0) uses TAPPING_TERM, U (0,1) a short one
+const uint16_t PROGMEM tapping_terms[MATRIX_ROWS][MATRIX_COLS] = {
+    { 0, 100 },
+};
+}
+#endif
+
+extern "C" {
+void process_record(keyrecord_t *record) {
+    if (!IS_NOEVENT(record->event)) processed.push_back(*record);
+}
+
+bool is_tap_key(keypos_t key) {
+    return key.row == 0;
+}
+
+action_t layer_switch_get_action(keypos_t key) {
+    action_t action = { .code = ACTION_KEY(KC_A) };
+    if (key.row == 0) action.code = ACTION_MODS_TAP_KEY(MOD_LSFT, KC_A);
+    return action;
+}
+
+void debug_event(keyevent_t event) {}
+void debug_record(keyrecord_t record) {}
+void clear_keyboard(void) {}
+}
+
+class Tapping : public testing::Test {
+public:
+    Tapping() : time(1) {
+        processed.clear();
+    }
+
+    ~Tapping() {
+        // let any tapping state time out
+        wait(TAPPING_TERM * 2);
+    }
+
+    void event(uint8_t row, uint8_t col, bool pressed) {
+        keyrecord_t record = {};
+        record.event.key = (keypos_t){ .col = col, .row = row };
+        record.event.pressed = pressed;
+        record.event.time = time | 1;
+        action_tapping_process(record);
+    }
+
+    void press(uint8_t row, uint8_t col) { event(row, col, true); }
+    void release(uint8_t row, uint8_t col) { event(row, col, false); }
+
+    void wait(uint16_t ms) {
+        for (uint16_t i = 0; i < ms; i++) {
+            time++;
+            keyrecord_t record = {};
+            record.event.key = (keypos_t){ .col = 255, .row = 255 };
+            record.event.time = time | 1;
+            action_tapping_process(record);
+        }
+    }
+
+    static bool is(const keyrecord_t& record, uint8_t row, uint8_t col, bool pressed, uint8_t count) {
+        return record.event.key.row == row && record.event.key.col == col &&
+               record.event.pressed == pressed && record.tap.count == count;
+    }
+
+    uint16_t time;
+};
+
+TEST_F(Tapping, tap_within_term) {
+    press(0, 0);
+    wait(50);
+    release(0, 0);
+    ASSERT_EQ(processed.size(), 2u);
+    EXPECT_TRUE(is(processed[0], 0, 0, true, 1));
+    EXPECT_TRUE(is(processed[1], 0, 0, false, 1));
+}
+
+TEST_F(Tapping, hold_after_term) {
+    press(0, 0);
+    wait(TAPPING_TERM + 10);
+    ASSERT_EQ(processed.size(), 1u);
+    EXPECT_TRUE(is(processed[0], 0, 0, true, 0));
+    release(0, 0);
+#ifdef RETRO_TAPPING
+    ASSERT_EQ(processed.size(), 4u);
+    EXPECT_TRUE(is(processed[2], 0, 0, true, 1));
+    EXPECT_TRUE(is(processed[3], 0, 0, false, 1));
+#else
+    ASSERT_EQ(processed.size(), 2u);
+#endif
+    EXPECT_TRUE(is(processed[1], 0, 0, false, 0));
+}
+
+#if !defined(PERMISSIVE_HOLD) && !defined(HOLD_ON_OTHER_KEY_PRESS)
+TEST_F(Tapping, key_typed_while_tapping_waits) {
+    press(0, 0);
+    wait(10);
+    press(1, 1);
+    wait(10);
+    release(1, 1);
+    wait(10);
+    EXPECT_TRUE(processed.empty());
+    release(0, 0);
+    ASSERT_EQ(processed.size(), 4u);
+    EXPECT_TRUE(is(processed[0], 0, 0, true, 1));
+    EXPECT_TRUE(is(processed[1], 1, 1, true, 0));
+    EXPECT_TRUE(is(processed[2], 1, 1, false, 0));
+    EXPECT_TRUE(is(processed[3], 0, 0, false, 1));
+}
+#endif
+
+TEST_F(Tapping, release_of_key_pressed_before_is_not_delayed) {
+    press(1, 1);
+    press(0, 0);
+    wait(10);
+    release(1, 1);
+    ASSERT_EQ(processed.size(), 2u);
+    EXPECT_TRUE(is(processed[1], 1, 1, false, 0));
+    release(0, 0);
+    EXPECT_TRUE(is(processed.back(), 0, 0, false, 1));
+}
+
+TEST_F(Tapping, overflow_settles_as_hold_without_losing_keys) {
+    press(0, 0);
+    for (uint8_t col = 0; col < WAITING_BUFFER_SIZE * 2; col++) {
+        wait(2);
+        press(1, col);
+        wait(2);
+        release(1, col);
+    }
+    ASSERT_FALSE(processed.empty());
+    EXPECT_TRUE(is(processed[0], 0, 0, true, 0));
+    release(0, 0);
+
+    ASSERT_EQ(processed.size(), 2u + WAITING_BUFFER_SIZE * 4);
+    for (uint8_t col = 0; col < WAITING_BUFFER_SIZE * 2; col++) {
+        EXPECT_TRUE(is(processed[1 + col * 2], 1, col, true, 0));
+        EXPECT_TRUE(is(processed[2 + col * 2], 1, col, false, 0));
+    }
+    EXPECT_TRUE(is(processed.back(), 0, 0, false, 0));
+}
+
+// Fast rolls over several tap keys and plain keys must neither drop a press
+// nor leave a key down once everything is released.
+TEST_F(Tapping, random_rolls_leave_nothing_stuck) {
+    std::mt19937 rng(2016);
+    for (int round = 0; round < 200; round++) {
+        processed.clear();
+        std::vector<std::pair<uint8_t, uint8_t>> down;
+        int plain_presses = 0;
+        for (int i = 0; i < 40; i++) {
+            bool do_press = down.empty() || (down.size() < 6 && rng() % 2);
+            if (do_press) {
+                uint8_t row = rng() % 3;
+                uint8_t col = rng() % 8;
+                bool held = false;
+                for (auto& k : down) held |= (k.first == row && k.second == col);
+                if (held) continue;
+                down.push_back({row, col});
+                if (row) plain_presses++;
+                press(row, col);
+            } else {
+                size_t i = rng() % down.size();
+                release(down[i].first, down[i].second);
+                down.erase(down.begin() + i);
+            }
+            wait(rng() % 40);
+        }
+        for (auto& k : down) {
+            release(k.first, k.second);
+            wait(rng() % 40);
+        }
+        wait(TAPPING_TERM * 2);
+
+        std::map<std::pair<uint8_t, uint8_t>, bool> state;
+        int plain_processed = 0;
+        for (auto& r : processed) {
+            state[{r.event.key.row, r.event.key.col}] = r.event.pressed;
+            if (r.event.key.row && r.event.pressed) plain_processed++;
+        }
+        EXPECT_EQ(plain_processed, plain_presses) << "round " << round;
+        for (auto& s : state) {
+            EXPECT_FALSE(s.second) << "round " << round << " stuck " << (int)s.first.first << "," << (int)s.first.second;
+        }
+    }
+}
+
+/* Tapping corpus
+ *
+ * Input: "T+" presses and "T-" releases a key, a number waits that many ms.
+ * T and U are mod-taps, a and b plain keys.
+ * Output: the processed events, "v" press and "^" release followed by the
+ * tap count for tap keys.
+ */
+struct TappingCase {
+    const char *name;
+    const char *input;
+    const char *expected;
+    const char *permissive_hold;
+    const char *hold_on_other_key_press;
+    const char *retro_tapping;
+};
+
+static const TappingCase corpus[] = {
+    { "tap",
+      "T+ 50 T-",
+      "Tv1 T^1", nullptr, nullptr, nullptr },
+    { "hold",
+      "T+ 250 T-",
+      "Tv0 T^0", nullptr, nullptr, "Tv0 T^0 Tv1 T^1" },
+    { "hold then type",
+      "T+ 250 a+ 20 a- 20 T-",
+      "Tv0 av a^ T^0", nullptr, nullptr, nullptr },
+    { "nested within term",
+      "T+ 30 a+ 30 a- 30 T-",
+      "Tv1 av a^ T^1", "Tv0 av a^ T^0", "Tv0 av a^ T^0", nullptr },
+    { "roll",
+      "T+ 30 a+ 30 T- 30 a-",
+      "Tv1 av T^1 a^", nullptr, "Tv0 av T^0 a^", nullptr },
+    { "nested past term",
+      "T+ 30 a+ 250 a- 10 T-",
+      "Tv0 av a^ T^0", nullptr, nullptr, nullptr },
+    { "double tap",
+      "T+ 30 T- 30 T+ 30 T-",
+      "Tv1 T^1 Tv2 T^2", nullptr, nullptr, nullptr },
+    { "roll two mod-taps",
+      "T+ 20 U+ 20 T- 20 U-",
+      "Tv1 T^1 Uv1 U^1", nullptr, "Tv0 Uv1 T^0 U^1", nullptr },
+    { "mod-tap typed after plain key",
+      "a+ 20 T+ 20 a- 20 T-",
+      "av a^ Tv1 T^1", nullptr, nullptr, nullptr },
+    { "shifted pair",
+      "T+ 40 a+ 20 a- 20 b+ 20 b- 250 T-",
+      "Tv0 av a^ bv b^ T^0", nullptr, nullptr, nullptr },
+};
+
+class TappingCorpus : public Tapping {
+public:
+    std::string run(const char *input) {
+        std::istringstream tokens(input);
+        std::string token;
+        while (tokens >> token) {
+            char c = token[0];
+            if (c >= '0' && c <= '9') {
+                wait(std::stoi(token));
+                continue;
+            }
+            wait(1);
+            keypos_t key = position(c);
+            event(key.row, key.col, token[1] == '+');
+        }
+        wait(TAPPING_TERM * 2);
+
+        std::string output;
+        for (auto& record : processed) {
+            if (!output.empty()) output += " ";
+            output += name(record.event.key);
+            output += record.event.pressed ? "v" : "^";
+            if (record.event.key.row == 0) output += std::to_string(record.tap.count);
+        }
+        processed.clear();
+        return output;
+    }
+
+    static keypos_t position(char c) {
+        switch (c) {
+            case 'T': return (keypos_t){ .col = 0, .row = 0 };
+            case 'U': return (keypos_t){ .col = 1, .row = 0 };
+            case 'a': return (keypos_t){ .col = 0, .row = 1 };
+            default:  return (keypos_t){ .col = 1, .row = 1 };
+        }
+    }
+
+    static char name(keypos_t key) {
+        return key.row == 0 ? "TU"[key.col] : "ab"[key.col];
+    }
+};
+
+TEST_F(TappingCorpus, resolves_like_the_table) {
+    for (auto& c : corpus) {
+        const char *expected = c.expected;
+#if defined(PERMISSIVE_HOLD)
+        if (c.permissive_hold) expected = c.permissive_hold;
+#elif defined(HOLD_ON_OTHER_KEY_PRESS)
+        if (c.hold_on_other_key_press) expected = c.hold_on_other_key_press;
+#elif defined(RETRO_TAPPING)
+        if (c.retro_tapping) expected = c.retro_tapping;
+#endif
+        EXPECT_EQ(run(c.input), expected) << c.name << ": " << c.input;
+    }
+}
+
+#ifdef TAPPING_TERM_PER_KEY
+TEST_F(TappingCorpus, uses_the_term_of_the_key) {
+    EXPECT_EQ(run("T+ 150 T-"), "Tv1 T^1");
+    EXPECT_EQ(run("U+ 150 U-"), "Uv0 U^0");
+    EXPECT_EQ(run("U+ 50 U-"), "Uv1 U^1");
+    EXPECT_EQ(get_tapping_term((keypos_t){ .col = 5, .row = 3 }), TAPPING_TERM);
+    EXPECT_EQ(get_tapping_term((keypos_t){ .col = 255, .row = 255 }), TAPPING_TERM);
+}
+#endif
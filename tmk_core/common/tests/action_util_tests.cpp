@@ -0,0 +1,180 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+#include <vector>
+#include <string>
+
+extern "C" {
+#include "action_util.h"
+#include "host.h"
+#include "host_driver.h"
+#include "keycode.h"
+#include "keycode_config.h"
+}
+
+static std::vector<report_keyboard_t> sent;
+// The kind of every report sent, in order
+static std::string kinds;
+
+static host_driver_t driver = {
+    [](void) -> uint8_t { return 0; },
+    [](report_keyboard_t* report) { sent.push_back(*report); kinds += 'k'; },
+    [](report_mouse_t*) { kinds += 'm'; },
+    [](uint16_t) { kinds += 's'; },
+    [](uint16_t) { kinds += 'c'; },
+};
+
+extern "C" {
+keymap_config_t keymap_config;
+
+void layer_on(uint8_t layer) {}
+void layer_off(uint8_t layer) {}
+}
+
+class ReportStaging : public testing::Test {
+public:
+    ReportStaging() {
+        host_set_driver(&driver);
+        sent.clear();
+        kinds.clear();
+    }
+
+    ~ReportStaging() {
+        clear_mods();
+        clear_weak_mods();
+        clear_macro_mods();
+        clear_keys();
+        send_keyboard_report();
+        flush_keyboard_report();
+        host_system_send(0);
+        host_consumer_send(0);
+    }
+
+    static bool has_key(const report_keyboard_t& report, uint8_t key) {
+        for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+            if (report.keys[i] == key) return true;
+        }
+        return false;
+    }
+};
+
+TEST_F(ReportStaging, nothing_is_sent_before_a_flush) {
+    add_key(KC_A);
+    send_keyboard_report();
+    EXPECT_TRUE(sent.empty());
+    flush_keyboard_report();
+    ASSERT_EQ(sent.size(), 1);
+    EXPECT_TRUE(has_key(sent[0], KC_A));
+}
+
+TEST_F(ReportStaging, mod_and_key_are_sent_as_one_report) {
+    add_mods(MOD_BIT(KC_LSFT));
+    send_keyboard_report();
+    add_key(KC_A);
+    send_keyboard_report();
+    flush_keyboard_report();
+    ASSERT_EQ(sent.size(), 1);
+    EXPECT_EQ(sent[0].mods, MOD_BIT(KC_LSFT));
+    EXPECT_TRUE(has_key(sent[0], KC_A));
+}
+
+TEST_F(ReportStaging, unchanged_report_is_not_sent_again) {
+    add_key(KC_A);
+    send_keyboard_report();
+    flush_keyboard_report();
+    send_keyboard_report();
+    flush_keyboard_report();
+    EXPECT_EQ(sent.size(), 1);
+}
+
+TEST_F(ReportStaging, change_that_is_undone_before_the_flush_is_dropped_only_if_unsent) {
+    add_key(KC_A);
+    send_keyboard_report();
+    flush_keyboard_report();
+    add_mods(MOD_BIT(KC_LCTL));
+    del_mods(MOD_BIT(KC_LCTL));
+    send_keyboard_report();
+    flush_keyboard_report();
+    EXPECT_EQ(sent.size(), 1);
+}
+
+TEST_F(ReportStaging, tap_within_one_pass_reaches_the_host) {
+    add_key(KC_A);
+    send_keyboard_report();
+    del_key(KC_A);
+    send_keyboard_report();
+    flush_keyboard_report();
+    ASSERT_EQ(sent.size(), 2);
+    EXPECT_TRUE(has_key(sent[0], KC_A));
+    EXPECT_FALSE(has_key(sent[1], KC_A));
+}
+
+TEST_F(ReportStaging, release_and_press_again_within_one_pass_reaches_the_host) {
+    add_key(KC_A);
+    send_keyboard_report();
+    flush_keyboard_report();
+    del_key(KC_A);
+    send_keyboard_report();
+    add_key(KC_A);
+    send_keyboard_report();
+    flush_keyboard_report();
+    ASSERT_EQ(sent.size(), 3);
+    EXPECT_FALSE(has_key(sent[1], KC_A));
+    EXPECT_TRUE(has_key(sent[2], KC_A));
+}
+
+TEST_F(ReportStaging, mod_tap_within_one_pass_reaches_the_host) {
+    add_macro_mods(MOD_BIT(KC_LSFT));
+    send_keyboard_report();
+    add_key(KC_1);
+    send_keyboard_report();
+    del_key(KC_1);
+    send_keyboard_report();
+    del_macro_mods(MOD_BIT(KC_LSFT));
+    send_keyboard_report();
+    flush_keyboard_report();
+    ASSERT_EQ(sent.size(), 2);
+    EXPECT_EQ(sent[0].mods, MOD_BIT(KC_LSFT));
+    EXPECT_TRUE(has_key(sent[0], KC_1));
+    EXPECT_EQ(sent[1].mods, 0);
+    EXPECT_FALSE(has_key(sent[1], KC_1));
+}
+
+TEST_F(ReportStaging, other_reports_go_after_the_staged_keyboard_report) {
+    add_mods(MOD_BIT(KC_LSFT));
+    send_keyboard_report();
+    report_mouse_t mouse = {};
+    mouse.buttons = 1;
+    host_mouse_send(&mouse);
+    add_key(KC_A);
+    send_keyboard_report();
+    host_system_send(1);
+    del_key(KC_A);
+    send_keyboard_report();
+    host_consumer_send(1);
+    flush_keyboard_report();
+    EXPECT_EQ(kinds, "kmkskc");
+    ASSERT_EQ(sent.size(), 3);
+    EXPECT_EQ(sent[0].mods, MOD_BIT(KC_LSFT));
+    EXPECT_TRUE(has_key(sent[1], KC_A));
+    EXPECT_FALSE(has_key(sent[2], KC_A));
+}
+
+TEST_F(ReportStaging, other_reports_flush_nothing_when_nothing_is_staged) {
+    report_mouse_t mouse = {};
+    host_mouse_send(&mouse);
+    EXPECT_EQ(kinds, "m");
+}
@@ -0,0 +1,104 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "gtest/gtest.h"
+#include <vector>
+#include <utility>
+
+extern "C" {
+#include "extra_queue.h"
+}
+
+#define SYSTEM 2
+#define CONSUMER 3
+#define VOLU 0xE9
+#define VOLD 0xEA
+
+// what the host reads from the endpoint, in order
+typedef std::vector<std::pair<uint8_t, uint16_t>> reports_t;
+
+class ExtraQueue : public testing::Test {
+public:
+    ExtraQueue() {
+        extra_queue_init(&queue);
+    }
+
+    void tap(uint16_t usage) {
+        extra_queue_push(&queue, CONSUMER, usage);
+        extra_queue_push(&queue, CONSUMER, 0);
+    }
+
+    reports_t drain() {
+        reports_t host;
+        while (extra_queue_entry_t *entry = extra_queue_peek(&queue)) {
+            host.push_back({entry->report_id, entry->usage});
+            extra_queue_pop(&queue);
+        }
+        return host;
+    }
+
+    extra_queue_t queue;
+};
+
+TEST_F(ExtraQueue, drains_in_order) {
+    extra_queue_push(&queue, CONSUMER, VOLU);
+    extra_queue_push(&queue, SYSTEM, 0x81);
+    EXPECT_EQ(drain(), reports_t({{CONSUMER, VOLU}, {SYSTEM, 0x81}}));
+    EXPECT_EQ(extra_queue_peek(&queue), nullptr);
+}
+
+TEST_F(ExtraQueue, repeated_tap_keeps_the_release_in_between) {
+    tap(VOLU);
+    tap(VOLU);
+    EXPECT_EQ(queue.merged, 0);
+    EXPECT_EQ(drain(), reports_t({{CONSUMER, VOLU}, {CONSUMER, 0}, {CONSUMER, VOLU}, {CONSUMER, 0}}));
+}
+
+TEST_F(ExtraQueue, release_is_replaced_by_a_different_usage) {
+    tap(VOLU);
+    tap(VOLD);
+    EXPECT_EQ(queue.merged, 1);
+    EXPECT_EQ(drain(), reports_t({{CONSUMER, VOLU}, {CONSUMER, VOLD}, {CONSUMER, 0}}));
+}
+
+TEST_F(ExtraQueue, does_not_merge_into_a_release_of_the_other_report_id) {
+    extra_queue_push(&queue, CONSUMER, VOLU);
+    extra_queue_push(&queue, CONSUMER, 0);
+    extra_queue_push(&queue, SYSTEM, 0x81);
+    EXPECT_EQ(queue.merged, 0);
+    EXPECT_EQ(drain(), reports_t({{CONSUMER, VOLU}, {CONSUMER, 0}, {SYSTEM, 0x81}}));
+}
+
+TEST_F(ExtraQueue, does_not_merge_into_a_release_it_can_not_compare) {
+    // the usage before the release has already been sent
+    tap(VOLU);
+    extra_queue_pop(&queue);
+    extra_queue_push(&queue, CONSUMER, VOLU);
+    EXPECT_EQ(queue.merged, 0);
+    EXPECT_EQ(drain(), reports_t({{CONSUMER, 0}, {CONSUMER, VOLU}}));
+}
+
+TEST_F(ExtraQueue, drops_oldest_when_full) {
+    for (uint16_t usage = 1; usage <= EXTRA_QUEUE_SIZE + 1; usage++) {
+        extra_queue_push(&queue, CONSUMER, usage);
+    }
+    EXPECT_EQ(queue.dropped, 1);
+    reports_t expected;
+    for (uint16_t usage = 2; usage <= EXTRA_QUEUE_SIZE + 1; usage++) {
+        expected.push_back({CONSUMER, usage});
+    }
+    EXPECT_EQ(drain(), expected);
+}
@@ -0,0 +1,200 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+#include <vector>
+
+extern "C" {
+#include "keyboard.h"
+#include "matrix.h"
+#include "action.h"
+}
+
+struct recorded_event {
+    uint8_t row;
+    uint8_t col;
+    bool pressed;
+    uint16_t time;
+    unsigned scan;
+};
+
+static bool operator==(const recorded_event& a, const recorded_event& b) {
+    return a.row == b.row && a.col == b.col && a.pressed == b.pressed && a.scan == b.scan;
+}
+
+static std::ostream& operator<<(std::ostream& os, const recorded_event& e) {
+    return os << "(" << (int)e.row << "," << (int)e.col << (e.pressed ? " down" : " up")
+              << " @scan " << e.scan << ")";
+}
+
+class KeyboardTask : public testing::Test {
+public:
+    KeyboardTask() {
+        Instance = this;
+        settle();
+    }
+
+    ~KeyboardTask() {
+        for (auto& row : matrix) {
+            row = 0;
+        }
+        settle();
+        Instance = nullptr;
+    }
+
+    // Run keyboard_task until a pass only produces a tick
+    void settle() {
+        for (int i = 0; i < 10; i++) {
+            events.clear();
+            ticks = 0;
+            keyboard_task();
+            if (events.empty()) {
+                break;
+            }
+        }
+        events.clear();
+        ticks = 0;
+        scans = 0;
+    }
+
+    void press(uint8_t row, uint8_t col) { matrix[row] |= (matrix_row_t)1 << col; }
+    void release(uint8_t row, uint8_t col) { matrix[row] &= ~((matrix_row_t)1 << col); }
+
+    recorded_event down(uint8_t row, uint8_t col, unsigned scan) { return {row, col, true, 0, scan}; }
+    recorded_event up(uint8_t row, uint8_t col, unsigned scan) { return {row, col, false, 0, scan}; }
+
+    static KeyboardTask* Instance;
+
+    matrix_row_t matrix[MATRIX_ROWS] = {};
+    std::vector<recorded_event> events;
+    unsigned scans = 0;
+    unsigned ticks = 0;
+    uint16_t now = 100;
+};
+
+KeyboardTask* KeyboardTask::Instance = nullptr;
+
+extern "C" {
+uint8_t matrix_scan(void) {
+    KeyboardTask::Instance->scans++;
+    KeyboardTask::Instance->now += 10;
+    return 1;
+}
+
+matrix_row_t matrix_get_row(uint8_t row) {
+    return KeyboardTask::Instance->matrix[row];
+}
+
+void action_exec(keyevent_t event) {
+    if (IS_NOEVENT(event)) {
+        KeyboardTask::Instance->ticks++;
+        return;
+    }
+    KeyboardTask::Instance->events.push_back({event.key.row, event.key.col, event.pressed, event.time,
+        KeyboardTask::Instance->scans});
+}
+
+uint16_t timer_read(void) {
+    return KeyboardTask::Instance->now;
+}
+
+void matrix_init(void) {}
+void matrix_print(void) {}
+void timer_init(void) {}
+void magic(void) {}
+uint8_t host_keyboard_leds(void) { return 0; }
+void led_set(uint8_t usb_led) {}
+void flush_keyboard_report(void) {}
+}
+
+TEST_F(KeyboardTask, idle_scan_sends_a_tick) {
+    keyboard_task();
+    EXPECT_EQ(scans, 1);
+    EXPECT_EQ(ticks, 1);
+    EXPECT_TRUE(events.empty());
+}
+
+TEST_F(KeyboardTask, fast_roll_is_processed_in_a_single_scan) {
+    press(0, 1);
+    press(0, 6);
+    press(1, 3);
+    press(2, 0);
+    press(2, 7);
+    press(3, 4);
+    keyboard_task();
+    EXPECT_EQ(scans, 1);
+    EXPECT_EQ(ticks, 0);
+    std::vector<recorded_event> expected = {
+        down(0, 1, 1), down(0, 6, 1), down(1, 3, 1),
+        down(2, 0, 1), down(2, 7, 1), down(3, 4, 1),
+    };
+    EXPECT_EQ(events, expected);
+}
+
+TEST_F(KeyboardTask, overlapping_roll_keeps_scan_order) {
+    press(1, 2);
+    keyboard_task();
+    press(1, 5);
+    press(0, 0);
+    keyboard_task();
+    release(1, 2);
+    press(3, 3);
+    keyboard_task();
+    release(0, 0);
+    release(1, 5);
+    release(3, 3);
+    keyboard_task();
+    EXPECT_EQ(scans, 4);
+    std::vector<recorded_event> expected = {
+        down(1, 2, 1),
+        down(0, 0, 2), down(1, 5, 2),
+        up(1, 2, 3), down(3, 3, 3),
+        up(0, 0, 4), up(1, 5, 4), up(3, 3, 4),
+    };
+    EXPECT_EQ(events, expected);
+}
+
+TEST_F(KeyboardTask, events_carry_the_time_of_their_scan) {
+    press(0, 0);
+    press(2, 2);
+    keyboard_task();
+    press(3, 7);
+    keyboard_task();
+    ASSERT_EQ(events.size(), 3);
+    EXPECT_EQ(events[0].time, events[1].time);
+    EXPECT_LT(events[1].time, events[2].time);
+    for (auto& e : events) {
+        EXPECT_NE(e.time, 0);
+    }
+}
+
+TEST_F(KeyboardTask, changes_beyond_the_event_buffer_are_deferred_to_the_next_scan) {
+    for (uint8_t r = 0; r < MATRIX_ROWS; r++) {
+        for (uint8_t c = 0; c < MATRIX_COLS; c++) {
+            press(r, c);
+        }
+    }
+    keyboard_task();
+    EXPECT_EQ(events.size(), 16);
+    EXPECT_EQ(events.back(), down(1, 7, 1));
+    keyboard_task();
+    EXPECT_EQ(events.size(), 32);
+    EXPECT_EQ(events[16], down(2, 0, 2));
+    EXPECT_EQ(events.back(), down(3, 7, 2));
+    keyboard_task();
+    EXPECT_EQ(scans, 3);
+    EXPECT_EQ(ticks, 1);
+    EXPECT_EQ(events.size(), 32);
+}
@@ -0,0 +1,265 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+#include <string.h>
+#include <vector>
+
+extern "C" {
+#include "report_queue.h"
+}
+
+// Stands in for an IN endpoint, mirrors what usb_main.c does with the queue
+class FakeEndpoint : public testing::Test {
+public:
+    FakeEndpoint() : busy(false), in_flight(nullptr), waits(0) {
+        report_queue_init(&queue, false);
+    }
+
+    static report_keyboard_t make_report(std::vector<uint8_t> keys) {
+        report_keyboard_t report;
+        memset(&report, 0, sizeof(report));
+        for (size_t i = 0; i < keys.size(); i++) {
+            report.keys[i] = keys[i];
+        }
+        return report;
+    }
+
+    bool offer(std::vector<uint8_t> keys) {
+        report_keyboard_t report = make_report(keys);
+        bool queued = report_queue_push(&queue, &report);
+        start_next();
+        return queued;
+    }
+
+    // like send_keyboard, waits for the host to take a report when the
+    // queue can not make room without losing a transition
+    void send(uint8_t key) {
+        std::vector<uint8_t> keys;
+        if (key) keys.push_back(key);
+        while (!offer(keys)) {
+            waits++;
+            complete();
+        }
+    }
+
+    // like send_keyboard giving up on a host that does not poll
+    void force(uint8_t key) {
+        report_keyboard_t report = make_report({key});
+        report_queue_overwrite(&queue, &report);
+        start_next();
+    }
+
+    // the transfer has made it IN
+    void complete() {
+        ASSERT_TRUE(busy);
+        report_keyboard_t report = in_flight ? *in_flight : make_report({idle_key});
+        sent.push_back(report.keys[0]);
+        host.push_back(report);
+        busy = false;
+        in_flight = nullptr;
+        report_queue_done(&queue);
+        start_next();
+    }
+
+    // a transfer the queue does not own, like an idle rate report
+    void send_idle(uint8_t key) {
+        ASSERT_FALSE(busy);
+        busy = true;
+        idle_key = key;
+    }
+
+    void start_next() {
+        if (busy) return;
+        in_flight = report_queue_start(&queue);
+        if (in_flight) busy = true;
+    }
+
+    report_queue_t queue;
+    bool busy;
+    report_keyboard_t *in_flight;
+    uint8_t idle_key;
+    int waits;
+    std::vector<uint8_t> sent;
+    std::vector<report_keyboard_t> host;
+};
+
+TEST_F(FakeEndpoint, starts_immediately_when_idle) {
+    send(1);
+    EXPECT_TRUE(busy);
+    ASSERT_NE(in_flight, nullptr);
+    EXPECT_EQ(in_flight->keys[0], 1);
+    complete();
+    EXPECT_EQ(sent, std::vector<uint8_t>({1}));
+    EXPECT_FALSE(busy);
+    EXPECT_TRUE(report_queue_empty(&queue));
+}
+
+TEST_F(FakeEndpoint, drains_in_order_from_callback) {
+    send(1);
+    send(2);
+    send(3);
+    complete();
+    complete();
+    complete();
+    EXPECT_EQ(sent, std::vector<uint8_t>({1, 2, 3}));
+    EXPECT_FALSE(busy);
+}
+
+TEST_F(FakeEndpoint, overwrite_drops_oldest_pending_when_full) {
+    for (uint8_t key = 1; key <= REPORT_QUEUE_SIZE; key++) {
+        send(key);
+    }
+    EXPECT_TRUE(report_queue_full(&queue));
+    EXPECT_EQ(queue.overflows, 0);
+    force(REPORT_QUEUE_SIZE + 1);
+    force(REPORT_QUEUE_SIZE + 2);
+    EXPECT_EQ(queue.overflows, 2);
+    while (busy) complete();
+    // 1 was on the wire, 2 and 3 made room
+    std::vector<uint8_t> expected({1});
+    for (uint8_t key = 4; key <= REPORT_QUEUE_SIZE + 2; key++) {
+        expected.push_back(key);
+    }
+    EXPECT_EQ(sent, expected);
+}
+
+TEST_F(FakeEndpoint, overwrite_drops_oldest_when_full_and_idle) {
+    // an idle rate report holds the endpoint, the queue sends nothing yet
+    send_idle(9);
+    for (uint8_t key = 1; key <= REPORT_QUEUE_SIZE + 1; key++) {
+        force(key);
+    }
+    EXPECT_EQ(queue.overflows, 1);
+    while (busy) complete();
+    std::vector<uint8_t> expected({9});
+    for (uint8_t key = 2; key <= REPORT_QUEUE_SIZE + 1; key++) {
+        expected.push_back(key);
+    }
+    EXPECT_EQ(sent, expected);
+}
+
+TEST_F(FakeEndpoint, never_overwrites_report_in_flight) {
+    send(1);
+    report_keyboard_t *first = in_flight;
+    for (uint8_t key = 2; key < 40; key++) {
+        force(key);
+        EXPECT_EQ(first->keys[0], 1);
+    }
+    complete();
+    EXPECT_EQ(sent.front(), 1);
+}
+
+TEST_F(FakeEndpoint, keeps_every_state_of_a_burst_the_host_keeps_up_with) {
+    // what SEND_STRING("ab") looks like to the driver, polled once per report
+    const uint8_t burst[] = { 4, 0, 5, 0 };
+    for (uint8_t i = 0; i < 3; i++) {
+        for (uint8_t key : burst) {
+            if (i > 0) complete();
+            send(key);
+        }
+    }
+    while (busy) complete();
+    ASSERT_EQ(sent.size(), 12u);
+    for (uint8_t i = 0; i < 12; i++) {
+        EXPECT_EQ(sent[i], burst[i % 4]);
+    }
+    EXPECT_EQ(queue.overflows, 0);
+}
+
+TEST_F(FakeEndpoint, refuses_to_collapse_a_press_the_host_would_miss) {
+    for (uint8_t key = 1; key <= REPORT_QUEUE_SIZE; key++) {
+        send(key);
+    }
+    EXPECT_FALSE(offer({REPORT_QUEUE_SIZE + 1}));
+    EXPECT_EQ(queue.collapsed, 0);
+    EXPECT_EQ(queue.overflows, 0);
+    while (busy) complete();
+    std::vector<uint8_t> expected;
+    for (uint8_t key = 1; key <= REPORT_QUEUE_SIZE; key++) {
+        expected.push_back(key);
+    }
+    EXPECT_EQ(sent, expected);
+}
+
+TEST_F(FakeEndpoint, refuses_to_collapse_a_release_the_host_would_miss) {
+    // the release between two taps of the same key
+    send(1);
+    for (uint8_t i = 0; i < REPORT_QUEUE_SIZE - 2; i++) {
+        send(2);
+    }
+    send(0);
+    EXPECT_FALSE(offer({2}));
+    EXPECT_EQ(queue.collapsed, 0);
+}
+
+TEST_F(FakeEndpoint, collapses_when_no_transition_is_lost) {
+    // keys pressed one after the other and held
+    std::vector<uint8_t> held;
+    for (uint8_t key = 1; key <= REPORT_QUEUE_SIZE; key++) {
+        held.push_back(key);
+        ASSERT_TRUE(offer(held));
+    }
+    held.push_back(REPORT_QUEUE_SIZE + 1);
+    EXPECT_TRUE(offer(held));
+    EXPECT_EQ(queue.collapsed, 1);
+    while (busy) complete();
+    ASSERT_EQ(host.size(), (size_t)REPORT_QUEUE_SIZE);
+    // the host still sees every key go down, the last two together
+    for (size_t i = 0; i < held.size(); i++) {
+        EXPECT_EQ(host.back().keys[i], held[i]);
+    }
+}
+
+TEST_F(FakeEndpoint, host_sees_every_character_of_a_string_through_a_stalled_endpoint) {
+    // SEND_STRING("hello"), a press and a release for every character,
+    // while the host polls only when the driver can not queue any more
+    const uint8_t hello[] = { 0x0B, 0x08, 0x0F, 0x0F, 0x12 };
+    for (uint8_t key : hello) {
+        send(key);
+        send(0);
+    }
+    EXPECT_GT(waits, 0);
+    while (busy) complete();
+    std::vector<uint8_t> typed;
+    uint8_t down = 0;
+    for (uint8_t key : sent) {
+        if (key && key != down) typed.push_back(key);
+        down = key;
+    }
+    EXPECT_EQ(typed, std::vector<uint8_t>(hello, hello + sizeof(hello)));
+    EXPECT_EQ(queue.overflows, 0);
+}
+
+TEST_F(FakeEndpoint, ignores_completion_of_unowned_transfer) {
+    send_idle(9);
+    send(1);
+    send(2);
+    EXPECT_EQ(in_flight, nullptr);
+    complete();
+    complete();
+    complete();
+    EXPECT_EQ(sent, std::vector<uint8_t>({9, 1, 2}));
+    EXPECT_TRUE(report_queue_empty(&queue));
+}
+
+TEST_F(FakeEndpoint, wraps_around) {
+    for (uint16_t key = 1; key <= 300; key++) {
+        send(key & 0xFF);
+        complete();
+    }
+    ASSERT_EQ(sent.size(), 300u);
+    EXPECT_EQ(sent.back(), 300 & 0xFF);
+}
@@ -0,0 +1,65 @@
+tmk_keyboard_DEFS := \
+	-DMATRIX_ROWS=4 \
+	-DMATRIX_COLS=8 \
+	-DNO_PRINT \
+	-DNO_DEBUG
+
+tmk_keyboard_SRC := \
+	$(TMK_PATH)/common/tests/keyboard_tests.cpp \
+	$(TMK_PATH)/common/keyboard.c \
+	$(TMK_PATH)/common/debug.c
+
+tmk_action_layer_DEFS := \
+	-DMATRIX_ROWS=4 \
+	-DMATRIX_COLS=8 \
+	-DNO_PRINT \
+	-DNO_DEBUG
+
+tmk_action_layer_SRC := \
+	$(TMK_PATH)/common/tests/action_layer_tests.cpp \
+	$(TMK_PATH)/common/action_layer.c \
+	$(TMK_PATH)/common/util.c
+
+tmk_action_layer_cache_DEFS := $(tmk_action_layer_DEFS) -DLAYER_CACHE_ENABLE
+tmk_action_layer_cache_SRC := $(tmk_action_layer_SRC)
+
+tmk_action_util_DEFS := \
+	-DNO_PRINT \
+	-DNO_DEBUG
+
+tmk_action_util_SRC := \
+	$(TMK_PATH)/common/tests/action_util_tests.cpp \
+	$(TMK_PATH)/common/action_util.c \
+	$(TMK_PATH)/common/host.c \
+	$(TMK_PATH)/common/debug.c \
+	$(TMK_PATH)/common/util.c
+
+tmk_report_queue_SRC := \
+	$(TMK_PATH)/common/tests/report_queue_tests.cpp \
+	$(TMK_PATH)/common/report_queue.c
+
+tmk_extra_queue_SRC := \
+	$(TMK_PATH)/common/tests/extra_queue_tests.cpp \
+	$(TMK_PATH)/common/extra_queue.c
+
+tmk_action_tapping_DEFS := \
+	-DMATRIX_ROWS=4 \
+	-DMATRIX_COLS=8 \
+	-DNO_PRINT \
+	-DNO_DEBUG
+
+tmk_action_tapping_SRC := \
+	$(TMK_PATH)/common/tests/action_tapping_tests.cpp \
+	$(TMK_PATH)/common/action_tapping.c
+
+tmk_action_tapping_permissive_DEFS := $(tmk_action_tapping_DEFS) -DPERMISSIVE_HOLD
+tmk_action_tapping_permissive_SRC := $(tmk_action_tapping_SRC)
+
+tmk_action_tapping_hold_on_press_DEFS := $(tmk_action_tapping_DEFS) -DHOLD_ON_OTHER_KEY_PRESS
+tmk_action_tapping_hold_on_press_SRC := $(tmk_action_tapping_SRC)
+
+tmk_action_tapping_retro_DEFS := $(tmk_action_tapping_DEFS) -DRETRO_TAPPING
+tmk_action_tapping_retro_SRC := $(tmk_action_tapping_SRC)
+
+tmk_action_tapping_per_key_DEFS := $(tmk_action_tapping_DEFS) -DTAPPING_TERM_PER_KEY
+tmk_action_tapping_per_key_SRC := $(tmk_action_tapping_SRC)
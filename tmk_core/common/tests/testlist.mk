@@ -0,0 +1,12 @@
+TEST_LIST +=\
+	tmk_keyboard\
+	tmk_action_layer\
+	tmk_action_layer_cache\
+	tmk_action_util\
+	tmk_report_queue\
+	tmk_extra_queue\
+	tmk_action_tapping\
+	tmk_action_tapping_permissive\
+	tmk_action_tapping_hold_on_press\
+	tmk_action_tapping_retro\
+	tmk_action_tapping_per_key
\ No newline at end of file
@@ -0,0 +1,100 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TWI_H
+#define TWI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Interrupt driven TWI(I2C) master, enabled with TWI_ENABLE = yes.
+ *
+ * Transactions are queued with twi_submit and run one after another from the
+ * TWI interrupt, so the caller can scan its own keys while the bus is busy.
+ * A transaction writes write_data, and then reads read_data after a repeated
+ * start, either part can be empty, with both empty it only checks that the
+ * device answers its address. Losing the bus to another master starts the
+ * transaction over once the bus is free. The transaction belongs to the driver
+ * until its status is no longer TWI_STATUS_PENDING, so it and its buffers
+ * must stay valid until then.
+ *
+ * The same interrupt also serves a simple slave, see twi_slave_init.
+ */
+
+/* SCL clock frequency, define it in config.h to change it */
+#ifndef TWI_SCL_CLOCK
+#define TWI_SCL_CLOCK 400000UL
+#endif
+
+/* twi_wait gives up on a transaction and resets the bus after this long */
+#ifndef TWI_TIMEOUT_MS
+#define TWI_TIMEOUT_MS 10
+#endif
+
+enum twi_status {
+    TWI_STATUS_DONE = 0,
+    TWI_STATUS_PENDING,
+    /* no device answered the address */
+    TWI_STATUS_ADDRESS_NACK,
+    /* the device didn't acknowledge a written byte */
+    TWI_STATUS_DATA_NACK,
+    /* bus error, or the transaction timed out */
+    TWI_STATUS_BUS_ERROR,
+};
+
+typedef struct twi_transaction twi_transaction_t;
+
+/* Called from the interrupt when a transaction is done, it can submit the
+ * same or another transaction again */
+typedef void (*twi_callback_t)(twi_transaction_t *transaction);
+
+struct twi_transaction {
+    /* 7-bit device address */
+    uint8_t address;
+    const uint8_t *write_data;
+    uint8_t write_size;
+    uint8_t *read_data;
+    uint8_t read_size;
+    /* can be NULL */
+    twi_callback_t callback;
+    volatile uint8_t status;
+    twi_transaction_t *next;
+};
+
+void twi_init(void);
+/* Queues the transaction, returns false when it's still pending from before */
+bool twi_submit(twi_transaction_t *transaction);
+bool twi_is_idle(void);
+/* Waits for the transaction to finish, and returns its status */
+uint8_t twi_wait(twi_transaction_t *transaction);
+/* Fails everything that is queued and releases the bus */
+void twi_reset(void);
+
+/* Blocking versions, for initialization code */
+uint8_t twi_write(uint8_t address, const uint8_t *data, uint8_t size);
+uint8_t twi_write_read(uint8_t address, const uint8_t *write_data, uint8_t write_size,
+                       uint8_t *read_data, uint8_t read_size);
+
+/* Answers as a slave at address, with registers as its memory. The first
+ * byte the master writes selects a register, the following bytes are written
+ * from there, and reads continue from there. */
+void twi_slave_init(uint8_t address, volatile uint8_t *registers, uint8_t size);
+/* Odd while a master is writing the registers, counts up at the start and at
+ * the end of every write. Registers copied with interrupts disabled while it
+ * is even hold no half written transaction. */
+extern volatile uint8_t twi_slave_write_sequence;
+
+#endif
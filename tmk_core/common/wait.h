@@ -15,6 +15,11 @@ extern "C" {
 #   define wait_us(us) chThdSleepMicroseconds(us)
 #elif defined(__arm__) /* __AVR__ */
 #   include "wait_api.h"
+#else /* __AVR__ */
+#   include <stdint.h>
+/* native builds: provided by common/native/timer.c and advance the simulated clock */
+void wait_ms(uint16_t ms);
+void wait_us(uint16_t us);
 #endif /* __AVR__ */
 
 #ifdef __cplusplus
@@ -172,6 +172,7 @@ int main(void) {
       /* Woken up */
       // variables has been already cleared by the wakeup hook
       send_keyboard_report();
+      flush_keyboard_report();
 #ifdef MOUSEKEY_ENABLE
       mousekey_send();
 #endif /* MOUSEKEY_ENABLE */
@@ -23,6 +23,7 @@
 #include "host.h"
 #include "debug.h"
 #include "suspend.h"
+#include "report_queue.h"
 #ifdef SLEEP_LED_ENABLE
 #include "sleep_led.h"
 #include "led.h"
@@ -47,6 +48,19 @@ static virtual_timer_t keyboard_idle_timer;
 static void keyboard_idle_timer_cb(void *arg);
 
 report_keyboard_t keyboard_report_sent = {{0}};
+/* reports waiting for the keyboard endpoints, drained by the IN callbacks */
+static report_queue_t kbd_queue;
+static thread_reference_t kbd_queue_waiter = NULL;
+#ifdef NKRO_ENABLE
+static report_queue_t nkro_queue;
+static thread_reference_t nkro_queue_waiter = NULL;
+#endif /* NKRO_ENABLE */
+/* how long send_keyboard may wait for the host to take a report */
+#ifndef REPORT_QUEUE_TIMEOUT_MS
+#define REPORT_QUEUE_TIMEOUT_MS 10
+#endif
+/* reports lost because the host did not poll for REPORT_QUEUE_TIMEOUT_MS */
+uint16_t keyboard_reports_dropped = 0;
 #ifdef MOUSE_ENABLE
 report_mouse_t mouse_report_blank = {0};
 #endif /* MOUSE_ENABLE */
@@ -780,6 +794,7 @@ static void usb_event_cb(USBDriver *usbp, usbevent_t event) {
     osalSysLockFromISR();
     /* Enable the endpoints specified into the configuration. */
     usbInitEndpointI(usbp, KBD_ENDPOINT, &kbd_ep_config);
+    report_queue_init(&kbd_queue, false);
 #ifdef MOUSE_ENABLE
     usbInitEndpointI(usbp, MOUSE_ENDPOINT, &mouse_ep_config);
 #endif /* MOUSE_ENABLE */
@@ -792,6 +807,7 @@ static void usb_event_cb(USBDriver *usbp, usbevent_t event) {
 #endif /* EXTRAKEY_ENABLE */
 #ifdef NKRO_ENABLE
     usbInitEndpointI(usbp, NKRO_ENDPOINT, &nkro_ep_config);
+    report_queue_init(&nkro_queue, true);
 #endif /* NKRO_ENABLE */
     osalSysUnlockFromISR();
     return;
@@ -1054,19 +1070,35 @@ void send_remote_wakeup(USBDriver *usbp) {
  * ---------------------------------------------------------
  */
 
+/* start sending the oldest queued report if the endpoint is free
+ * called from locked state */
+static void kbd_start_next_I(USBDriver *usbp, usbep_t ep, report_queue_t *queue, size_t size) {
+  if(usbGetTransmitStatusI(usbp, ep)) {
+    return;
+  }
+  report_keyboard_t *report = report_queue_start(queue);
+  if(report) {
+    usbStartTransmitI(usbp, ep, (uint8_t *)report, size);
+  }
+}
+
 /* keyboard IN callback hander (a kbd report has made it IN) */
 void kbd_in_cb(USBDriver *usbp, usbep_t ep) {
-  /* STUB */
-  (void)usbp;
-  (void)ep;
+  osalSysLockFromISR();
+  report_queue_done(&kbd_queue);
+  kbd_start_next_I(usbp, ep, &kbd_queue, KBD_EPSIZE);
+  osalThreadResumeI(&kbd_queue_waiter, MSG_OK);
+  osalSysUnlockFromISR();
 }
 
 #ifdef NKRO_ENABLE
 /* nkro IN callback hander (a nkro report has made it IN) */
 void nkro_in_cb(USBDriver *usbp, usbep_t ep) {
-  /* STUB */
-  (void)usbp;
-  (void)ep;
+  osalSysLockFromISR();
+  report_queue_done(&nkro_queue);
+  kbd_start_next_I(usbp, ep, &nkro_queue, sizeof(report_keyboard_t));
+  osalThreadResumeI(&nkro_queue_waiter, MSG_OK);
+  osalSysUnlockFromISR();
 }
 #endif /* NKRO_ENABLE */
 
@@ -1114,50 +1146,41 @@ uint8_t keyboard_leds(void) {
   return (uint8_t)(keyboard_led_stats & 0xFF);
 }
 
-/* prepare and start sending a report IN
- * not callable from ISR or locked state */
+/* queue a report and start sending it if the endpoint is free
+ * the queue only refuses a report in bursts like SEND_STRING, when making
+ * room would lose a keystroke, then this waits for the IN callback
+ * a host that does not poll for REPORT_QUEUE_TIMEOUT_MS loses the oldest
+ * pending report instead, the newest state always gets through
+ * called from locked state */
+static void kbd_queue_send_S(usbep_t ep, report_queue_t *queue, thread_reference_t *waiter, size_t size, report_keyboard_t *report) {
+  while(!report_queue_push(queue, report)) {
+    if(osalThreadSuspendTimeoutS(waiter, MS2ST(REPORT_QUEUE_TIMEOUT_MS)) == MSG_TIMEOUT) {
+      report_queue_overwrite(queue, report);
+      keyboard_reports_dropped++;
+      break;
+    }
+  }
+  kbd_start_next_I(&USB_DRIVER, ep, queue, size);
+}
+
+/* not callable from ISR or locked state */
 void send_keyboard(report_keyboard_t *report) {
   osalSysLock();
   if(usbGetDriverStateI(&USB_DRIVER) != USB_ACTIVE) {
     osalSysUnlock();
     return;
   }
-  osalSysUnlock();
 
 #ifdef NKRO_ENABLE
   if(keymap_config.nkro) {  /* NKRO protocol */
-    /* need to wait until the previous packet has made it through */
-    /* can rewrite this using the synchronous API, then would wait
-     * until *after* the packet has been transmitted. I think
-     * this is more efficient */
-    /* busy wait, should be short and not very common */
-    osalSysLock();
-    if(usbGetTransmitStatusI(&USB_DRIVER, NKRO_ENDPOINT)) {
-      /* Need to either suspend, or loop and call unlock/lock during
-       * every iteration - otherwise the system will remain locked,
-       * no interrupts served, so USB not going through as well.
-       * Note: for suspend, need USB_USE_WAIT == TRUE in halconf.h */
-      osalThreadSuspendS(&(&USB_DRIVER)->epc[NKRO_ENDPOINT]->in_state->thread);
-    }
-    usbStartTransmitI(&USB_DRIVER, NKRO_ENDPOINT, (uint8_t *)report, sizeof(report_keyboard_t));
-    osalSysUnlock();
+    kbd_queue_send_S(NKRO_ENDPOINT, &nkro_queue, &nkro_queue_waiter, sizeof(report_keyboard_t), report);
   } else
 #endif /* NKRO_ENABLE */
   { /* boot protocol */
-    /* need to wait until the previous packet has made it through */
-    /* busy wait, should be short and not very common */
-    osalSysLock();
-    if(usbGetTransmitStatusI(&USB_DRIVER, KBD_ENDPOINT)) {
-      /* Need to either suspend, or loop and call unlock/lock during
-       * every iteration - otherwise the system will remain locked,
-       * no interrupts served, so USB not going through as well.
-       * Note: for suspend, need USB_USE_WAIT == TRUE in halconf.h */
-      osalThreadSuspendS(&(&USB_DRIVER)->epc[KBD_ENDPOINT]->in_state->thread);
-    }
-    usbStartTransmitI(&USB_DRIVER, KBD_ENDPOINT, (uint8_t *)report, KBD_EPSIZE);
-    osalSysUnlock();
+    kbd_queue_send_S(KBD_ENDPOINT, &kbd_queue, &kbd_queue_waiter, KBD_EPSIZE, report);
   }
   keyboard_report_sent = *report;
+  osalSysUnlock();
 }
 
 /* ---------------------------------------------------------
@@ -60,6 +60,9 @@ void send_remote_wakeup(USBDriver *usbp);
 
 /* extern report_keyboard_t keyboard_report_sent; */
 
+/* keyboard reports the host did not pick up in time */
+extern uint16_t keyboard_reports_dropped;
+
 /* keyboard IN request callback handler */
 void kbd_in_cb(USBDriver *usbp, usbep_t ep);
 
@@ -30,6 +30,12 @@ ifeq ($(strip $(VIRTSER_ENABLE)), yes)
 	LUFA_SRC += $(LUFA_ROOT_PATH)/Drivers/USB/Class/Device/CDCClassDevice.c
 endif
 
+ifeq ($(strip $(DEFERRED_SEND_ENABLE)), yes)
+	LUFA_SRC += $(TMK_DIR)/common/report_queue.c \
+	$(TMK_DIR)/common/extra_queue.c
+	OPT_DEFS += -DDEFERRED_SEND_ENABLE
+endif
+
 SRC += $(LUFA_SRC)
 
 # Search Path
@@ -71,6 +71,11 @@
     #include "virtser.h"
 #endif
 
+#ifdef DEFERRED_SEND_ENABLE
+    #include "report_queue.h"
+    #include "extra_queue.h"
+#endif
+
 uint8_t keyboard_idle = 0;
 /* 0: Boot Protocol, 1: Report Protocol(default) */
 uint8_t keyboard_protocol = 1;
@@ -225,6 +230,228 @@ static void Console_Task(void)
 #endif
 
 
+/*******************************************************************************
+ * Deferred send
+ *
+ * Reports are queued in RAM and written to their endpoint as soon as it has
+ * room, right away when it is free or later from deferred_send_task() in the
+ * main loop, so keyboard_task() never waits for the host to poll.
+ * Queued reports are only merged when the host loses no state by it. A
+ * keyboard report that can not be merged into a full queue waits up to 10ms
+ * for the host to take one. When the host stops polling the oldest report of
+ * a full queue is dropped.
+ ******************************************************************************/
+#ifdef DEFERRED_SEND_ENABLE
+deferred_send_stats_t deferred_send_stats;
+
+#ifndef DEFERRED_SEND_QUEUE_SIZE
+#define DEFERRED_SEND_QUEUE_SIZE 4
+#endif
+#if DEFERRED_SEND_QUEUE_SIZE < 2 || DEFERRED_SEND_QUEUE_SIZE > 128 || (DEFERRED_SEND_QUEUE_SIZE & (DEFERRED_SEND_QUEUE_SIZE - 1))
+#error "DEFERRED_SEND_QUEUE_SIZE must be a power of two between 2 and 128"
+#endif
+#define DEFERRED_SEND_QUEUE_MASK (DEFERRED_SEND_QUEUE_SIZE - 1)
+
+static report_queue_t keyboard_queue;
+#ifdef NKRO_ENABLE
+static report_queue_t nkro_queue;
+#endif
+#ifdef MOUSE_ENABLE
+static report_mouse_t mouse_queue[DEFERRED_SEND_QUEUE_SIZE];
+static uint8_t mouse_head = 0;
+static uint8_t mouse_tail = 0;
+#endif
+static extra_queue_t extra_queue;
+#ifdef VIRTSER_ENABLE
+#ifndef VIRTSER_SEND_BUFFER_SIZE
+#define VIRTSER_SEND_BUFFER_SIZE 32
+#endif
+static uint8_t virtser_buffer[VIRTSER_SEND_BUFFER_SIZE];
+static uint8_t virtser_head = 0;
+static uint8_t virtser_tail = 0;
+#endif
+
+/* make room for one more report in a full queue by dropping the oldest */
+static void make_room(uint8_t head, uint8_t *tail)
+{
+    if ((uint8_t)(head - *tail) == DEFERRED_SEND_QUEUE_SIZE) {
+        (*tail)++;
+        deferred_send_stats.dropped++;
+    }
+}
+
+static void flush_keyboard_queue(report_queue_t *queue, uint8_t epnum, uint8_t size)
+{
+    if (report_queue_empty(queue)) return;
+    Endpoint_SelectEndpoint(epnum);
+    if (!Endpoint_IsReadWriteAllowed()) return;
+    Endpoint_Write_Stream_LE(report_queue_start(queue), size, NULL);
+    Endpoint_ClearIN();
+    report_queue_done(queue);
+}
+
+static void stage_keyboard(report_queue_t *queue, uint8_t epnum, uint8_t size, report_keyboard_t *report)
+{
+    uint16_t collapsed = queue->collapsed;
+    uint8_t timeout = 255;
+    // the queue refuses a report only when making room would lose a
+    // keystroke, then the host gets a moment to take one
+    while (!report_queue_push(queue, report)) {
+        if (!--timeout) {
+            report_queue_overwrite(queue, report);
+            deferred_send_stats.dropped++;
+            break;
+        }
+        _delay_us(40);
+        flush_keyboard_queue(queue, epnum, size);
+    }
+    if (queue->collapsed != collapsed) {
+        deferred_send_stats.merged++;
+    }
+    flush_keyboard_queue(queue, epnum, size);
+}
+
+#ifdef MOUSE_ENABLE
+/* add the movement to a queued report, only while the buttons stay the same */
+static bool merge_mouse(report_mouse_t *queued, report_mouse_t *report)
+{
+    if (report->buttons != queued->buttons) return false;
+    int16_t x = queued->x + report->x;
+    int16_t y = queued->y + report->y;
+    int16_t v = queued->v + report->v;
+    int16_t h = queued->h + report->h;
+    if (x < -127 || x > 127 || y < -127 || y > 127) return false;
+    if (v < -127 || v > 127 || h < -127 || h > 127) return false;
+    queued->x = x;
+    queued->y = y;
+    queued->v = v;
+    queued->h = h;
+    return true;
+}
+
+static void flush_mouse(void)
+{
+    if (mouse_tail == mouse_head) return;
+    Endpoint_SelectEndpoint(MOUSE_IN_EPNUM);
+    if (!Endpoint_IsReadWriteAllowed()) return;
+    Endpoint_Write_Stream_LE(&mouse_queue[mouse_tail & DEFERRED_SEND_QUEUE_MASK], sizeof(report_mouse_t), NULL);
+    Endpoint_ClearIN();
+    mouse_tail++;
+}
+
+static void stage_mouse(report_mouse_t *report)
+{
+    // only the newest report can take more movement, a button change
+    // has to follow the movement before it
+    if (mouse_tail != mouse_head &&
+        merge_mouse(&mouse_queue[(uint8_t)(mouse_head - 1) & DEFERRED_SEND_QUEUE_MASK], report)) {
+        deferred_send_stats.merged++;
+    } else {
+        make_room(mouse_head, &mouse_tail);
+        mouse_queue[mouse_head & DEFERRED_SEND_QUEUE_MASK] = *report;
+        mouse_head++;
+    }
+    flush_mouse();
+}
+#endif
+
+static void flush_extra(void)
+{
+    extra_queue_entry_t *entry = extra_queue_peek(&extra_queue);
+    if (!entry) return;
+    Endpoint_SelectEndpoint(EXTRAKEY_IN_EPNUM);
+    if (!Endpoint_IsReadWriteAllowed()) return;
+    report_extra_t report = {
+        .report_id = entry->report_id,
+        .usage = entry->usage
+    };
+    Endpoint_Write_Stream_LE(&report, sizeof(report_extra_t), NULL);
+    Endpoint_ClearIN();
+    extra_queue_pop(&extra_queue);
+}
+
+static void stage_extra(uint8_t report_id, uint16_t usage)
+{
+    uint16_t merged = extra_queue.merged;
+    uint16_t dropped = extra_queue.dropped;
+    extra_queue_push(&extra_queue, report_id, usage);
+    deferred_send_stats.merged += extra_queue.merged - merged;
+    deferred_send_stats.dropped += extra_queue.dropped - dropped;
+    flush_extra();
+}
+
+#ifdef VIRTSER_ENABLE
+static void flush_virtser(void)
+{
+    if (virtser_tail == virtser_head) return;
+    Endpoint_SelectEndpoint(cdc_device.Config.DataINEndpoint.Address);
+    if (!Endpoint_IsEnabled() || !Endpoint_IsConfigured()) return;
+    if (!Endpoint_IsReadWriteAllowed()) return;
+
+    // stay below a full packet so the host does not wait for a zero length one
+    uint8_t room = cdc_device.Config.DataINEndpoint.Size - 1;
+    while (room-- && virtser_tail != virtser_head) {
+        Endpoint_Write_8(virtser_buffer[virtser_tail]);
+        virtser_tail = (virtser_tail + 1) % VIRTSER_SEND_BUFFER_SIZE;
+    }
+    Endpoint_ClearIN();
+}
+
+static void stage_virtser(uint8_t byte)
+{
+    uint8_t next = (virtser_head + 1) % VIRTSER_SEND_BUFFER_SIZE;
+    if (next == virtser_tail) {
+        flush_virtser();
+        if (next == virtser_tail) {
+            deferred_send_stats.dropped++;
+            return;
+        }
+    }
+    virtser_buffer[virtser_head] = byte;
+    virtser_head = next;
+}
+#endif
+
+static void deferred_send_clear(void)
+{
+    report_queue_init(&keyboard_queue, false);
+#ifdef NKRO_ENABLE
+    report_queue_init(&nkro_queue, true);
+#endif
+#ifdef MOUSE_ENABLE
+    mouse_tail = mouse_head;
+#endif
+    extra_queue_init(&extra_queue);
+#ifdef VIRTSER_ENABLE
+    virtser_tail = virtser_head;
+#endif
+}
+
+/* Writes staged reports to the endpoints the host has emptied since.
+ * Not called from the SOF interrupt because the main loop may be in the middle
+ * of using another endpoint then. */
+void deferred_send_task(void)
+{
+    if (USB_DeviceState != DEVICE_STATE_Configured)
+        return;
+
+    uint8_t ep = Endpoint_GetCurrentEndpoint();
+#ifdef NKRO_ENABLE
+    flush_keyboard_queue(&nkro_queue, NKRO_IN_EPNUM, NKRO_EPSIZE);
+#endif
+    flush_keyboard_queue(&keyboard_queue, KEYBOARD_IN_EPNUM, KEYBOARD_EPSIZE);
+#ifdef MOUSE_ENABLE
+    flush_mouse();
+#endif
+    flush_extra();
+#ifdef VIRTSER_ENABLE
+    flush_virtser();
+#endif
+    Endpoint_SelectEndpoint(ep);
+}
+#endif
+
+
 /*******************************************************************************
  * USB Events
  ******************************************************************************/
@@ -314,6 +541,11 @@ void EVENT_USB_Device_ConfigurationChanged(void)
 {
     bool ConfigSuccess = true;
 
+#ifdef DEFERRED_SEND_ENABLE
+    /* the endpoints start out empty, drop what was staged for the old ones */
+    deferred_send_clear();
+#endif
+
     /* Setup Keyboard HID Report Endpoints */
     ConfigSuccess &= ENDPOINT_CONFIG(KEYBOARD_IN_EPNUM, EP_TYPE_INTERRUPT, ENDPOINT_DIR_IN,
                                      KEYBOARD_EPSIZE, ENDPOINT_BANK_SINGLE);
@@ -502,11 +734,22 @@ static void send_keyboard(report_keyboard_t *report)
     }
 #endif
 
-    uint8_t timeout = 255;
-
     if (USB_DeviceState != DEVICE_STATE_Configured)
         return;
 
+#ifdef DEFERRED_SEND_ENABLE
+#ifdef NKRO_ENABLE
+    if (keyboard_protocol && keymap_config.nkro) {
+        stage_keyboard(&nkro_queue, NKRO_IN_EPNUM, NKRO_EPSIZE, report);
+    }
+    else
+#endif
+    {
+        stage_keyboard(&keyboard_queue, KEYBOARD_IN_EPNUM, KEYBOARD_EPSIZE, report);
+    }
+#else
+    uint8_t timeout = 255;
+
     /* Select the Keyboard Report Endpoint */
 #ifdef NKRO_ENABLE
     if (keyboard_protocol && keymap_config.nkro) {
@@ -536,6 +779,7 @@ static void send_keyboard(report_keyboard_t *report)
 
     /* Finalize the stream transfer to send the last packet */
     Endpoint_ClearIN();
+#endif
 
     keyboard_report_sent = *report;
 }
@@ -556,11 +800,14 @@ static void send_mouse(report_mouse_t *report)
     bluefruit_serial_send(0x00);
 #endif
 
-    uint8_t timeout = 255;
-
     if (USB_DeviceState != DEVICE_STATE_Configured)
         return;
 
+#ifdef DEFERRED_SEND_ENABLE
+    stage_mouse(report);
+#else
+    uint8_t timeout = 255;
+
     /* Select the Mouse Report Endpoint */
     Endpoint_SelectEndpoint(MOUSE_IN_EPNUM);
 
@@ -574,15 +821,19 @@ static void send_mouse(report_mouse_t *report)
     /* Finalize the stream transfer to send the last packet */
     Endpoint_ClearIN();
 #endif
+#endif
 }
 
 static void send_system(uint16_t data)
 {
-    uint8_t timeout = 255;
-
     if (USB_DeviceState != DEVICE_STATE_Configured)
         return;
 
+#ifdef DEFERRED_SEND_ENABLE
+    stage_extra(REPORT_ID_SYSTEM, data);
+#else
+    uint8_t timeout = 255;
+
     report_extra_t r = {
         .report_id = REPORT_ID_SYSTEM,
         .usage = data
@@ -595,6 +846,7 @@ static void send_system(uint16_t data)
 
     Endpoint_Write_Stream_LE(&r, sizeof(report_extra_t), NULL);
     Endpoint_ClearIN();
+#endif
 }
 
 static void send_consumer(uint16_t data)
@@ -616,11 +868,14 @@ static void send_consumer(uint16_t data)
     bluefruit_serial_send(0x00);
 #endif
 
-    uint8_t timeout = 255;
-
     if (USB_DeviceState != DEVICE_STATE_Configured)
         return;
 
+#ifdef DEFERRED_SEND_ENABLE
+    stage_extra(REPORT_ID_CONSUMER, data);
+#else
+    uint8_t timeout = 255;
+
     report_extra_t r = {
         .report_id = REPORT_ID_CONSUMER,
         .usage = data
@@ -633,6 +888,7 @@ static void send_consumer(uint16_t data)
 
     Endpoint_Write_Stream_LE(&r, sizeof(report_extra_t), NULL);
     Endpoint_ClearIN();
+#endif
 }
 
 
@@ -906,11 +1162,15 @@ void virtser_task(void)
 }
 void virtser_send(const uint8_t byte)
 {
-  uint8_t timeout = 255;
   uint8_t ep = Endpoint_GetCurrentEndpoint();
 
   if (cdc_device.State.ControlLineStates.HostToDevice & CDC_CONTROL_LINE_OUT_DTR)
   {
+#ifdef DEFERRED_SEND_ENABLE
+    stage_virtser(byte);
+#else
+    uint8_t timeout = 255;
+
     /* IN packet */
     Endpoint_SelectEndpoint(cdc_device.Config.DataINEndpoint.Address);
 
@@ -927,6 +1187,7 @@ void virtser_send(const uint8_t byte)
     if (Endpoint_IsINReady()) {
       Endpoint_ClearIN();
     }
+#endif
 
     Endpoint_SelectEndpoint(ep);
   }
@@ -1045,6 +1306,10 @@ int main(void)
 #endif
         keyboard_task();
 
+#ifdef DEFERRED_SEND_ENABLE
+        deferred_send_task();
+#endif
+
 #ifdef VIRTSER_ENABLE
         virtser_task();
         CDC_Device_USBTask(&cdc_device);
@@ -67,6 +67,19 @@ typedef struct {
     uint16_t usage;
 } __attribute__ ((packed)) report_extra_t;
 
+#ifdef DEFERRED_SEND_ENABLE
+typedef struct {
+    /* reports or serial bytes lost because the host did not poll in time */
+    uint16_t dropped;
+    /* reports folded into one that was still staged */
+    uint16_t merged;
+} deferred_send_stats_t;
+
+extern deferred_send_stats_t deferred_send_stats;
+
+void deferred_send_task(void);
+#endif
+
 #ifdef MIDI_ENABLE
 void MIDI_Task(void);
 MidiDevice midi_device;
@@ -0,0 +1,9 @@
+SIM_DIR = protocol/sim
+
+SRC += $(SIM_DIR)/main.c \
+	$(SIM_DIR)/sim_host.c \
+	$(SIM_DIR)/sim_matrix.c
+
+OPT_DEFS += -DPROTOCOL_SIM
+
+VPATH += $(TMK_PATH)/$(SIM_DIR)
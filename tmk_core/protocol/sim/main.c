@@ -0,0 +1,220 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Host-native keyboard simulator.
+ *
+ * Reads a key trace, feeds it through the regular matrix -> debounce ->
+ * keyboard_task -> action pipeline against a simulated clock and writes every
+ * HID report the keyboard sends, stamped with the simulated time.
+ *
+ * Trace format, one event per line, '#' starts a comment:
+ *
+ *     <time in ms> down|up <row> <col>
+ *     <time in ms> leds <host led bits>
+ *
+ * Times may be fractional and must not decrease.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "host.h"
+#include "keyboard.h"
+#include "native/timer_native.h"
+#include "sim_host.h"
+#include "sim_matrix.h"
+
+#ifndef SIM_SCAN_INTERVAL_US
+#   define SIM_SCAN_INTERVAL_US 1000
+#endif
+
+#ifndef SIM_TAIL_MS
+#   define SIM_TAIL_MS 1000
+#endif
+
+enum sim_event_type {
+    SIM_KEY_DOWN,
+    SIM_KEY_UP,
+    SIM_LEDS,
+};
+
+typedef struct {
+    uint64_t time_us;
+    uint8_t type;
+    uint8_t row;
+    uint8_t col;
+} sim_event_t;
+
+static sim_event_t *events = NULL;
+static size_t num_events = 0;
+
+static bool add_event(sim_event_t event)
+{
+    static size_t capacity = 0;
+    if (num_events == capacity) {
+        capacity = capacity ? capacity * 2 : 64;
+        sim_event_t *grown = realloc(events, capacity * sizeof(sim_event_t));
+        if (!grown) return false;
+        events = grown;
+    }
+    events[num_events++] = event;
+    return true;
+}
+
+static bool load_trace(FILE *in, const char *name)
+{
+    char line[256];
+    unsigned line_no = 0;
+    uint64_t last_time = 0;
+
+    while (fgets(line, sizeof(line), in)) {
+        line_no++;
+        char *comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+
+        double time_ms;
+        char action[16];
+        unsigned a = 0, b = 0;
+        int fields = sscanf(line, "%lf %15s %u %u", &time_ms, action, &a, &b);
+        if (fields <= 0) continue;
+
+        sim_event_t event = { .time_us = (uint64_t)(time_ms * 1000.0 + 0.5) };
+        if (fields == 4 && strcmp(action, "down") == 0) {
+            event.type = SIM_KEY_DOWN;
+        } else if (fields == 4 && strcmp(action, "up") == 0) {
+            event.type = SIM_KEY_UP;
+        } else if (fields == 3 && strcmp(action, "leds") == 0) {
+            event.type = SIM_LEDS;
+        } else {
+            fprintf(stderr, "%s:%u: malformed event\n", name, line_no);
+            return false;
+        }
+        if (time_ms < 0 || event.time_us < last_time) {
+            fprintf(stderr, "%s:%u: time goes backwards\n", name, line_no);
+            return false;
+        }
+        if (event.type != SIM_LEDS && (a >= MATRIX_ROWS || b >= MATRIX_COLS)) {
+            fprintf(stderr, "%s:%u: key %u,%u is outside the %ux%u matrix\n",
+                    name, line_no, a, b, MATRIX_ROWS, MATRIX_COLS);
+            return false;
+        }
+        event.row = a;
+        event.col = b;
+        last_time = event.time_us;
+        if (!add_event(event)) {
+            fprintf(stderr, "out of memory\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [-s scan_interval_us] [-t tail_ms] [-q] [trace]\n"
+            "  -s  time between matrix scans (default %u us)\n"
+            "  -t  keep scanning this long after the last event (default %u ms)\n"
+            "  -q  only print the report summary\n"
+            "The trace is read from stdin when no file is given.\n",
+            argv0, SIM_SCAN_INTERVAL_US, SIM_TAIL_MS);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long scan_interval = SIM_SCAN_INTERVAL_US;
+    unsigned long tail = SIM_TAIL_MS;
+    bool quiet = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:t:qh")) != -1) {
+        switch (opt) {
+            case 's':
+                scan_interval = strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                tail = strtoul(optarg, NULL, 0);
+                break;
+            case 'q':
+                quiet = true;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (scan_interval == 0 || optind + 1 < argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    FILE *in = stdin;
+    const char *name = "<stdin>";
+    if (optind < argc) {
+        name = argv[optind];
+        in = fopen(name, "r");
+        if (!in) {
+            perror(name);
+            return 1;
+        }
+    }
+    bool loaded = load_trace(in, name);
+    if (in != stdin) fclose(in);
+    if (!loaded) return 1;
+
+    sim_host_set_output(quiet ? NULL : stdout);
+
+    timer_set_us(0);
+    keyboard_init();
+    host_set_driver(&sim_driver);
+
+    uint64_t end = (num_events ? events[num_events - 1].time_us : 0) + (uint64_t)tail * 1000;
+    size_t next = 0;
+    while (timer_read_us() <= end) {
+        uint64_t now = timer_read_us();
+        for (; next < num_events && events[next].time_us <= now; next++) {
+            sim_event_t *e = &events[next];
+            switch (e->type) {
+                case SIM_KEY_DOWN:
+                case SIM_KEY_UP:
+                    sim_matrix_set(e->row, e->col, e->type == SIM_KEY_DOWN);
+                    if (!quiet) {
+                        printf("%8lu.%03u %-8s %u %u\n", (unsigned long)(now / 1000), (unsigned)(now % 1000),
+                               e->type == SIM_KEY_DOWN ? "down" : "up", e->row, e->col);
+                    }
+                    break;
+                case SIM_LEDS:
+                    sim_host_set_leds(e->row);
+                    break;
+            }
+        }
+
+        keyboard_task();
+        timer_advance_us(scan_interval);
+    }
+
+    printf("# %u events, reports: %lu keyboard, %lu mouse, %lu system, %lu consumer\n",
+           (unsigned)num_events,
+           (unsigned long)sim_report_count.keyboard, (unsigned long)sim_report_count.mouse,
+           (unsigned long)sim_report_count.system, (unsigned long)sim_report_count.consumer);
+
+    free(events);
+    return 0;
+}
@@ -0,0 +1,99 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include "report.h"
+#include "host_driver.h"
+#include "native/timer_native.h"
+#include "sim_host.h"
+
+static FILE *output = NULL;
+static uint8_t host_leds = 0;
+
+sim_report_count_t sim_report_count;
+
+static uint8_t keyboard_leds(void);
+static void send_keyboard(report_keyboard_t *report);
+static void send_mouse(report_mouse_t *report);
+static void send_system(uint16_t data);
+static void send_consumer(uint16_t data);
+
+host_driver_t sim_driver = {
+    keyboard_leds,
+    send_keyboard,
+    send_mouse,
+    send_system,
+    send_consumer
+};
+
+void sim_host_set_output(FILE *out)
+{
+    output = out;
+}
+
+void sim_host_set_leds(uint8_t leds)
+{
+    host_leds = leds;
+}
+
+static void print_time(void)
+{
+    uint64_t now = timer_read_us();
+    fprintf(output, "%8lu.%03u ", (unsigned long)(now / 1000), (unsigned)(now % 1000));
+}
+
+static uint8_t keyboard_leds(void)
+{
+    return host_leds;
+}
+
+static void send_keyboard(report_keyboard_t *report)
+{
+    sim_report_count.keyboard++;
+    if (!output) return;
+    print_time();
+    fprintf(output, "keyboard");
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_SIZE; i++) {
+        fprintf(output, " %02X", report->raw[i]);
+    }
+    fprintf(output, "\n");
+}
+
+static void send_mouse(report_mouse_t *report)
+{
+    sim_report_count.mouse++;
+    if (!output) return;
+    print_time();
+    fprintf(output, "mouse %02X %d %d %d %d\n", report->buttons,
+            report->x, report->y, report->v, report->h);
+}
+
+static void send_system(uint16_t data)
+{
+    sim_report_count.system++;
+    if (!output) return;
+    print_time();
+    fprintf(output, "system %04X\n", data);
+}
+
+static void send_consumer(uint16_t data)
+{
+    sim_report_count.consumer++;
+    if (!output) return;
+    print_time();
+    fprintf(output, "consumer %04X\n", data);
+}
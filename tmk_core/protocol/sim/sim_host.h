@@ -0,0 +1,39 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SIM_HOST_H
+#define SIM_HOST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "host_driver.h"
+
+typedef struct {
+    uint32_t keyboard;
+    uint32_t mouse;
+    uint32_t system;
+    uint32_t consumer;
+} sim_report_count_t;
+
+extern host_driver_t sim_driver;
+extern sim_report_count_t sim_report_count;
+
+/* Reports are written to out as one timestamped line each, NULL silences them */
+void sim_host_set_output(FILE *out);
+/* LED state the host reports back to the keyboard */
+void sim_host_set_leds(uint8_t leds);
+
+#endif